@@ -0,0 +1,87 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// anari
+#include <anari/anari_cpp.hpp>
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Decides when progressive rendering can stop: tracks the relative RMS
+// difference between consecutive frames and reports convergence once it
+// drops below threshold, or once sampleBudget frames were accumulated.
+struct AccumulationController
+{
+  float threshold{1e-3f};
+  int sampleBudget{1024};
+
+  void reset()
+  {
+    m_samples = 0;
+    m_change = 1.f;
+    m_converged = false;
+    m_previous.clear();
+  }
+
+  // Feed a newly completed frame (ANARI_UFIXED8_RGBA_SRGB, ANARI_FLOAT32 or
+  // ANARI_UFIXED16), returns true once converged
+  bool addFrame(const void *data, size_t numPixels, anari::DataType format)
+  {
+    m_current.resize(numPixels);
+    if (format == ANARI_FLOAT32) {
+      auto src = reinterpret_cast<const float *>(data);
+      std::copy(src, src + numPixels, m_current.begin());
+    } else if (format == ANARI_UFIXED16) {
+      auto src = reinterpret_cast<const uint16_t *>(data);
+      std::copy(src, src + numPixels, m_current.begin());
+    } else {
+      auto src = reinterpret_cast<const uint8_t *>(data);
+      for (size_t i = 0; i < numPixels; ++i)
+        m_current[i] = src[i * 4] + src[i * 4 + 1] + src[i * 4 + 2];
+    }
+
+    ++m_samples;
+    if (m_previous.size() == numPixels) {
+      double diff2 = 0.0, curr2 = 0.0;
+      for (size_t i = 0; i < numPixels; ++i) {
+        double d = m_current[i] - m_previous[i];
+        diff2 += d * d;
+        curr2 += double(m_current[i]) * m_current[i];
+      }
+      m_change = curr2 > 0.0 ? float(std::sqrt(diff2 / curr2))
+                             : float(std::sqrt(diff2 / numPixels));
+    }
+    std::swap(m_previous, m_current);
+
+    m_converged = m_samples >= sampleBudget
+        || (m_samples > 1 && m_change < threshold);
+    return m_converged;
+  }
+
+  bool converged() const
+  {
+    return m_converged;
+  }
+
+  int samples() const
+  {
+    return m_samples;
+  }
+
+  // relative RMS difference of the last two frames
+  float change() const
+  {
+    return m_change;
+  }
+
+ private:
+  int m_samples{0};
+  float m_change{1.f};
+  bool m_converged{false};
+  std::vector<float> m_previous;
+  std::vector<float> m_current;
+};
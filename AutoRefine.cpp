@@ -0,0 +1,201 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#include "AutoRefine.h"
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+// ours
+#include "SimilarityMetrics.h"
+
+// AutoRefine definitions /////////////////////////////////////////////////////
+
+void AutoRefine::start(
+    size_t prediction, const CameraKey &pose, const Settings &settings)
+{
+  m_phase = Phase::RENDERING;
+  m_stopReason = StopReason::NONE;
+  m_stopRequested = false;
+  m_prediction = prediction;
+  m_settings = settings;
+  m_iterations.clear();
+  m_current = pose;
+  m_best = pose;
+  m_bestResidual = std::numeric_limits<float>::max();
+  m_stalled = 0;
+}
+
+void AutoRefine::requestStop()
+{
+  if (m_phase != Phase::IDLE)
+    m_stopRequested = true;
+}
+
+void AutoRefine::finish(StopReason reason)
+{
+  m_phase = Phase::IDLE;
+  m_stopReason = reason;
+  m_stopRequested = false;
+  printf("auto-refine: %s after %zu iteration(s)\n",
+      toString(reason),
+      m_iterations.size());
+}
+
+bool AutoRefine::rendered(float renderMs, float residual)
+{
+  m_renderMs = renderMs;
+  m_residual = residual;
+
+  if (std::isfinite(residual)) {
+    if (residual < m_bestResidual - m_settings.minImprovement) {
+      m_best = m_current;
+      m_bestResidual = residual;
+      m_stalled = 0;
+    } else if (++m_stalled >= m_settings.patience) {
+      finish(StopReason::STALLED);
+      return false;
+    }
+  } else
+    m_best = m_current;
+
+  m_phase = Phase::MATCHING;
+  return true;
+}
+
+bool AutoRefine::matched(const CameraKey &pose, float matchMs)
+{
+  Iteration it;
+  it.index = int(m_iterations.size()) + 1;
+  it.renderMs = m_renderMs;
+  it.matchMs = matchMs;
+  it.residual = m_residual;
+  poseDelta(m_current, pose, it.translation, it.rotation);
+  m_iterations.push_back(it);
+  m_current = pose;
+
+  printf("auto-refine %2i: render %7.1fms match %7.1fms "
+         "translation %.2e rotation %.3fdeg residual %.4f\n",
+      it.index,
+      it.renderMs,
+      it.matchMs,
+      it.translation,
+      it.rotation,
+      it.residual);
+
+  if (it.translation <= m_settings.translationTolerance
+      && it.rotation <= m_settings.rotationTolerance) {
+    m_best = pose;
+    finish(StopReason::CONVERGED);
+    return false;
+  }
+  if (it.index >= m_settings.maxIterations) {
+    // the last pose wasn't evaluated, keep it only without residuals
+    if (!std::isfinite(m_residual))
+      m_best = pose;
+    finish(StopReason::MAX_ITERATIONS);
+    return false;
+  }
+
+  m_phase = Phase::RENDERING;
+  return true;
+}
+
+AutoRefine::Phase AutoRefine::phase() const
+{
+  return m_phase;
+}
+
+bool AutoRefine::stopRequested() const
+{
+  return m_stopRequested;
+}
+
+AutoRefine::StopReason AutoRefine::stopReason() const
+{
+  return m_stopReason;
+}
+
+size_t AutoRefine::prediction() const
+{
+  return m_prediction;
+}
+
+const AutoRefine::Settings &AutoRefine::settings() const
+{
+  return m_settings;
+}
+
+const std::vector<AutoRefine::Iteration> &AutoRefine::iterations() const
+{
+  return m_iterations;
+}
+
+const CameraKey &AutoRefine::currentPose() const
+{
+  return m_current;
+}
+
+const CameraKey &AutoRefine::result() const
+{
+  return m_best;
+}
+
+const char *toString(AutoRefine::StopReason reason)
+{
+  switch (reason) {
+  case AutoRefine::StopReason::NONE:
+    return "running";
+  case AutoRefine::StopReason::CONVERGED:
+    return "converged";
+  case AutoRefine::StopReason::STALLED:
+    return "residual stopped improving";
+  case AutoRefine::StopReason::MAX_ITERATIONS:
+    return "maximum iterations reached";
+  case AutoRefine::StopReason::CANCELLED:
+    return "cancelled";
+  case AutoRefine::StopReason::FAILED:
+    return "failed";
+  }
+  return "unknown";
+}
+
+// Helper functions ///////////////////////////////////////////////////////////
+
+static float angleDeg(anari::math::float3 a, anari::math::float3 b)
+{
+  float la = anari::math::length(a), lb = anari::math::length(b);
+  if (la == 0.f || lb == 0.f)
+    return 0.f;
+  float c = std::clamp(anari::math::dot(a, b) / (la * lb), -1.f, 1.f);
+  return std::acos(c) * 180.f / float(M_PI);
+}
+
+void poseDelta(
+    const CameraKey &a, const CameraKey &b, float &translation, float &rotation)
+{
+  float distance = anari::math::length(a.center - a.eye);
+  translation = anari::math::length(b.eye - a.eye) / std::max(distance, 1e-6f);
+  rotation = std::max(
+      angleDeg(a.center - a.eye, b.center - b.eye), angleDeg(a.up, b.up));
+}
+
+float imageResidual(const uint8_t *frame,
+    size_t bpp,
+    size_t width,
+    size_t height,
+    const Image &reference)
+{
+  if (!frame || width == 0 || height == 0 || reference.width == 0
+      || reference.height == 0)
+    return std::numeric_limits<float>::quiet_NaN();
+
+  // the frame's columns are mirrored, fromFrame flips them back
+  const MetricImage moving =
+      MetricImage::fromFrame(frame, bpp, int(width), int(height));
+  const MetricImage fixed =
+      MetricImage::fromImage(reference, int(width), int(height));
+  const float ncc = computeMetric(Metric::NCC, moving, fixed);
+  // constant images don't correlate
+  return std::isfinite(ncc) ? metricCost(Metric::NCC, ncc) : 1.f;
+}
@@ -0,0 +1,111 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <cstdint>
+#include <limits>
+#include <vector>
+// ours
+#include "CameraPath.h" // CameraKey
+#include "Image.h"
+
+// Bookkeeping of the closed render -> match -> update loop. The viewer
+// drives it: rendered() once the frame at the current pose has converged,
+// matched() with the estimator's updated pose. The loop stops when the pose
+// update falls below the tolerances (converged), the image residual against
+// the reference stopped improving for `patience` iterations (stalled), or
+// after maxIterations.
+class AutoRefine
+{
+ public:
+  enum class Phase
+  {
+    IDLE,
+    RENDERING,
+    MATCHING,
+  };
+
+  enum class StopReason
+  {
+    NONE,
+    CONVERGED,
+    STALLED,
+    MAX_ITERATIONS,
+    CANCELLED,
+    FAILED,
+  };
+
+  struct Settings
+  {
+    // eye movement relative to the viewing distance
+    float translationTolerance{1e-3f};
+    // change of view direction or up vector in degrees
+    float rotationTolerance{.05f};
+    int maxIterations{20};
+    int patience{2};
+    float minImprovement{1e-4f};
+  };
+
+  struct Iteration
+  {
+    int index;
+    float renderMs;
+    float matchMs;
+    float translation; // relative to the viewing distance
+    float rotation; // degrees
+    float residual; // 1 - NCC of the rendered frame, NaN if unknown
+  };
+
+  void start(size_t prediction, const CameraKey &pose, const Settings &settings);
+  void requestStop();
+  // ends the loop, e.g. when the match job failed
+  void finish(StopReason reason);
+
+  // residual (NaN if unknown) of the frame rendered at the current pose;
+  // false if the loop stopped
+  bool rendered(float renderMs, float residual);
+  // pose returned by the estimator; false if the loop stopped
+  bool matched(const CameraKey &pose, float matchMs);
+
+  Phase phase() const;
+  bool stopRequested() const;
+  StopReason stopReason() const;
+  size_t prediction() const;
+  const Settings &settings() const;
+  const std::vector<Iteration> &iterations() const;
+  const CameraKey &currentPose() const;
+  // pose to keep: the converged one, otherwise the best evaluated one
+  const CameraKey &result() const;
+
+ private:
+  Phase m_phase{Phase::IDLE};
+  StopReason m_stopReason{StopReason::NONE};
+  bool m_stopRequested{false};
+  size_t m_prediction{0};
+  Settings m_settings;
+  std::vector<Iteration> m_iterations;
+  CameraKey m_current;
+  CameraKey m_best;
+  float m_bestResidual{std::numeric_limits<float>::max()};
+  int m_stalled{0};
+  float m_renderMs{0.f};
+  float m_residual{0.f};
+};
+
+const char *toString(AutoRefine::StopReason reason);
+
+// Eye movement relative to the viewing distance and rotation in degrees
+// (the larger of the view direction and up vector changes)
+void poseDelta(
+    const CameraKey &a, const CameraKey &b, float &translation, float &rotation);
+
+// 1 - normalized cross correlation between a viewport frame (R8 or RGBA8,
+// columns mirrored as returned by getFrame) and a reference image, sampled
+// at the frame's resolution
+float imageResidual(const uint8_t *frame,
+    size_t bpp,
+    size_t width,
+    size_t height,
+    const Image &reference);
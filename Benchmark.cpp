@@ -0,0 +1,220 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Benchmark.h"
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+// nlohmann
+#include <nlohmann/json.hpp>
+
+// BenchmarkSpec definitions //////////////////////////////////////////////////
+
+bool BenchmarkSpec::parse(const std::string &str, BenchmarkSpec &spec)
+{
+  spec = BenchmarkSpec();
+
+  auto colon = str.find(':');
+  std::string path = str.substr(0, colon);
+  if (path == "orbit")
+    spec.path = Path::ORBIT;
+  else if (path == "zoom")
+    spec.path = Path::ZOOM;
+  else {
+    std::cerr << "ERROR: unknown benchmark path: " << path << '\n';
+    return false;
+  }
+
+  if (colon == std::string::npos)
+    return true;
+
+  std::stringstream ss(str.substr(colon + 1));
+  std::string option;
+  while (std::getline(ss, option, ',')) {
+    auto eq = option.find('=');
+    if (eq == std::string::npos) {
+      std::cerr << "ERROR: invalid benchmark option: " << option << '\n';
+      return false;
+    }
+    std::string key = option.substr(0, eq);
+    std::string value = option.substr(eq + 1);
+    if (key == "frames")
+      spec.frames = std::atoi(value.c_str());
+    else if (key == "warmup")
+      spec.warmup = std::atoi(value.c_str());
+    else if (key == "size") {
+      if (std::sscanf(value.c_str(), "%ix%i", &spec.width, &spec.height) != 2) {
+        std::cerr << "ERROR: invalid benchmark size: " << value << '\n';
+        return false;
+      }
+    } else if (key == "angle")
+      spec.angle = std::atof(value.c_str());
+    else if (key == "zoom")
+      spec.zoom = std::atof(value.c_str());
+    else if (key == "out")
+      spec.output = value;
+    else {
+      std::cerr << "ERROR: unknown benchmark option: " << key << '\n';
+      return false;
+    }
+  }
+
+  if (spec.frames < 1 || spec.warmup < 0 || spec.width < 1 || spec.height < 1
+      || spec.zoom <= 0.f) {
+    std::cerr << "ERROR: invalid benchmark spec: " << str << '\n';
+    return false;
+  }
+  return true;
+}
+
+std::string BenchmarkSpec::pathName() const
+{
+  return path == Path::ORBIT ? "orbit" : "zoom";
+}
+
+CameraPath BenchmarkSpec::cameraPath(const CameraKey &start) const
+{
+  if (path == Path::ORBIT)
+    return CameraPath::orbit(start, angle, 1.f);
+
+  CameraKey end = start;
+  end.eye.x = start.center.x + (start.eye.x - start.center.x) * zoom;
+  end.eye.y = start.center.y + (start.eye.y - start.center.y) * zoom;
+  end.eye.z = start.center.z + (start.eye.z - start.center.z) * zoom;
+  CameraPath result;
+  result.addKey(start);
+  result.addKey(end);
+  return result;
+}
+
+CameraKey BenchmarkSpec::camera(const CameraPath &path, int frame) const
+{
+  int i = frame < warmup ? frame : frame - warmup;
+  float t = frames > 1 ? (i % frames) / float(frames - 1) : 0.f;
+  return path.sample(t);
+}
+
+// BenchmarkStats /////////////////////////////////////////////////////////////
+
+BenchmarkStats computeBenchmarkStats(std::vector<float> values)
+{
+  BenchmarkStats stats;
+  if (values.empty())
+    return stats;
+
+  std::sort(values.begin(), values.end());
+  // nearest-rank percentiles
+  auto percentile = [&](float p) {
+    size_t rank = size_t(std::ceil(p / 100.f * values.size()));
+    return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+  };
+  stats.mean = std::accumulate(values.begin(), values.end(), 0.0)
+      / values.size();
+  stats.p50 = percentile(50.f);
+  stats.p95 = percentile(95.f);
+  stats.p99 = percentile(99.f);
+  stats.min = values.front();
+  stats.max = values.back();
+  return stats;
+}
+
+// BenchmarkRecorder definitions //////////////////////////////////////////////
+
+BenchmarkRecorder::BenchmarkRecorder(BenchmarkSpec spec)
+    : m_spec(std::move(spec))
+{
+  m_deviceMs.reserve(m_spec.frames);
+  m_wallMs.reserve(m_spec.frames);
+}
+
+const BenchmarkSpec &BenchmarkRecorder::spec() const
+{
+  return m_spec;
+}
+
+void BenchmarkRecorder::addFrame(int frame, float deviceMs, float wallMs)
+{
+  if (frame < m_spec.warmup || finished())
+    return;
+  m_deviceMs.push_back(deviceMs);
+  m_wallMs.push_back(wallMs);
+}
+
+bool BenchmarkRecorder::finished() const
+{
+  return int(m_wallMs.size()) >= m_spec.frames;
+}
+
+bool BenchmarkRecorder::write(const BenchmarkInfo &info) const
+{
+  auto statsJson = [](const BenchmarkStats &s) {
+    nlohmann::json j;
+    j["mean"] = s.mean;
+    j["p50"] = s.p50;
+    j["p95"] = s.p95;
+    j["p99"] = s.p99;
+    j["min"] = s.min;
+    j["max"] = s.max;
+    return j;
+  };
+
+  const auto device = computeBenchmarkStats(m_deviceMs);
+  const auto wall = computeBenchmarkStats(m_wallMs);
+
+  nlohmann::json data;
+  for (const auto &[key, value] : info)
+    data["info"][key] = value;
+  data["spec"]["path"] = m_spec.pathName();
+  data["spec"]["frames"] = m_spec.frames;
+  data["spec"]["warmup"] = m_spec.warmup;
+  data["spec"]["width"] = m_spec.width;
+  data["spec"]["height"] = m_spec.height;
+  data["spec"]["angle"] = m_spec.angle;
+  data["spec"]["zoom"] = m_spec.zoom;
+  data["device_ms"] = statsJson(device);
+  data["wall_ms"] = statsJson(wall);
+  data["frames"]["device_ms"] = m_deviceMs;
+  data["frames"]["wall_ms"] = m_wallMs;
+
+  std::string jsonFilename = m_spec.output + ".json";
+  std::ofstream jsonFile(jsonFilename);
+  if (!jsonFile) {
+    std::cerr << "ERROR: could not write benchmark: " << jsonFilename << '\n';
+    return false;
+  }
+  jsonFile << data.dump(4) << '\n';
+
+  std::string csvFilename = m_spec.output + ".csv";
+  std::ofstream csvFile(csvFilename);
+  if (!csvFile) {
+    std::cerr << "ERROR: could not write benchmark: " << csvFilename << '\n';
+    return false;
+  }
+  csvFile << "frame,device_ms,wall_ms\n";
+  for (size_t i = 0; i < m_wallMs.size(); ++i)
+    csvFile << i << ',' << m_deviceMs[i] << ',' << m_wallMs[i] << '\n';
+
+  printf("benchmark (%s, %i frames, %i x %i):\n",
+      m_spec.pathName().c_str(),
+      int(m_wallMs.size()),
+      m_spec.width,
+      m_spec.height);
+  printf("  device: mean %.2fms p50 %.2fms p95 %.2fms p99 %.2fms\n",
+      device.mean,
+      device.p50,
+      device.p95,
+      device.p99);
+  printf("  wall:   mean %.2fms p50 %.2fms p95 %.2fms p99 %.2fms\n",
+      wall.mean,
+      wall.p50,
+      wall.p95,
+      wall.p99);
+  std::cout << "Benchmark written to: " << jsonFilename << ", " << csvFilename
+            << '\n';
+  return true;
+}
@@ -0,0 +1,85 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <string>
+#include <utility>
+#include <vector>
+// ours
+#include "CameraPath.h"
+
+// Scripted benchmark run, parsed from "<orbit|zoom>[:key=value,...]" with
+// keys frames, warmup, size (<w>x<h>), angle (orbit, degrees about the up
+// vector), zoom (final eye distance relative to the start) and out (file
+// base name, <out>.json and <out>.csv are written). Example:
+// "orbit:frames=200,warmup=20,size=1024x1024,angle=360,out=bench"
+struct BenchmarkSpec
+{
+  enum class Path
+  {
+    ORBIT,
+    ZOOM,
+  };
+
+  Path path{Path::ORBIT};
+  int frames{100};
+  int warmup{10};
+  int width{1024};
+  int height{1024};
+  float angle{360.f};
+  float zoom{.5f};
+  std::string output{"benchmark"};
+
+  static bool parse(const std::string &str, BenchmarkSpec &spec);
+
+  std::string pathName() const;
+
+  // deterministic path starting at the given camera
+  CameraPath cameraPath(const CameraKey &start) const;
+
+  // camera for frame index (warmup frames replay the start of the path)
+  CameraKey camera(const CameraPath &path, int frame) const;
+
+  int totalFrames() const
+  {
+    return warmup + frames;
+  }
+};
+
+struct BenchmarkStats
+{
+  float mean{0.f};
+  float p50{0.f};
+  float p95{0.f};
+  float p99{0.f};
+  float min{0.f};
+  float max{0.f};
+};
+
+BenchmarkStats computeBenchmarkStats(std::vector<float> values);
+
+using BenchmarkInfo = std::vector<std::pair<std::string, std::string>>;
+
+// Collects per-frame latencies (milliseconds) of the measured frames and
+// writes them with summary statistics as JSON and CSV
+class BenchmarkRecorder
+{
+ public:
+  explicit BenchmarkRecorder(BenchmarkSpec spec);
+
+  const BenchmarkSpec &spec() const;
+
+  // frame counts warmup frames, which are not recorded
+  void addFrame(int frame, float deviceMs, float wallMs);
+  bool finished() const;
+
+  // info: free-form key/value pairs (library, renderer, volume, ...)
+  bool write(const BenchmarkInfo &info) const;
+
+ private:
+  BenchmarkSpec m_spec;
+  std::vector<float> m_deviceMs;
+  std::vector<float> m_wallMs;
+};
@@ -0,0 +1,117 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// anari
+#include <anari/anari_cpp/ext/linalg.h>
+// std
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+struct CameraKey
+{
+  anari::math::float3 eye;
+  anari::math::float3 center;
+  anari::math::float3 up;
+};
+
+// Rodrigues rotation of v about the unit axis
+inline anari::math::float3 rotate(const anari::math::float3 &v,
+    const anari::math::float3 &axis,
+    float radians)
+{
+  const float c = std::cos(radians), s = std::sin(radians);
+  return v * c + anari::math::cross(axis, v) * s
+      + axis * (anari::math::dot(axis, v) * (1.f - c));
+}
+
+// Keyframed camera path. Eye and center are interpolated with a uniform
+// Catmull-Rom spline through the keys, up is interpolated linearly and
+// renormalized.
+class CameraPath
+{
+ public:
+  void addKey(const CameraKey &key)
+  {
+    m_keys.push_back(key);
+  }
+
+  void clear()
+  {
+    m_keys.clear();
+  }
+
+  bool empty() const
+  {
+    return m_keys.empty();
+  }
+
+  size_t size() const
+  {
+    return m_keys.size();
+  }
+
+  const std::vector<CameraKey> &keys() const
+  {
+    return m_keys;
+  }
+
+  // t in [0, 1] spans the whole path
+  CameraKey sample(float t) const
+  {
+    if (m_keys.size() < 2)
+      return m_keys.empty() ? CameraKey{} : m_keys[0];
+
+    const int last = int(m_keys.size()) - 1;
+    float s = std::clamp(t, 0.f, 1.f) * last;
+    int i = std::min(int(s), last - 1);
+    float f = s - i;
+
+    auto key = [&](int k) -> const CameraKey & {
+      return m_keys[std::clamp(k, 0, last)];
+    };
+    const CameraKey &k0 = key(i - 1), &k1 = key(i), &k2 = key(i + 1),
+                    &k3 = key(i + 2);
+
+    CameraKey result;
+    result.eye = catmullRom(k0.eye, k1.eye, k2.eye, k3.eye, f);
+    result.center = catmullRom(k0.center, k1.center, k2.center, k3.center, f);
+    result.up = anari::math::normalize(k1.up * (1.f - f) + k2.up * f);
+    return result;
+  }
+
+  // C-arm like sweep: rotate the eye of start around its center, about the
+  // up vector, by angleDeg degrees; keys every stepDeg degrees
+  static CameraPath orbit(
+      const CameraKey &start, float angleDeg, float stepDeg = 5.f)
+  {
+    CameraPath path;
+    const int numKeys =
+        std::max(2, int(std::ceil(std::abs(angleDeg) / stepDeg)) + 1);
+    const anari::math::float3 axis = anari::math::normalize(start.up);
+    const anari::math::float3 r = start.eye - start.center;
+    for (int i = 0; i < numKeys; ++i) {
+      float phi = angleDeg * float(M_PI) / 180.f * i / (numKeys - 1);
+      path.addKey({start.center + rotate(r, axis, phi), start.center, start.up});
+    }
+    return path;
+  }
+
+ private:
+  static anari::math::float3 catmullRom(const anari::math::float3 &p0,
+      const anari::math::float3 &p1,
+      const anari::math::float3 &p2,
+      const anari::math::float3 &p3,
+      float t)
+  {
+    float t2 = t * t, t3 = t2 * t;
+    return ((p1 * 2.f) + (p2 - p0) * t
+               + (p0 * 2.f - p1 * 5.f + p2 * 4.f - p3) * t2
+               + (p1 * 3.f - p0 - p2 * 3.f + p3) * t3)
+        * .5f;
+  }
+
+  std::vector<CameraKey> m_keys;
+};
@@ -0,0 +1,362 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#include "CpuDrrRenderer.h"
+// std
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+namespace {
+
+constexpr int TILE_SIZE = 32;
+
+struct vec3
+{
+  float x, y, z;
+};
+
+inline vec3 operator+(vec3 a, vec3 b)
+{
+  return {a.x + b.x, a.y + b.y, a.z + b.z};
+}
+
+inline vec3 operator-(vec3 a, vec3 b)
+{
+  return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+inline vec3 operator*(vec3 a, float s)
+{
+  return {a.x * s, a.y * s, a.z * s};
+}
+
+inline vec3 cross(vec3 a, vec3 b)
+{
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+inline vec3 normalize(vec3 a)
+{
+  float len = std::sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
+  return len > 0.f ? a * (1.f / len) : a;
+}
+
+inline vec3 toVec3(const anari::math::float3 &v)
+{
+  return {v.x, v.y, v.z};
+}
+
+// Read-only view of the field, values normalized like ANARI UFIXED types
+struct FieldView
+{
+  int dims[3];
+  float spacing[3];
+  unsigned bytesPerCell;
+  const uint8_t *ui8;
+  const uint16_t *ui16;
+  const float *f32;
+  // voxels rays march through, inclusive
+  int lo[3];
+  int hi[3];
+
+  float value(int x, int y, int z) const
+  {
+    size_t i = x + dims[0] * (y + size_t(dims[1]) * z);
+    if (bytesPerCell == 1)
+      return ui8[i] * (1.f / 255.f);
+    else if (bytesPerCell == 2)
+      return ui16[i] * (1.f / 65535.f);
+    return f32[i];
+  }
+
+  // trilinear interpolation at voxel coordinates g of data (the field's
+  // voxels as T, scaled by norm); resolving the type once per ray keeps the
+  // eight loads of a sample free of branches
+  template <typename T>
+  float trilinear(const T *data, float norm, float gx, float gy, float gz) const
+  {
+    gx = std::clamp(gx, 0.f, float(dims[0] - 1));
+    gy = std::clamp(gy, 0.f, float(dims[1] - 1));
+    gz = std::clamp(gz, 0.f, float(dims[2] - 1));
+    const int x0 = std::min(int(gx), std::max(dims[0] - 2, 0));
+    const int y0 = std::min(int(gy), std::max(dims[1] - 2, 0));
+    const int z0 = std::min(int(gz), std::max(dims[2] - 2, 0));
+    const size_t sx = dims[0] > 1 ? 1 : 0;
+    const size_t sy = dims[1] > 1 ? size_t(dims[0]) : 0;
+    const size_t sz = dims[2] > 1 ? size_t(dims[0]) * dims[1] : 0;
+    const T *p = data + x0 + dims[0] * (y0 + size_t(dims[1]) * z0);
+    const float fx = gx - x0, fy = gy - y0, fz = gz - z0;
+    auto lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+    const float c00 = lerp(float(p[0]), float(p[sx]), fx);
+    const float c10 = lerp(float(p[sy]), float(p[sy + sx]), fx);
+    const float c01 = lerp(float(p[sz]), float(p[sz + sx]), fx);
+    const float c11 = lerp(float(p[sz + sy]), float(p[sz + sy + sx]), fx);
+    return lerp(lerp(c00, c10, fy), lerp(c01, c11, fy), fz) * norm;
+  }
+};
+
+// slab test against [lo, hi], returns false if the ray misses the box
+inline bool clipRay(
+    vec3 ori, vec3 dir, vec3 lo, vec3 hi, float &tEnter, float &tExit)
+{
+  float o[3] = {ori.x, ori.y, ori.z};
+  float d[3] = {dir.x, dir.y, dir.z};
+  float l[3] = {lo.x, lo.y, lo.z};
+  float h[3] = {hi.x, hi.y, hi.z};
+  tEnter = 0.f;
+  tExit = std::numeric_limits<float>::max();
+  for (int a = 0; a < 3; ++a) {
+    float inv = 1.f / d[a];
+    float tn = (l[a] - o[a]) * inv;
+    float tf = (h[a] - o[a]) * inv;
+    if (tn > tf)
+      std::swap(tn, tf);
+    tEnter = std::max(tEnter, tn);
+    tExit = std::min(tExit, tf);
+  }
+  return tEnter < tExit;
+}
+
+struct RayResult
+{
+  float integral{0.f};
+  vec3 weightedPos{0.f, 0.f, 0.f};
+};
+
+// Amanatides-Woo traversal computing Siddon's exact intersection lengths
+RayResult traceSiddon(const FieldView &f, vec3 ori, vec3 dir)
+{
+  RayResult res;
+  const float s[3] = {f.spacing[0], f.spacing[1], f.spacing[2]};
+  vec3 lo{(f.lo[0] - .5f) * s[0],
+      (f.lo[1] - .5f) * s[1],
+      (f.lo[2] - .5f) * s[2]};
+  vec3 hi{(f.hi[0] + .5f) * s[0],
+      (f.hi[1] + .5f) * s[1],
+      (f.hi[2] + .5f) * s[2]};
+  float t, tExit;
+  if (!clipRay(ori, dir, lo, hi, t, tExit))
+    return res;
+
+  const float o[3] = {ori.x, ori.y, ori.z};
+  const float d[3] = {dir.x, dir.y, dir.z};
+  int cell[3], step[3];
+  float tMax[3], tDelta[3];
+  for (int a = 0; a < 3; ++a) {
+    float p = o[a] + d[a] * t;
+    cell[a] = std::clamp(int(std::floor(p / s[a] + .5f)), f.lo[a], f.hi[a]);
+    if (d[a] > 0.f) {
+      step[a] = 1;
+      tMax[a] = ((cell[a] + .5f) * s[a] - o[a]) / d[a];
+      tDelta[a] = s[a] / d[a];
+    } else if (d[a] < 0.f) {
+      step[a] = -1;
+      tMax[a] = ((cell[a] - .5f) * s[a] - o[a]) / d[a];
+      tDelta[a] = -s[a] / d[a];
+    } else {
+      step[a] = 0;
+      tMax[a] = std::numeric_limits<float>::max();
+      tDelta[a] = std::numeric_limits<float>::max();
+    }
+  }
+
+  while (t < tExit) {
+    int a = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2)
+                              : (tMax[1] < tMax[2] ? 1 : 2);
+    float tNext = std::min(tMax[a], tExit);
+    float len = tNext - t;
+    float v = f.value(cell[0], cell[1], cell[2]) * len;
+    res.integral += v;
+    res.weightedPos = res.weightedPos + (ori + dir * (t + .5f * len)) * v;
+    t = tNext;
+    cell[a] += step[a];
+    if (cell[a] < f.lo[a] || cell[a] > f.hi[a])
+      break;
+    tMax[a] += tDelta[a];
+  }
+  return res;
+}
+
+// Fixed step trilinear sampling through the volume of interest
+template <typename T>
+RayResult traceTrilinear(
+    const FieldView &f, const T *data, float norm, vec3 ori, vec3 dir, float dt)
+{
+  RayResult res;
+  const vec3 lo{f.lo[0] * f.spacing[0],
+      f.lo[1] * f.spacing[1],
+      f.lo[2] * f.spacing[2]};
+  const vec3 hi{f.hi[0] * f.spacing[0],
+      f.hi[1] * f.spacing[1],
+      f.hi[2] * f.spacing[2]};
+  float t0, t1;
+  if (!clipRay(ori, dir, lo, hi, t0, t1))
+    return res;
+
+  // sample positions in voxel units
+  const vec3 o{ori.x / f.spacing[0], ori.y / f.spacing[1], ori.z / f.spacing[2]};
+  const vec3 d{dir.x / f.spacing[0], dir.y / f.spacing[1], dir.z / f.spacing[2]};
+  const float tStart = t0 + .5f * dt;
+  const int steps = std::max(0, int(std::ceil((t1 - tStart) / dt)));
+  float sum = 0.f, wt = 0.f;
+  for (int i = 0; i < steps; ++i) {
+    const float t = tStart + i * dt;
+    const float v =
+        f.trilinear(data, norm, o.x + d.x * t, o.y + d.y * t, o.z + d.z * t);
+    sum += v;
+    wt += v * t;
+  }
+  // the weighted position is along the ray: sum_i v_i (ori + dir t_i)
+  res.integral = sum * dt;
+  res.weightedPos = (ori * sum + dir * wt) * dt;
+  return res;
+}
+
+} // namespace
+
+void CpuDrrRenderer::setField(const StructuredField *field)
+{
+  m_field = field;
+}
+
+const StructuredField *CpuDrrRenderer::field() const
+{
+  return m_field;
+}
+
+void CpuDrrRenderer::setSampling(Sampling sampling)
+{
+  m_sampling = sampling;
+}
+
+CpuDrrRenderer::Sampling CpuDrrRenderer::sampling() const
+{
+  return m_sampling;
+}
+
+void CpuDrrRenderer::setStepSize(float step)
+{
+  m_stepSize = std::max(step, 1e-3f);
+}
+
+void CpuDrrRenderer::setNumThreads(unsigned numThreads)
+{
+  m_numThreads = numThreads;
+}
+
+void CpuDrrRenderer::setVolumeOfInterest(const VolumeOfInterest &voi)
+{
+  m_voi = voi;
+}
+
+const VolumeOfInterest &CpuDrrRenderer::volumeOfInterest() const
+{
+  return m_voi;
+}
+
+bool CpuDrrRenderer::render(const CpuDrrCamera &camera,
+    int width,
+    int height,
+    CpuDrrFrame &frame,
+    const std::atomic<bool> *cancel) const
+{
+  if (!m_field || m_field->empty() || width <= 0 || height <= 0)
+    return false;
+
+  frame.width = width;
+  frame.height = height;
+  frame.lineIntegral.resize(size_t(width) * height);
+  frame.origin.resize(size_t(width) * height);
+
+  const VolumeOfInterest voi = m_voi.clippedTo(*m_field);
+  if (voi.empty())
+    return false;
+  const FieldView fv{{m_field->dimX, m_field->dimY, m_field->dimZ},
+      {m_field->spacingX, m_field->spacingY, m_field->spacingZ},
+      m_field->bytesPerCell,
+      m_field->dataUI8.data(),
+      m_field->dataUI16.data(),
+      m_field->dataF32.data(),
+      {voi.lo[0], voi.lo[1], voi.lo[2]},
+      {voi.hi[0], voi.hi[1], voi.hi[2]}};
+
+  // same basis as visionaray::pinhole_camera::begin_frame()
+  const vec3 eye = toVec3(camera.eye);
+  const vec3 f = normalize(eye - toVec3(camera.center));
+  const vec3 s = normalize(cross(toVec3(camera.up), f));
+  const vec3 u = cross(f, s);
+  const float tanHalf = std::tan(camera.fovy * .5f);
+  const vec3 U = s * (tanHalf * camera.aspect);
+  const vec3 V = u * tanHalf;
+  const vec3 W = f * -1.f;
+
+  const float dt = m_stepSize
+      * std::min({fv.spacing[0], fv.spacing[1], fv.spacing[2]});
+
+  auto rayDir = [&](int x, int y) {
+    float su = 2.f * (x + .5f) / width - 1.f;
+    float sv = 2.f * (y + .5f) / height - 1.f;
+    return normalize(U * su + V * sv + W);
+  };
+
+  auto store = [&](int x, int y, const RayResult &r) {
+    size_t i = size_t(y) * width + x;
+    frame.lineIntegral[i] = r.integral;
+    if (r.integral > 0.f) {
+      vec3 p = r.weightedPos * (1.f / r.integral);
+      frame.origin[i] = {p.x, p.y, p.z};
+    } else {
+      frame.origin[i] = {0.f, 0.f, 0.f};
+    }
+  };
+
+  auto renderTile = [&](int tx, int ty) {
+    int x0 = tx * TILE_SIZE, y0 = ty * TILE_SIZE;
+    int x1 = std::min(x0 + TILE_SIZE, width);
+    int y1 = std::min(y0 + TILE_SIZE, height);
+    for (int y = y0; y < y1; ++y) {
+      if (m_sampling == Sampling::SIDDON) {
+        for (int x = x0; x < x1; ++x)
+          store(x, y, traceSiddon(fv, eye, rayDir(x, y)));
+        continue;
+      }
+      for (int x = x0; x < x1; ++x) {
+        const vec3 dir = rayDir(x, y);
+        if (fv.bytesPerCell == 1)
+          store(x, y, traceTrilinear(fv, fv.ui8, 1.f / 255.f, eye, dir, dt));
+        else if (fv.bytesPerCell == 2)
+          store(x, y, traceTrilinear(fv, fv.ui16, 1.f / 65535.f, eye, dir, dt));
+        else
+          store(x, y, traceTrilinear(fv, fv.f32, 1.f, eye, dir, dt));
+      }
+    }
+  };
+
+  const int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+  const int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+  const int numTiles = tilesX * tilesY;
+  std::atomic<int> nextTile{0};
+
+  auto worker = [&]() {
+    for (int t = nextTile++; t < numTiles; t = nextTile++) {
+      if (cancel && *cancel)
+        return;
+      renderTile(t % tilesX, t / tilesX);
+    }
+  };
+
+  unsigned numThreads =
+      m_numThreads ? m_numThreads : std::thread::hardware_concurrency();
+  numThreads = std::clamp(numThreads, 1u, unsigned(numTiles));
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < numThreads; ++i)
+    threads.emplace_back(worker);
+  worker();
+  for (auto &t : threads)
+    t.join();
+
+  return !(cancel && *cancel);
+}
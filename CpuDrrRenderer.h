@@ -0,0 +1,83 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <vector>
+// anari
+#include "anari/anari_cpp/ext/linalg.h" // math::float3
+// ours
+#include "FieldTypes.h"
+#include "VolumeOfInterest.h"
+
+// Pinhole camera, same model (basis and pixel mapping) as
+// visionaray::pinhole_camera: pixel (x, y) maps to
+// u = 2 * (x + .5) / width - 1 and v = 2 * (y + .5) / height - 1,
+// row 0 is the bottom row.
+struct CpuDrrCamera
+{
+  anari::math::float3 eye{0.f, 0.f, 0.f};
+  anari::math::float3 center{0.f, 0.f, -1.f};
+  anari::math::float3 up{0.f, 1.f, 0.f};
+  float fovy{0.7f}; // radians
+  float aspect{1.f};
+};
+
+struct CpuDrrFrame
+{
+  int width{0};
+  int height{0};
+  // attenuation line integral per pixel
+  std::vector<float> lineIntegral;
+  // attenuation weighted mean position along the ray per pixel
+  std::vector<anari::math::float3> origin;
+};
+
+// Reference DRR ray caster operating directly on a StructuredField. Values
+// are interpreted like the ANARI structuredRegular field: float32 as is,
+// uint8/uint16 normalized to [0, 1], voxel i located at i * spacing.
+class CpuDrrRenderer
+{
+ public:
+  enum class Sampling
+  {
+    // exact voxel traversal, cells of constant value centered at the voxels
+    SIDDON,
+    // fixed step trilinear sampling
+    TRILINEAR
+  };
+
+  CpuDrrRenderer() = default;
+
+  void setField(const StructuredField *field);
+  const StructuredField *field() const;
+  void setSampling(Sampling sampling);
+  Sampling sampling() const;
+  // step size in voxels (trilinear sampling only)
+  void setStepSize(float step);
+  // 0 picks std::thread::hardware_concurrency()
+  void setNumThreads(unsigned numThreads);
+  // rays only march through these voxels (all if empty)
+  void setVolumeOfInterest(const VolumeOfInterest &voi);
+  const VolumeOfInterest &volumeOfInterest() const;
+
+  // Render into frame (resized to width x height). Thread-safe w.r.t. other
+  // render() calls as long as the field is not modified. Returns false if the
+  // frame was cancelled, there's no field or the volume of interest misses
+  // it.
+  bool render(const CpuDrrCamera &camera,
+      int width,
+      int height,
+      CpuDrrFrame &frame,
+      const std::atomic<bool> *cancel = nullptr) const;
+
+ private:
+  const StructuredField *m_field{nullptr};
+  Sampling m_sampling{Sampling::TRILINEAR};
+  float m_stepSize{.5f};
+  unsigned m_numThreads{0};
+  VolumeOfInterest m_voi;
+};
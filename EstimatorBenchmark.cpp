@@ -0,0 +1,280 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#include "EstimatorBenchmark.h"
+// std
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+// ours
+#include "AutoRefine.h" // poseDelta
+#include "Benchmark.h" // computeBenchmarkStats
+#include "Registration.h" // frameForEstimator
+
+// EstimatorBenchmarkSpec definitions /////////////////////////////////////////
+
+bool EstimatorBenchmarkSpec::parse(
+    const std::string &str, EstimatorBenchmarkSpec &spec)
+{
+  spec = EstimatorBenchmarkSpec();
+
+  // the first size/translation/rotation replaces the default, repeated ones
+  // are added
+  bool sizesSet = false, translationsSet = false, rotationsSet = false;
+
+  std::stringstream ss(str);
+  std::string option;
+  while (std::getline(ss, option, ',')) {
+    if (option.empty())
+      continue;
+    auto eq = option.find('=');
+    if (eq == std::string::npos) {
+      std::cerr << "ERROR: invalid estimator benchmark option: " << option
+                << '\n';
+      return false;
+    }
+    std::string key = option.substr(0, eq);
+    std::string value = option.substr(eq + 1);
+    if (key == "trials")
+      spec.trials = std::atoi(value.c_str());
+    else if (key == "size") {
+      int w, h;
+      if (std::sscanf(value.c_str(), "%ix%i", &w, &h) != 2 || w < 1 || h < 1) {
+        std::cerr << "ERROR: invalid estimator benchmark size: " << value
+                  << '\n';
+        return false;
+      }
+      if (!sizesSet)
+        spec.sizes.clear();
+      sizesSet = true;
+      spec.sizes.emplace_back(w, h);
+    } else if (key == "translation") {
+      if (!translationsSet)
+        spec.translations.clear();
+      translationsSet = true;
+      spec.translations.push_back(std::atof(value.c_str()));
+    } else if (key == "rotation") {
+      if (!rotationsSet)
+        spec.rotations.clear();
+      rotationsSet = true;
+      spec.rotations.push_back(std::atof(value.c_str()));
+    } else if (key == "seed")
+      spec.seed = std::atoi(value.c_str());
+    else if (key == "out")
+      spec.output = value;
+    else {
+      std::cerr << "ERROR: unknown estimator benchmark option: " << key << '\n';
+      return false;
+    }
+  }
+
+  if (spec.trials < 1) {
+    std::cerr << "ERROR: invalid estimator benchmark spec: " << str << '\n';
+    return false;
+  }
+  return true;
+}
+
+// Helper functions ///////////////////////////////////////////////////////////
+
+static anari::math::float3 randomDirection(std::mt19937 &rng)
+{
+  std::normal_distribution<float> n;
+  for (;;) {
+    anari::math::float3 d{n(rng), n(rng), n(rng)};
+    float l = anari::math::length(d);
+    if (l > 1e-6f)
+      return d / l;
+  }
+}
+
+CameraKey perturbPose(const CameraKey &pose,
+    float translation,
+    float rotation,
+    std::mt19937 &rng)
+{
+  const float distance = anari::math::length(pose.center - pose.eye);
+  const auto offset = randomDirection(rng) * (translation * distance);
+  const auto axis = randomDirection(rng);
+  const float radians = rotation * float(M_PI) / 180.f;
+
+  CameraKey result;
+  result.eye = pose.eye + offset;
+  result.center = result.eye + rotate(pose.center - pose.eye, axis, radians);
+  result.up = rotate(pose.up, axis, radians);
+  return result;
+}
+
+static float elapsedMs(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<float, std::milli>(
+      std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// EstimatorBenchmark /////////////////////////////////////////////////////////
+
+namespace {
+
+enum Call
+{
+  SET_REFERENCE,
+  SET_DEPTH,
+  SET_QUERY,
+  CALIBRATE,
+  MATCH,
+  UPDATE_CAMERA,
+  NUM_CALLS
+};
+
+const char *callNames[NUM_CALLS] = {"set_reference_ms",
+    "set_depth_ms",
+    "set_query_ms",
+    "calibrate_ms",
+    "match_ms",
+    "update_camera_ms"};
+
+} // namespace
+
+bool runEstimatorBenchmark(const EstimatorBenchmarkSpec &spec,
+    const CpuDrrRenderer &renderer,
+    ImageTransformEstimatorWrapper &estimators,
+    const CameraKey &groundTruth,
+    float fovy)
+{
+  std::string csvFilename = spec.output + ".csv";
+  std::ofstream csvFile(csvFilename);
+  if (!csvFile) {
+    std::cerr << "ERROR: could not write estimator benchmark: " << csvFilename
+              << '\n';
+    return false;
+  }
+  csvFile << "estimator,width,height,translation,rotation,trial";
+  for (auto *name : callNames)
+    csvFile << ',' << name;
+  csvFile << ",total_ms,initial_translation_error,initial_rotation_error"
+          << ",translation_error,rotation_error\n";
+
+  CpuDrrFrame frame;
+  std::vector<uint8_t> reference, query;
+  std::vector<float> referenceDepth3d, depth3d;
+
+  for (size_t e = 0; e < estimators.m_estimators.size(); ++e) {
+    auto *estimator = estimators.m_estimators[e];
+    const auto &name = estimators.m_estimatorNames[e];
+    for (auto [width, height] : spec.sizes) {
+      const float aspect = width / float(height);
+      CpuDrrCamera camera{
+          groundTruth.eye, groundTruth.center, groundTruth.up, fovy, aspect};
+      if (!renderer.render(camera, width, height, frame))
+        return false;
+      // same layout as "use framebuffer as reference" in the viewer
+      frameForEstimator(frame, reference, referenceDepth3d);
+
+      for (float translation : spec.translations) {
+        for (float rotation : spec.rotations) {
+          // same perturbations for every estimator and size
+          std::mt19937 rng(spec.seed);
+          std::vector<float> matchMs, translationErrors, rotationErrors;
+
+          for (int trial = 0; trial < spec.trials; ++trial) {
+            const auto start =
+                perturbPose(groundTruth, translation, rotation, rng);
+            camera = {start.eye, start.center, start.up, fovy, aspect};
+            if (!renderer.render(camera, width, height, frame))
+              return false;
+            frameForEstimator(frame, query, depth3d);
+
+            float ms[NUM_CALLS];
+            auto t0 = std::chrono::steady_clock::now();
+            estimator->set_image(reference.data(),
+                width,
+                height,
+                image_transform_estimator::PIXEL_TYPE::R8,
+                image_transform_estimator::IMAGE_TYPE::REFERENCE,
+                false /*swizzle*/);
+            ms[SET_REFERENCE] = elapsedMs(t0);
+
+            t0 = std::chrono::steady_clock::now();
+            estimator->set_image(depth3d.data(),
+                width,
+                height,
+                image_transform_estimator::PIXEL_TYPE::F32X3,
+                image_transform_estimator::IMAGE_TYPE::DEPTH3D,
+                false /*swizzle*/);
+            ms[SET_DEPTH] = elapsedMs(t0);
+
+            t0 = std::chrono::steady_clock::now();
+            estimator->set_image(query.data(),
+                width,
+                height,
+                image_transform_estimator::PIXEL_TYPE::R8,
+                image_transform_estimator::IMAGE_TYPE::QUERY,
+                false /*swizzle*/);
+            ms[SET_QUERY] = elapsedMs(t0);
+
+            t0 = std::chrono::steady_clock::now();
+            estimator->calibrate(width, height, fovy, aspect);
+            ms[CALIBRATE] = elapsedMs(t0);
+
+            t0 = std::chrono::steady_clock::now();
+            estimator->match();
+            ms[MATCH] = elapsedMs(t0);
+
+            std::array<float, 3> eye{start.eye.x, start.eye.y, start.eye.z};
+            std::array<float, 3> center{
+                start.center.x, start.center.y, start.center.z};
+            std::array<float, 3> up{start.up.x, start.up.y, start.up.z};
+            t0 = std::chrono::steady_clock::now();
+            estimator->update_camera(eye, center, up);
+            ms[UPDATE_CAMERA] = elapsedMs(t0);
+
+            CameraKey updated{{eye[0], eye[1], eye[2]},
+                {center[0], center[1], center[2]},
+                {up[0], up[1], up[2]}};
+            float t0Error, r0Error, tError, rError;
+            poseDelta(groundTruth, start, t0Error, r0Error);
+            poseDelta(groundTruth, updated, tError, rError);
+
+            float total = 0.f;
+            csvFile << name << ',' << width << ',' << height << ','
+                    << translation << ',' << rotation << ',' << trial;
+            for (float m : ms) {
+              csvFile << ',' << m;
+              total += m;
+            }
+            csvFile << ',' << total << ',' << t0Error << ',' << r0Error << ','
+                    << tError << ',' << rError << '\n';
+
+            matchMs.push_back(ms[MATCH]);
+            translationErrors.push_back(tError);
+            rotationErrors.push_back(rError);
+          }
+
+          auto m = computeBenchmarkStats(matchMs);
+          auto t = computeBenchmarkStats(translationErrors);
+          auto r = computeBenchmarkStats(rotationErrors);
+          printf("%s %ix%i translation %.3g rotation %.3gdeg: match p50 "
+                 "%.1fms, error p50 %.2e / %.3fdeg, p95 %.2e / %.3fdeg\n",
+              name.c_str(),
+              width,
+              height,
+              translation,
+              rotation,
+              m.p50,
+              t.p50,
+              r.p50,
+              t.p95,
+              r.p95);
+        }
+      }
+    }
+  }
+
+  std::cout << "Estimator benchmark written to: " << csvFilename << '\n';
+  return true;
+}
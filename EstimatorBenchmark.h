@@ -0,0 +1,47 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <random>
+#include <string>
+#include <vector>
+// ours
+#include "CameraPath.h" // CameraKey, rotate
+#include "CpuDrrRenderer.h"
+#include "ImageTransformEstimatorWrapper.h"
+
+// Accuracy/throughput run of all loaded estimators against synthetic ground
+// truth, parsed from "key=value,..." with keys trials, size (<w>x<h>),
+// translation (relative to the viewing distance), rotation (degrees), seed
+// and out (file base name, <out>.csv is written). size, translation and
+// rotation may be repeated, every combination is run. Example:
+// "trials=20,size=512x512,size=1024x1024,translation=.02,rotation=2"
+struct EstimatorBenchmarkSpec
+{
+  int trials{10};
+  std::vector<std::pair<int, int>> sizes{{512, 512}};
+  std::vector<float> translations{.02f};
+  std::vector<float> rotations{2.f};
+  unsigned seed{1};
+  std::string output{"estimator-benchmark"};
+
+  static bool parse(const std::string &str, EstimatorBenchmarkSpec &spec);
+};
+
+// Move eye and center by `translation` times the viewing distance and turn
+// the view about the eye by `rotation` degrees, both in random directions
+CameraKey perturbPose(const CameraKey &pose,
+    float translation,
+    float rotation,
+    std::mt19937 &rng);
+
+// Render the reference at groundTruth and, per trial, the query at a
+// perturbed pose; time each estimator call and record the pose error of the
+// updated camera. Returns false if nothing could be written.
+bool runEstimatorBenchmark(const EstimatorBenchmarkSpec &spec,
+    const CpuDrrRenderer &renderer,
+    ImageTransformEstimatorWrapper &estimators,
+    const CameraKey &groundTruth,
+    float fovy);
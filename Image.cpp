@@ -0,0 +1,409 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Image.h"
+// visionaray
+#include <common/image.h>
+// stb_image
+#include "stb_image/stb_image.h"
+// std
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+
+namespace {
+
+bool endsWith(const std::string &str, const std::string &suffix)
+{
+  if (str.size() < suffix.size())
+    return false;
+  return std::equal(suffix.rbegin(), suffix.rend(), str.rbegin(),
+      [](char a, char b) { return std::tolower(a) == std::tolower(b); });
+}
+
+// binary PGM/PPM header; returns false on anything unexpected
+bool readPNMHeader(std::ifstream &file, char &magic, int &w, int &h, int &maxval)
+{
+  std::string p;
+  file >> p;
+  if (p.size() != 2 || p[0] != 'P')
+    return false;
+  magic = p[1];
+  auto next = [&](int &v) {
+    file >> std::ws;
+    while (file.peek() == '#') {
+      std::string comment;
+      std::getline(file, comment);
+      file >> std::ws;
+    }
+    return bool(file >> v);
+  };
+  if (!next(w) || !next(h) || !next(maxval))
+    return false;
+  file.get(); // single whitespace before the raster
+  return w > 0 && h > 0;
+}
+
+// 16 bit binary PGM (big endian, as written by anariDRRHeadless), rows are
+// flipped to bottom to top
+bool loadPGM16(const std::string &filename, Image &image)
+{
+  std::ifstream file(filename, std::ios::binary);
+  char magic;
+  int w, h, maxval;
+  if (!readPNMHeader(file, magic, w, h, maxval) || magic != '5'
+      || maxval < 256 || maxval > 65535)
+    return false;
+
+  std::vector<uint8_t> raw(size_t(w) * h * 2);
+  if (!file.read((char *)raw.data(), raw.size()))
+    return false;
+  std::vector<uint16_t> pixels(size_t(w) * h);
+  for (int y = 0; y < h; ++y) {
+    const uint8_t *src = raw.data() + size_t(h - 1 - y) * w * 2;
+    uint16_t *dst = pixels.data() + size_t(y) * w;
+    for (int x = 0; x < w; ++x)
+      dst[x] = uint16_t(src[2 * x] << 8 | src[2 * x + 1]);
+  }
+  image = Image(w, h, Image::PixelType::R16, pixels.data());
+  return true;
+}
+
+// portable float map (Pf: gray, PF: RGB), stored bottom to top, like the
+// other loaders' output
+bool loadPFM(const std::string &filename, Image &image)
+{
+  std::ifstream file(filename, std::ios::binary);
+  std::string magic;
+  int w, h;
+  float scale;
+  if (!(file >> magic >> w >> h >> scale) || (magic != "Pf" && magic != "PF"))
+    return false;
+  file.get();
+
+  const int comps = magic == "Pf" ? 1 : 3;
+  std::vector<float> pixels(size_t(w) * h * comps);
+  if (!file.read((char *)pixels.data(), pixels.size() * sizeof(float)))
+    return false;
+  if (scale > 0.f) {
+    // big endian
+    for (auto &v : pixels) {
+      uint32_t u;
+      std::memcpy(&u, &v, 4);
+      u = __builtin_bswap32(u);
+      std::memcpy(&v, &u, 4);
+    }
+  }
+  if (comps == 3) {
+    // keep the luminance
+    for (size_t i = 0; i < size_t(w) * h; ++i) {
+      pixels[i] = .2126f * pixels[3 * i] + .7152f * pixels[3 * i + 1]
+          + .0722f * pixels[3 * i + 2];
+    }
+  }
+  image = Image(w, h, Image::PixelType::R32F, pixels.data());
+  return true;
+}
+
+// PNG, JPEG, BMP, TGA, PSD, HDR, 8 bit PNM. Rows are flipped to bottom to top
+// to match visionaray's loaders.
+bool loadSTB(const std::string &filename, Image &image)
+{
+  const char *fn = filename.c_str();
+  int w, h, comps;
+  if (!stbi_info(fn, &w, &h, &comps))
+    return false;
+
+  stbi_set_flip_vertically_on_load_thread(1); // loaders run concurrently
+  bool ok = false;
+  if (stbi_is_hdr(fn)) {
+    float *data = stbi_loadf(fn, &w, &h, &comps, 1);
+    if (data)
+      image = Image(w, h, Image::PixelType::R32F, data);
+    ok = data;
+    stbi_image_free(data);
+  } else if (stbi_is_16_bit(fn)) {
+    // gray (+alpha) loads as one channel, color is collapsed below if gray
+    int req = comps <= 2 ? 1 : 3;
+    stbi_us *data = stbi_load_16(fn, &w, &h, &comps, req);
+    if (data && req == 1)
+      image = Image(w, h, Image::PixelType::R16, data);
+    else if (data) {
+      // RGB16: keep 16 bits if gray, otherwise narrow to RGB8
+      size_t n = size_t(w) * h;
+      bool gray = true;
+      for (size_t i = 0; i < n && gray; ++i)
+        gray = data[3 * i] == data[3 * i + 1] && data[3 * i] == data[3 * i + 2];
+      if (gray) {
+        std::vector<uint16_t> r(n);
+        for (size_t i = 0; i < n; ++i)
+          r[i] = data[3 * i];
+        image = Image(w, h, Image::PixelType::R16, r.data());
+      } else {
+        std::vector<uint8_t> rgb(n * 3);
+        for (size_t i = 0; i < n * 3; ++i)
+          rgb[i] = data[i] >> 8;
+        image = Image(w, h, Image::PixelType::RGB8, rgb.data());
+      }
+    }
+    ok = data;
+    stbi_image_free(data);
+  } else {
+    int req = comps == 2 ? 4 : comps; // gray+alpha -> RGBA
+    stbi_uc *data = stbi_load(fn, &w, &h, &comps, req);
+    if (data) {
+      auto type = req == 1 ? Image::PixelType::R8
+          : req == 3       ? Image::PixelType::RGB8
+                           : Image::PixelType::RGBA8;
+      image = Image(w, h, type, data);
+    }
+    ok = data;
+    stbi_image_free(data);
+  }
+  stbi_set_flip_vertically_on_load_thread(0);
+  return ok;
+}
+
+// average of factor x factor blocks per channel
+template <typename T>
+void boxFilter(const Image &src, Image &dst, size_t factor, size_t channels)
+{
+  auto in = reinterpret_cast<const T *>(src.data.data());
+  auto out = reinterpret_cast<T *>(dst.data.data());
+  std::vector<double> sum(channels);
+  std::vector<size_t> n(channels);
+  for (size_t y = 0; y < dst.height; ++y) {
+    for (size_t x = 0; x < dst.width; ++x) {
+      std::fill(sum.begin(), sum.end(), 0.0);
+      std::fill(n.begin(), n.end(), 0);
+      for (size_t sy = y * factor; sy < (y + 1) * factor; ++sy) {
+        const T *row = in + (sy * src.width + x * factor) * channels;
+        for (size_t i = 0; i < factor * channels; ++i) {
+          if constexpr (std::is_floating_point_v<T>) {
+            if (!std::isfinite(row[i]))
+              continue;
+          }
+          sum[i % channels] += row[i];
+          ++n[i % channels];
+        }
+      }
+      T *p = out + (y * dst.width + x) * channels;
+      for (size_t c = 0; c < channels; ++c) {
+        if constexpr (std::is_floating_point_v<T>)
+          p[c] = n[c] ? T(sum[c] / n[c]) : std::numeric_limits<T>::quiet_NaN();
+        else
+          p[c] = T(sum[c] / n[c] + .5);
+      }
+    }
+  }
+}
+
+bool loadVisionaray(const std::string &filename, Image &image)
+{
+  visionaray::image visionarayImage;
+  if (!visionarayImage.load(filename))
+    return false;
+  Image::PixelType type;
+  switch (visionarayImage.format()) {
+  case visionaray::pixel_format::PF_R8:
+    type = Image::PixelType::R8;
+    break;
+  case visionaray::pixel_format::PF_RGB8:
+    type = Image::PixelType::RGB8;
+    break;
+  case visionaray::pixel_format::PF_RGBA8:
+    type = Image::PixelType::RGBA8;
+    break;
+  default:
+    std::cerr << "ERROR: " << filename << " has unsupported pixel format.\n";
+    return false;
+  }
+  image = Image(visionarayImage.width(),
+      visionarayImage.height(),
+      type,
+      visionarayImage.data());
+  return true;
+}
+
+} // namespace
+
+const char *toString(Image::PixelType t)
+{
+  switch (t) {
+  case Image::PixelType::R8:
+    return "R8";
+  case Image::PixelType::RGB8:
+    return "RGB8";
+  case Image::PixelType::RGBA8:
+    return "RGBA8";
+  case Image::PixelType::R16:
+    return "R16";
+  case Image::PixelType::R32F:
+    return "R32F";
+  }
+  return "unknown";
+}
+
+bool loadImage(const std::string &filename, Image &image)
+{
+  if (!std::filesystem::exists(filename)) {
+    std::cerr << "File does not exist: " << filename << "\n";
+    return false;
+  }
+
+  bool ok = false;
+  if (endsWith(filename, ".pfm"))
+    ok = loadPFM(filename, image);
+  else if (endsWith(filename, ".pgm") && loadPGM16(filename, image))
+    ok = true;
+  else
+    ok = loadSTB(filename, image) || loadVisionaray(filename, image);
+
+  if (!ok) {
+    std::cerr << "Could not load " << filename << "\n";
+    return false;
+  }
+
+  collapseGray(image);
+  return true;
+}
+
+bool collapseGray(Image &image)
+{
+  if (image.type != Image::PixelType::RGB8
+      && image.type != Image::PixelType::RGBA8)
+    return false;
+
+  const size_t n = image.width * image.height;
+  const size_t stride = image.bpp;
+  const uint8_t *src = image.data.data();
+  for (size_t i = 0; i < n; ++i) {
+    const uint8_t *p = src + i * stride;
+    if (p[0] != p[1] || p[0] != p[2] || (stride == 4 && p[3] != 255))
+      return false;
+  }
+
+  for (size_t i = 0; i < n; ++i)
+    image.data[i] = src[i * stride]; // in place, i <= i * stride
+  image.data.resize(n);
+  image.data.shrink_to_fit();
+  image.type = Image::PixelType::R8;
+  image.bpp = 1;
+  return true;
+}
+
+void valueRange(const Image &image, float &lo, float &hi)
+{
+  lo = std::numeric_limits<float>::max();
+  hi = -std::numeric_limits<float>::max();
+  const size_t n = image.width * image.height;
+  if (image.type == Image::PixelType::R16) {
+    auto src = reinterpret_cast<const uint16_t *>(image.data.data());
+    auto [mn, mx] = std::minmax_element(src, src + n);
+    lo = *mn;
+    hi = *mx;
+  } else if (image.type == Image::PixelType::R32F) {
+    auto src = reinterpret_cast<const float *>(image.data.data());
+    for (size_t i = 0; i < n; ++i) {
+      if (std::isfinite(src[i])) {
+        lo = std::min(lo, src[i]);
+        hi = std::max(hi, src[i]);
+      }
+    }
+  } else if (n > 0) {
+    auto [mn, mx] = std::minmax_element(image.data.begin(), image.data.end());
+    lo = *mn;
+    hi = *mx;
+  }
+  if (!(lo < hi)) {
+    lo = n > 0 && lo <= hi ? lo : 0.f;
+    hi = lo + 1.f;
+  }
+}
+
+void narrowToR8(const Image &image, std::vector<uint8_t> &gray)
+{
+  const size_t n = image.width * image.height;
+  if (image.type == Image::PixelType::R8) {
+    gray = image.data;
+    return;
+  }
+
+  float lo, hi;
+  valueRange(image, lo, hi);
+  const float scale = 255.f / (hi - lo);
+  gray.resize(n);
+  if (image.type == Image::PixelType::R16) {
+    auto src = reinterpret_cast<const uint16_t *>(image.data.data());
+    for (size_t i = 0; i < n; ++i)
+      gray[i] = uint8_t(std::clamp((src[i] - lo) * scale, 0.f, 255.f));
+  } else if (image.type == Image::PixelType::R32F) {
+    auto src = reinterpret_cast<const float *>(image.data.data());
+    for (size_t i = 0; i < n; ++i) {
+      float v = std::isfinite(src[i]) ? src[i] : lo;
+      gray[i] = uint8_t(std::clamp((v - lo) * scale, 0.f, 255.f));
+    }
+  } else {
+    // color: luminance
+    for (size_t i = 0; i < n; ++i) {
+      const uint8_t *p = image.data.data() + i * image.bpp;
+      gray[i] = uint8_t((54 * p[0] + 183 * p[1] + 19 * p[2]) >> 8);
+    }
+  }
+}
+
+Image downsample(const Image &image, size_t factor)
+{
+  if (factor <= 1 || image.width == 0 || image.height == 0)
+    return image;
+
+  Image result;
+  result.width = std::max<size_t>(image.width / factor, 1);
+  result.height = std::max<size_t>(image.height / factor, 1);
+  factor = std::min({factor, image.width, image.height});
+  result.type = image.type;
+  result.bpp = image.bpp;
+  result.data.resize(result.width * result.height * result.bpp);
+  switch (image.type) {
+  case Image::PixelType::R16:
+    boxFilter<uint16_t>(image, result, factor, 1);
+    break;
+  case Image::PixelType::R32F:
+    boxFilter<float>(image, result, factor, 1);
+    break;
+  default:
+    boxFilter<uint8_t>(image, result, factor, image.bpp);
+    break;
+  }
+  return result;
+}
+
+Image crop(const Image &image, size_t x, size_t y, size_t width, size_t height)
+{
+  x = std::min(x, image.width);
+  y = std::min(y, image.height);
+  width = std::min(width, image.width - x);
+  height = std::min(height, image.height - y);
+  if (x == 0 && y == 0 && width == image.width && height == image.height)
+    return image;
+
+  Image result;
+  result.width = width;
+  result.height = height;
+  result.type = image.type;
+  result.bpp = image.bpp;
+  result.data.resize(width * height * image.bpp);
+  const size_t rowBytes = width * image.bpp;
+  for (size_t row = 0; row < height; ++row) {
+    std::memcpy(result.data.data() + row * rowBytes,
+        image.data.data() + ((y + row) * image.width + x) * image.bpp,
+        rowBytes);
+  }
+  return result;
+}
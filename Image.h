@@ -1,20 +1,79 @@
 #pragma once
 
+#include <cstdint>
 #include <cstring>
+#include <string>
+#include <vector>
 
 struct Image
 {
+    // single channel types hold grayscale detector data in native precision
+    enum class PixelType
+    {
+        R8,
+        RGB8,
+        RGBA8,
+        R16,
+        R32F,
+    };
+
     Image() = default;
-    Image(size_t w, size_t h, size_t b, const void* d)
-        : width(w), height(h), bpp(b)
+    Image(size_t w, size_t h, PixelType t, const void* d)
+        : width(w), height(h), type(t), bpp(bytesPerPixel(t))
     {
         auto size = width * height * bpp;
         data.resize(size);
         memcpy(data.data(), d, size);
     }
 
-    size_t width;
-    size_t height;
-    size_t bpp;
+    static size_t bytesPerPixel(PixelType t)
+    {
+        switch (t)
+        {
+            case PixelType::R8: return 1;
+            case PixelType::RGB8: return 3;
+            case PixelType::RGBA8: return 4;
+            case PixelType::R16: return 2;
+            case PixelType::R32F: return 4;
+        }
+        return 0;
+    }
+
+    bool isSingleChannel() const
+    {
+        return type == PixelType::R8 || type == PixelType::R16
+            || type == PixelType::R32F;
+    }
+
+    size_t width{0};
+    size_t height{0};
+    PixelType type{PixelType::R8};
+    size_t bpp{0}; // bytes per pixel
     std::vector<uint8_t> data;
 };
+
+const char* toString(Image::PixelType t);
+
+// Decode an image file. 16 bit files load as R16 (PNG, PGM), floating point
+// ones as R32F (PFM, HDR); grayscale content stored as RGB(A) is collapsed
+// to a single channel.
+bool loadImage(const std::string& filename, Image& image);
+
+// Collapse RGB(A) images with equal channels (and opaque alpha) to one
+// channel, returns true if collapsed
+bool collapseGray(Image& image);
+
+// Min/max pixel value of a single-channel image
+void valueRange(const Image& image, float& lo, float& hi);
+
+// Stretch R16/R32F images to R8 over their value range (R8 is copied); for
+// consumers without high bit depth support such as the estimator ABI
+void narrowToR8(const Image& image, std::vector<uint8_t>& gray);
+
+// Box-filtered image of (width / factor) x (height / factor) pixels in the
+// same pixel type, e.g. a level of a registration pyramid; non-finite R32F
+// values are skipped
+Image downsample(const Image& image, size_t factor);
+
+// Copy of the width x height pixels at (x, y), clamped to the image
+Image crop(const Image& image, size_t x, size_t y, size_t width, size_t height);
@@ -0,0 +1,221 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#include "ImageCache.h"
+// std
+#include <algorithm>
+
+// ImageCache definitions /////////////////////////////////////////////////////
+
+ImageCache::ImageCache(std::vector<std::string> filenames,
+    size_t memoryBudget,
+    unsigned numThreads,
+    Transform transform)
+    : m_filenames(std::move(filenames)),
+      m_transform(std::move(transform)),
+      m_entries(m_filenames.size()),
+      m_memoryBudget(memoryBudget)
+{
+  if (numThreads == 0)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned i = 0; i < numThreads; ++i)
+    m_threads.emplace_back([this]() { run(); });
+}
+
+ImageCache::~ImageCache()
+{
+  {
+    std::unique_lock<std::mutex> l(m_mutex);
+    m_quit = true;
+  }
+  m_queueCond.notify_all();
+  for (auto &t : m_threads)
+    t.join();
+}
+
+size_t ImageCache::size() const
+{
+  return m_filenames.size();
+}
+
+const std::string &ImageCache::filename(size_t index) const
+{
+  return m_filenames[index];
+}
+
+void ImageCache::request(size_t index)
+{
+  if (index >= m_entries.size())
+    return;
+
+  std::unique_lock<std::mutex> l(m_mutex);
+  auto &entry = m_entries[index];
+  if (entry.state == State::QUEUED) {
+    // move to the front
+    m_queue.erase(std::find(m_queue.begin(), m_queue.end(), index));
+  } else if (entry.state != State::NONE)
+    return;
+  entry.state = State::QUEUED;
+  m_queue.push_front(index);
+  bool dropped = false;
+  while (m_maxQueued > 0 && m_queue.size() > m_maxQueued) {
+    m_entries[m_queue.back()].state = State::NONE;
+    m_queue.pop_back();
+    dropped = true;
+  }
+  l.unlock();
+  m_queueCond.notify_one();
+  // get() re-requests images dropped while it waits
+  if (dropped)
+    m_loadedCond.notify_all();
+}
+
+void ImageCache::preloadAll()
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  for (size_t i = 0; i < m_entries.size(); ++i) {
+    if (m_entries[i].state == State::NONE) {
+      m_entries[i].state = State::QUEUED;
+      m_queue.push_back(i);
+    }
+  }
+  l.unlock();
+  m_queueCond.notify_all();
+}
+
+std::shared_ptr<const Image> ImageCache::tryGet(size_t index)
+{
+  if (index >= m_entries.size())
+    return nullptr;
+
+  std::unique_lock<std::mutex> l(m_mutex);
+  auto &entry = m_entries[index];
+  if (entry.state != State::LOADED)
+    return nullptr;
+  touch(entry);
+  return entry.image;
+}
+
+std::shared_ptr<const Image> ImageCache::get(size_t index)
+{
+  if (index >= m_entries.size())
+    return nullptr;
+
+  request(index);
+
+  std::unique_lock<std::mutex> l(m_mutex);
+  auto &entry = m_entries[index];
+  for (;;) {
+    if (entry.state == State::LOADED) {
+      touch(entry);
+      return entry.image;
+    }
+    if (entry.state == State::FAILED)
+      return nullptr;
+    if (entry.state == State::NONE) {
+      // evicted right after loading, decode again
+      l.unlock();
+      request(index);
+      l.lock();
+      continue;
+    }
+    m_loadedCond.wait(l);
+  }
+}
+
+bool ImageCache::failed(size_t index) const
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  return index < m_entries.size() && m_entries[index].state == State::FAILED;
+}
+
+void ImageCache::setMaxQueued(size_t maxQueued)
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  m_maxQueued = maxQueued;
+}
+
+void ImageCache::setMemoryBudget(size_t bytes)
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  m_memoryBudget = bytes;
+  evict();
+}
+
+size_t ImageCache::memoryBudget() const
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  return m_memoryBudget;
+}
+
+size_t ImageCache::memoryUsage() const
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  return m_memoryUsage;
+}
+
+size_t ImageCache::numLoaded() const
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  return m_numLoaded;
+}
+
+void ImageCache::run()
+{
+  for (;;) {
+    std::unique_lock<std::mutex> l(m_mutex);
+    m_queueCond.wait(l, [this]() { return m_quit || !m_queue.empty(); });
+    if (m_quit)
+      return;
+    size_t index = m_queue.front();
+    m_queue.pop_front();
+    m_entries[index].state = State::LOADING;
+    l.unlock();
+
+    Image decoded;
+    bool ok = loadImage(m_filenames[index], decoded);
+    std::shared_ptr<const Image> image;
+    if (ok) {
+      image = std::make_shared<Image>(
+          m_transform ? m_transform(std::move(decoded)) : std::move(decoded));
+    }
+
+    l.lock();
+    auto &entry = m_entries[index];
+    if (ok) {
+      entry.state = State::LOADED;
+      entry.image = std::move(image);
+      touch(entry);
+      m_memoryUsage += entry.image->data.size();
+      ++m_numLoaded;
+      evict();
+    } else
+      entry.state = State::FAILED;
+    l.unlock();
+    m_loadedCond.notify_all();
+  }
+}
+
+void ImageCache::touch(Entry &entry)
+{
+  entry.lastUse = ++m_useCounter;
+}
+
+void ImageCache::evict()
+{
+  while (m_memoryUsage > m_memoryBudget) {
+    Entry *lru = nullptr;
+    for (auto &entry : m_entries) {
+      if (entry.state == State::LOADED
+          && (!lru || entry.lastUse < lru->lastUse))
+        lru = &entry;
+    }
+    // keep at least the most recent image
+    if (!lru || lru->lastUse == m_useCounter)
+      break;
+    m_memoryUsage -= lru->image->data.size();
+    --m_numLoaded;
+    lru->image.reset();
+    lru->state = State::NONE;
+  }
+}
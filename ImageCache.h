@@ -0,0 +1,100 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+// ours
+#include "Image.h"
+
+// Reference images of the predictions, decoded on demand by a worker pool.
+// Decoded images are kept within a memory budget, least recently used ones
+// are dropped first. Images are handed out as shared pointers, so eviction
+// never invalidates an image that is still in use.
+class ImageCache
+{
+ public:
+  // applied by the workers to every decoded image, only its result is kept
+  // (e.g. a thumbnail)
+  using Transform = std::function<Image(Image &&)>;
+
+  ImageCache(std::vector<std::string> filenames,
+      size_t memoryBudget = size_t(1) << 30,
+      unsigned numThreads = 0,
+      Transform transform = {});
+  ~ImageCache();
+
+  ImageCache(const ImageCache &) = delete;
+  ImageCache &operator=(const ImageCache &) = delete;
+
+  size_t size() const;
+  const std::string &filename(size_t index) const;
+
+  // queue decoding of the image unless cached or pending; the latest request
+  // is served first
+  void request(size_t index);
+  // decode all images in parallel (the memory budget still applies)
+  void preloadAll();
+
+  // decoded image or nullptr if not (yet) available, doesn't block
+  std::shared_ptr<const Image> tryGet(size_t index);
+  // waits for decoding, nullptr if the image could not be loaded
+  std::shared_ptr<const Image> get(size_t index);
+
+  // true if the image could not be loaded
+  bool failed(size_t index) const;
+
+  // bound the decode queue, requests beyond it drop the oldest ones (0: no
+  // bound); for lists that only need what was recently visible
+  void setMaxQueued(size_t maxQueued);
+
+  void setMemoryBudget(size_t bytes);
+  size_t memoryBudget() const;
+  size_t memoryUsage() const;
+  size_t numLoaded() const;
+
+ private:
+  enum class State
+  {
+    NONE,
+    QUEUED,
+    LOADING,
+    LOADED,
+    FAILED,
+  };
+
+  struct Entry
+  {
+    State state{State::NONE};
+    std::shared_ptr<const Image> image;
+    uint64_t lastUse{0};
+  };
+
+  void run();
+  void touch(Entry &entry);
+  void evict(); // called with m_mutex held
+
+  std::vector<std::string> m_filenames;
+  Transform m_transform;
+  std::vector<Entry> m_entries;
+  std::deque<size_t> m_queue;
+  size_t m_maxQueued{0};
+  size_t m_memoryBudget;
+  size_t m_memoryUsage{0};
+  size_t m_numLoaded{0};
+  uint64_t m_useCounter{0};
+  bool m_quit{false};
+  mutable std::mutex m_mutex;
+  std::condition_variable m_queueCond;
+  std::condition_variable m_loadedCond;
+  std::vector<std::thread> m_threads;
+};
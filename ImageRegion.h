@@ -0,0 +1,83 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <algorithm>
+#include <cmath>
+// ours
+#include "Image.h"
+
+// Region of interest on the detector, centered on the principal point and
+// given as fractions of the full frame's width and height. Rendering only the
+// region is the same as rendering with a narrower camera (fovy(), aspect()),
+// which the estimators' calibrate() can express; it has no principal point
+// offset, so off-center rectangles are widened to the smallest centered
+// region containing them (enclosing()).
+struct ImageRegion
+{
+  float width{1.f};
+  float height{1.f};
+
+  bool full() const
+  {
+    return width >= 1.f && height >= 1.f;
+  }
+
+  bool operator==(const ImageRegion &) const = default;
+
+  // the centered region containing the rectangle between two points given in
+  // normalized [0, 1] frame coordinates
+  static ImageRegion enclosing(float x0, float y0, float x1, float y1)
+  {
+    auto extent = [](float a, float b) {
+      return std::clamp(
+          2.f * std::max(std::abs(a - .5f), std::abs(b - .5f)), 0.f, 1.f);
+    };
+    return {extent(x0, x1), extent(y0, y1)};
+  }
+
+  // size in pixels of a fullWidth x fullHeight frame, at least one
+  int pixelWidth(int fullWidth) const
+  {
+    return std::clamp(int(std::lround(width * fullWidth)), 1, fullWidth);
+  }
+  int pixelHeight(int fullHeight) const
+  {
+    return std::clamp(int(std::lround(height * fullHeight)), 1, fullHeight);
+  }
+
+  // the region covering exactly pixelWidth() x pixelHeight() pixels
+  ImageRegion snapped(int fullWidth, int fullHeight) const
+  {
+    if (fullWidth <= 0 || fullHeight <= 0)
+      return *this;
+    return {float(pixelWidth(fullWidth)) / fullWidth,
+        float(pixelHeight(fullHeight)) / fullHeight};
+  }
+
+  // intrinsics of a camera seeing only the region, fovy in radians
+  float fovy(float fullFovy) const
+  {
+    return 2.f * std::atan(std::tan(.5f * fullFovy) * height);
+  }
+  float aspect(float fullAspect) const
+  {
+    return fullAspect * width / height;
+  }
+};
+
+// The region's pixels of an image covering the full frame
+inline Image cropToRegion(const Image &image, const ImageRegion &region)
+{
+  if (region.full() || image.width == 0 || image.height == 0)
+    return image;
+  const size_t width = region.pixelWidth(int(image.width));
+  const size_t height = region.pixelHeight(int(image.height));
+  return crop(image,
+      (image.width - width) / 2,
+      (image.height - height) / 2,
+      width,
+      height);
+}
@@ -1,5 +1,7 @@
 #include "ImageTransformEstimatorWrapper.h"
 
+#include <algorithm>
+
 ImageTransformEstimatorWrapper::~ImageTransformEstimatorWrapper() noexcept
 {
   try {
@@ -21,6 +23,8 @@ void ImageTransformEstimatorWrapper::init(std::vector<std::string> &estimatorLib
     image_transform_estimator* (*create_estimator)() = (image_transform_estimator* (*)()) dlsym(handle, "create_estimator");
     const char* (*get_name)() = (const char* (*)())dlsym(handle, "get_estimator_type");
     const char* (*get_desc)() = (const char* (*)())dlsym(handle, "get_estimator_description");
+    void (*destroy_estimator)(image_transform_estimator*) =
+        (void (*)(image_transform_estimator*))dlsym(handle, "destroy_estimator");
 
     if (!create_estimator || !get_name || !get_desc) {
       fprintf(stderr, "Error: %s\n", dlerror());
@@ -36,10 +40,23 @@ void ImageTransformEstimatorWrapper::init(std::vector<std::string> &estimatorLib
     }
     m_estimators.push_back(estimator);
     m_estimatorLibraryHandles.push_back(handle);
+    auto pool = std::make_unique<Pool>();
+    pool->create = create_estimator;
+    pool->destroy = destroy_estimator;
+
+    // optional symbols
+    uint32_t (*get_capabilities)() = (uint32_t (*)())dlsym(handle, "estimator_capabilities");
+    pool->createBatch = (image_transform_estimator_batch* (*)())dlsym(handle, "create_estimator_batch");
+    pool->destroyBatch = (void (*)(image_transform_estimator_batch*))dlsym(handle, "destroy_estimator_batch");
+    pool->capabilities = get_capabilities ? get_capabilities() : 0;
+    if (!pool->createBatch)
+      pool->capabilities &= ~uint32_t(ESTIMATOR_CAPABILITY_BATCH);
+    const bool batched = pool->capabilities & ESTIMATOR_CAPABILITY_BATCH;
+    m_pools.push_back(std::move(pool));
     m_estimatorNames.emplace_back(get_name());
     m_estimatorDescriptions.emplace_back(get_desc());
 
-    fprintf(stdout, "Loaded estimator %s: %s\n", m_estimatorNames.back().c_str(), m_estimatorDescriptions.back().c_str());
+    fprintf(stdout, "Loaded estimator %s%s: %s\n", m_estimatorNames.back().c_str(), batched ? " (batched)" : "", m_estimatorDescriptions.back().c_str());
   }
 
   if (!m_estimators.empty())
@@ -50,14 +67,19 @@ void ImageTransformEstimatorWrapper::destroy()
 {
   for (size_t i = 0; i < m_estimatorLibraryHandles.size(); ++i) {
     auto handle = m_estimatorLibraryHandles[i];
-    void (*destroy_estimator)(image_transform_estimator*) =
-        (void (*)(image_transform_estimator*))dlsym(handle, "destroy_estimator");
+    void (*destroy_estimator)(image_transform_estimator*) = m_pools[i]->destroy;
 
+    if (m_pools[i]->batch && m_pools[i]->destroyBatch)
+      m_pools[i]->destroyBatch(m_pools[i]->batch);
     if (destroy_estimator) {
+      // pool instances must all be checked in by now
+      for (auto *instance : m_pools[i]->instances)
+        destroy_estimator(instance);
       destroy_estimator(m_estimators[i]);
     }
     dlclose(handle);
   }
+  m_pools.clear();
   m_estimators.clear();
   m_estimatorLibraryHandles.clear();
   m_estimatorNames.clear();
@@ -75,4 +97,150 @@ void ImageTransformEstimatorWrapper::setActiveEstimatorIndex(size_t index)
 image_transform_estimator* ImageTransformEstimatorWrapper::getActiveEstimator()
 {
   return m_activeEstimator;
-}
\ No newline at end of file
+}
+
+void ImageTransformEstimatorWrapper::setPoolSize(size_t size)
+{
+  m_poolSize = std::max<size_t>(size, 1);
+}
+
+size_t ImageTransformEstimatorWrapper::poolSize() const
+{
+  return m_poolSize;
+}
+
+image_transform_estimator* ImageTransformEstimatorWrapper::checkout(size_t estimatorIndex)
+{
+  if (estimatorIndex >= m_pools.size())
+    return nullptr;
+
+  auto &pool = *m_pools[estimatorIndex];
+  std::unique_lock<std::mutex> l(pool.mutex);
+  for (;;) {
+    if (!pool.idle.empty()) {
+      auto *estimator = pool.idle.back();
+      pool.idle.pop_back();
+      if (pool.hasThreshold)
+        estimator->set_good_match_threshold(pool.threshold);
+      return estimator;
+    }
+    if (pool.instances.size() < m_poolSize) {
+      auto *estimator = pool.create();
+      if (estimator) {
+        pool.instances.push_back(estimator);
+        if (pool.hasThreshold)
+          estimator->set_good_match_threshold(pool.threshold);
+        return estimator;
+      }
+      fprintf(stderr, "Could not create instance of estimator\n");
+      if (pool.instances.empty())
+        return nullptr;
+    }
+    pool.returned.wait(l);
+  }
+}
+
+void ImageTransformEstimatorWrapper::checkin(size_t estimatorIndex, image_transform_estimator* estimator)
+{
+  if (estimatorIndex >= m_pools.size() || !estimator)
+    return;
+
+  auto &pool = *m_pools[estimatorIndex];
+  {
+    std::unique_lock<std::mutex> l(pool.mutex);
+    pool.idle.push_back(estimator);
+  }
+  pool.returned.notify_one();
+}
+
+void ImageTransformEstimatorWrapper::setGoodMatchThreshold(size_t estimatorIndex, float threshold)
+{
+  if (estimatorIndex >= m_pools.size())
+    return;
+
+  m_estimators[estimatorIndex]->set_good_match_threshold(threshold);
+  auto &pool = *m_pools[estimatorIndex];
+  std::unique_lock<std::mutex> l(pool.mutex);
+  pool.hasThreshold = true;
+  pool.threshold = threshold;
+}
+
+bool ImageTransformEstimatorWrapper::supportsBatch(size_t estimatorIndex) const
+{
+  return estimatorIndex < m_pools.size()
+      && (m_pools[estimatorIndex]->capabilities & ESTIMATOR_CAPABILITY_BATCH);
+}
+
+bool ImageTransformEstimatorWrapper::matchBatch(size_t estimatorIndex, estimator_batch &batch)
+{
+  if (estimatorIndex >= m_pools.size())
+    return false;
+
+  auto &pool = *m_pools[estimatorIndex];
+  if (supportsBatch(estimatorIndex)) {
+    std::unique_lock<std::mutex> l(pool.batchMutex);
+    if (!pool.batch)
+      pool.batch = pool.createBatch();
+    if (pool.batch) {
+      bool hasThreshold;
+      float threshold;
+      {
+        std::unique_lock<std::mutex> pl(pool.mutex);
+        hasThreshold = pool.hasThreshold;
+        threshold = pool.threshold;
+      }
+      if (hasThreshold)
+        pool.batch->set_good_match_threshold(threshold);
+      pool.batch->match(batch);
+      return true;
+    }
+    fprintf(stderr, "Could not create batch instance of estimator, matching pair by pair\n");
+    pool.capabilities &= ~uint32_t(ESTIMATOR_CAPABILITY_BATCH);
+  }
+
+  // per-image fallback
+  EstimatorLease estimator(*this, estimatorIndex);
+  if (!estimator)
+    return false;
+
+  const size_t referenceSize = batch.reference_width * batch.reference_height
+      * bytesPerPixel(batch.reference_pixel_type);
+  const size_t querySize = batch.width * batch.height * bytesPerPixel(batch.query_pixel_type);
+  const size_t depthSize = batch.width * batch.height * 3;
+  for (size_t i = 0; i < batch.count; ++i) {
+    // the estimators only read the images
+    auto *reference = (uint8_t*)batch.references + i * referenceSize;
+    auto *query = (uint8_t*)batch.queries + i * querySize;
+    auto *depth3d = (float*)batch.depth3d + i * depthSize;
+    estimator->set_image(reference,
+                         batch.reference_width,
+                         batch.reference_height,
+                         batch.reference_pixel_type,
+                         image_transform_estimator::IMAGE_TYPE::REFERENCE,
+                         batch.reference_swizzle);
+    estimator->set_image(depth3d,
+                         batch.width,
+                         batch.height,
+                         image_transform_estimator::PIXEL_TYPE::F32X3,
+                         image_transform_estimator::IMAGE_TYPE::DEPTH3D,
+                         false /*swizzle*/);
+    estimator->set_image(query,
+                         batch.width,
+                         batch.height,
+                         batch.query_pixel_type,
+                         image_transform_estimator::IMAGE_TYPE::QUERY,
+                         false /*swizzle*/);
+    estimator->calibrate(batch.width, batch.height, batch.fovy, batch.aspect);
+    estimator->match();
+
+    float *camera = batch.cameras + 9 * i;
+    std::array<float, 3> eye{camera[0], camera[1], camera[2]};
+    std::array<float, 3> center{camera[3], camera[4], camera[5]};
+    std::array<float, 3> up{camera[6], camera[7], camera[8]};
+    estimator->update_camera(eye, center, up);
+    std::copy(eye.begin(), eye.end(), camera);
+    std::copy(center.begin(), center.end(), camera + 3);
+    std::copy(up.begin(), up.end(), camera + 6);
+  }
+  return true;
+}
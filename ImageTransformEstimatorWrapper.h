@@ -1,12 +1,17 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <condition_variable>
 #include <dlfcn.h>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include <image_transform_estimator.h>
+#include "image_transform_estimator_batch.h"
 
 struct ImageTransformEstimatorWrapper
 {
@@ -18,6 +23,51 @@ struct ImageTransformEstimatorWrapper
   void setActiveEstimatorIndex(size_t index);
   image_transform_estimator* getActiveEstimator();
 
+  // Pools of additional instances per plugin for matching on several threads
+  // (an instance is stateful from set_image to update_camera, so it must not
+  // be shared while in use). Instances are created on demand, up to poolSize
+  // per plugin; checkout waits while all of them are checked out and returns
+  // nullptr if the plugin index is invalid or no instance could be created.
+  // Shrinking the pool keeps instances already created. The instances in
+  // m_estimators are not part of the pools.
+  void setPoolSize(size_t size);
+  size_t poolSize() const;
+  image_transform_estimator* checkout(size_t estimatorIndex);
+  void checkin(size_t estimatorIndex, image_transform_estimator* estimator);
+
+  // Optional batched ABI (image_transform_estimator_batch.h). matchBatch
+  // submits all pairs in one call if the plugin exports it (calls are
+  // serialized on a single batch instance per plugin), and otherwise runs
+  // set_image/calibrate/match/update_camera pair by pair on a pool instance.
+  bool supportsBatch(size_t estimatorIndex) const;
+  bool matchBatch(size_t estimatorIndex, estimator_batch &batch);
+
+  // set_good_match_threshold on the plugin's main instance, and on its pool
+  // and batch instances when they are next checked out or used (those may be
+  // busy on other threads); the main instance must not be in use
+  void setGoodMatchThreshold(size_t estimatorIndex, float threshold);
+
+  struct Pool
+  {
+    image_transform_estimator* (*create)(){nullptr};
+    void (*destroy)(image_transform_estimator*){nullptr};
+    std::vector<image_transform_estimator*> instances;
+    std::vector<image_transform_estimator*> idle;
+    std::mutex mutex;
+    std::condition_variable returned;
+    // batched ABI, if exported; the instance is created on first use
+    std::atomic<uint32_t> capabilities{0};
+    image_transform_estimator_batch* (*createBatch)(){nullptr};
+    void (*destroyBatch)(image_transform_estimator_batch*){nullptr};
+    image_transform_estimator_batch* batch{nullptr};
+    std::mutex batchMutex;
+    // set_good_match_threshold, if set; guarded by mutex
+    bool hasThreshold{false};
+    float threshold{0.f};
+  };
+
+  std::vector<std::unique_ptr<Pool>> m_pools;
+  size_t m_poolSize{1};
   std::vector<void*> m_estimatorLibraryHandles;
   std::vector<image_transform_estimator*> m_estimators;
   std::vector<std::string> m_estimatorNames;
@@ -25,3 +75,30 @@ struct ImageTransformEstimatorWrapper
   size_t m_activeEstimatorIndex{0};
   image_transform_estimator* m_activeEstimator{nullptr};
 };
+
+// Checked out pool instance, returned on destruction
+class EstimatorLease
+{
+ public:
+  EstimatorLease(ImageTransformEstimatorWrapper &estimators, size_t estimatorIndex)
+    : m_estimators(&estimators), m_index(estimatorIndex),
+      m_estimator(estimators.checkout(estimatorIndex))
+  {}
+  ~EstimatorLease()
+  {
+    if (m_estimator)
+      m_estimators->checkin(m_index, m_estimator);
+  }
+
+  EstimatorLease(const EstimatorLease &) = delete;
+  EstimatorLease &operator=(const EstimatorLease &) = delete;
+
+  image_transform_estimator* get() const { return m_estimator; }
+  image_transform_estimator* operator->() const { return m_estimator; }
+  explicit operator bool() const { return m_estimator != nullptr; }
+
+ private:
+  ImageTransformEstimatorWrapper *m_estimators;
+  size_t m_index;
+  image_transform_estimator *m_estimator;
+};
@@ -10,176 +10,280 @@
 
 namespace anari_viewer::windows {
 
-ImageViewport::ImageViewport(const std::vector<Image>& images, const char *name)
-    : Window(name, true), m_images(images)
-{
-  glGenTextures(1, &m_framebufferTexture);
-  glBindTexture(GL_TEXTURE_2D, m_framebufferTexture);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexImage2D(GL_TEXTURE_2D,
-      0,
-      GL_RGBA8,
-      m_viewportSize.x,
-      m_viewportSize.y,
-      0,
-      GL_RGBA,
-      GL_UNSIGNED_BYTE,
-      0);
+ImageViewport::ImageViewport(ImageCache& images, const char *name)
+    : Window(name, true), m_images(&images)
+{}
 
-  reshape(m_viewportSize);
+ImageViewport::~ImageViewport()
+{
+  for (auto &[index, cached] : m_textures)
+    glDeleteTextures(1, &cached.texture);
 }
 
 void ImageViewport::buildUI()
 {
-  ImVec2 _viewportSize = ImGui::GetContentRegionAvail();
-  anari::math::int2 viewportSize(_viewportSize.x, _viewportSize.y);
+  const ImVec2 avail = ImGui::GetContentRegionAvail();
+  const ImVec2 pos = ImGui::GetCursorScreenPos();
 
-  if (m_viewportSize != viewportSize)
-    reshape(viewportSize);
+  // black background
+  ImGui::GetWindowDrawList()->AddRectFilled(
+      pos, ImVec2(pos.x + avail.x, pos.y + avail.y), IM_COL32(0, 0, 0, 255));
 
-  ImGui::Image((void *)(intptr_t)m_framebufferTexture,
-      ImGui::GetContentRegionAvail(),
-      ImVec2(1, 0),
-      ImVec2(0, 1));
+  const CachedTexture *tex =
+      m_imageIndex >= 0 ? texture(m_imageIndex) : nullptr;
+  if (m_imageIndex >= 0 && !tex) {
+    m_images->request(m_imageIndex); // no-op unless evicted before upload
+    ImGui::Text("loading %s ...", m_images->filename(m_imageIndex).c_str());
+  }
+
+  if (tex && avail.x > 0 && avail.y > 0) {
+    // letterbox: fit the image into the region, keeping its aspect ratio
+    float ratioImg = float(tex->width) / tex->height;
+    float ratioScreen = avail.x / avail.y;
+    ImVec2 size = avail;
+    if (ratioImg > ratioScreen)
+      size.y = avail.x / ratioImg;
+    else
+      size.x = avail.y * ratioImg;
+    ImGui::SetCursorScreenPos(ImVec2(pos.x + (avail.x - size.x) * .5f,
+        pos.y + (avail.y - size.y) * .5f));
+
+    // rows are stored bottom to top
+    ImGui::Image(
+        (void *)(intptr_t)tex->texture, size, ImVec2(0, 1), ImVec2(1, 0));
+
+    if (!m_imageRegion.full()) {
+      const ImVec2 lo = ImGui::GetItemRectMin();
+      const ImVec2 hi = ImGui::GetItemRectMax();
+      const ImVec2 margin(.5f * (hi.x - lo.x) * (1.f - m_imageRegion.width),
+          .5f * (hi.y - lo.y) * (1.f - m_imageRegion.height));
+      ImGui::GetWindowDrawList()->AddRect(
+          ImVec2(lo.x + margin.x, lo.y + margin.y),
+          ImVec2(hi.x - margin.x, hi.y - margin.y),
+          IM_COL32(255, 200, 0, 255));
+    }
+    ui_regionSelect();
+  }
+
+  // upload the first decoded neighbour
+  for (auto it = m_prefetch.begin(); it != m_prefetch.end(); ++it) {
+    if (m_textures.count(*it) || texture(*it)) {
+      m_prefetch.erase(it);
+      break;
+    }
+  }
 }
 
 void ImageViewport::showImage(size_t index)
 {
-  if ((index >= m_images.size()) || (m_images[index].data.empty()))
+  if (index >= m_images->size())
     return;
 
-  const uint8_t* imageData{nullptr};
-  std::vector<uint8_t> swizzledImageData;
-  // convert to rgba first
-  if (m_images[index].bpp == 1) {
-    swizzledImageData.resize(m_images[index].width * m_images[index].height * 4);
-    for (int i = 0; i < m_images[index].width * m_images[index].height; ++i) {
-      swizzledImageData[i * 4 + 0] = m_images[index].data.data()[i];
-      swizzledImageData[i * 4 + 1] = m_images[index].data.data()[i];
-      swizzledImageData[i * 4 + 2] = m_images[index].data.data()[i];
-      swizzledImageData[i * 4 + 3] = 255;
-    }
-    imageData = swizzledImageData.data();
+  m_imageIndex = static_cast<ssize_t>(index);
+
+  // prefetch neighbours, nearest first; requested in reverse as the latest
+  // request is decoded first
+  m_prefetch.clear();
+  for (int d = 1; d <= m_prefetchRadius; ++d) {
+    if (index + d < m_images->size())
+      m_prefetch.push_back(index + d);
+    if (index >= size_t(d))
+      m_prefetch.push_back(index - d);
   }
-  else if (m_images[index].bpp == 3) {
-    swizzledImageData.resize(m_images[index].width * m_images[index].height * 4);
-    for (int i = 0; i < m_images[index].width * m_images[index].height; ++i) {
-        swizzledImageData[i * 4 + 0] = m_images[index].data.data()[i * 3 + 0];
-        swizzledImageData[i * 4 + 1] = m_images[index].data.data()[i * 3 + 1];
-        swizzledImageData[i * 4 + 2] = m_images[index].data.data()[i * 3 + 2];
-        swizzledImageData[i * 4 + 3] = 255;
-    }
-    imageData = swizzledImageData.data();
+  for (auto it = m_prefetch.rbegin(); it != m_prefetch.rend(); ++it) {
+    if (!m_textures.count(*it))
+      m_images->request(*it);
   }
-  else if (m_images[index].bpp == 4) {
-    imageData = m_images[index].data.data();
+  m_images->request(index);
+}
+
+void ImageViewport::setTextureBudget(size_t bytes)
+{
+  m_textureBudget = bytes;
+  evict();
+}
+
+void ImageViewport::setImageRegion(const ImageRegion &region)
+{
+  m_imageRegion = region;
+}
+
+void ImageViewport::setImageRegionCallback(
+    std::function<void(const ImageRegion &)> callback)
+{
+  m_imageRegionCallback = std::move(callback);
+}
+
+void ImageViewport::ui_regionSelect()
+{
+  const ImGuiIO &io = ImGui::GetIO();
+  if (!m_selectingRegion) {
+    if (!ImGui::IsMouseClicked(ImGuiMouseButton_Left)
+        || !io.KeysDown[GLFW_KEY_LEFT_CONTROL] || !ImGui::IsItemHovered())
+      return;
+    m_selectingRegion = true;
+    m_regionStart = {io.MousePos.x, io.MousePos.y};
   }
-  else {
-    printf("bad image: unsupported bpp = %lu\n", m_images[index].bpp);
+
+  // same as in the viewport: widened to a centered region, a click selects
+  // the whole image
+  const ImVec2 lo = ImGui::GetItemRectMin();
+  const ImVec2 hi = ImGui::GetItemRectMax();
+  auto clamped = [&](float x, float y) {
+    return ImVec2(std::clamp(x, lo.x, hi.x), std::clamp(y, lo.y, hi.y));
+  };
+  const ImVec2 a = clamped(m_regionStart.x, m_regionStart.y);
+  const ImVec2 b = clamped(io.MousePos.x, io.MousePos.y);
+  ImGui::GetWindowDrawList()->AddRect(a, b, IM_COL32(255, 200, 0, 255));
+
+  if (ImGui::IsMouseDown(ImGuiMouseButton_Left))
     return;
+
+  m_selectingRegion = false;
+  ImageRegion region;
+  if (std::abs(b.x - a.x) >= 4.f && std::abs(b.y - a.y) >= 4.f) {
+    const float w = std::max(hi.x - lo.x, 1.f);
+    const float h = std::max(hi.y - lo.y, 1.f);
+    region = ImageRegion::enclosing((a.x - lo.x) / w,
+        (a.y - lo.y) / h,
+        (b.x - lo.x) / w,
+        (b.y - lo.y) / h);
   }
-  m_imageIndex = static_cast<ssize_t>(index);
+  m_imageRegion = region;
+  if (m_imageRegionCallback)
+    m_imageRegionCallback(region);
+}
 
-  // copy into temporary texture
-  GLuint tempTexture{0};
-  glGenTextures(1, &tempTexture);
-  glBindTexture(GL_TEXTURE_2D, tempTexture);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexImage2D(GL_TEXTURE_2D,
-      0,
-      GL_RGBA8,
-      m_images[index].width,
-      m_images[index].height,
-      0,
-      GL_RGBA,
-      GL_UNSIGNED_BYTE,
-      0);
-  glTexSubImage2D(GL_TEXTURE_2D,
-      0,
-      0,
-      0,
-      m_images[index].width,
-      m_images[index].height,
-      GL_RGBA,
-      GL_UNSIGNED_BYTE,
-      imageData);
-
-  // setup fb to render into m_framebufferTexture
-  GLint oldFbo{0};
-  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFbo);
-  GLuint fbo;
-  glGenFramebuffers(1, &fbo);
-  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_framebufferTexture, 0);
-
-  // clear to black background
-  glClearColor(0.f, 0.f, 0.f, 1.f);
-  glClear(GL_COLOR_BUFFER_BIT);
-
-  // calc scaling and offset
-  int imgWidth = m_images[index].width;
-  int imgHeight = m_images[index].height;
-  GLfloat offsetX = 0;
-  GLfloat offsetY = 0;
-  GLfloat renderWidth = m_viewportSize.x;
-  GLfloat renderHeight = m_viewportSize.y;
-  float ratioImg = float(imgWidth) / imgHeight;
-  float ratioScreen = renderWidth / renderHeight;
-  if (ratioImg > ratioScreen)
-      renderHeight = renderWidth / ratioImg;
-  else
-      renderWidth = renderHeight * ratioImg;
-  offsetX = 0 + (m_viewportSize.x - renderWidth) * .5f;
-  offsetY = 0 + (m_viewportSize.y - renderHeight) * .5f;
-
-  // render to fbo (and flip x+y axes)
-  glEnable(GL_TEXTURE_2D);
-  glBindTexture(GL_TEXTURE_2D, tempTexture);
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
-  glMatrixMode(GL_MODELVIEW);
-  glLoadIdentity();
-  glTranslatef(-1, -1, 0);
-  glScalef(2.0f / m_viewportSize.x, 2.0f / m_viewportSize.y, 1.0);
-  glBegin(GL_QUADS);
-  glTexCoord2f(1, 1);
-  glVertex2f(offsetX, offsetY);
-  glTexCoord2f(0, 1);
-  glVertex2f(offsetX + renderWidth, offsetY);
-  glTexCoord2f(0, 0);
-  glVertex2f(offsetX + renderWidth, offsetY + renderHeight);
-  glTexCoord2f(1, 0);
-  glVertex2f(offsetX, offsetY + renderHeight);
-  glEnd();
-  glBindFramebuffer(GL_FRAMEBUFFER, oldFbo);
+const ImageViewport::CachedTexture *ImageViewport::texture(size_t index)
+{
+  auto it = m_textures.find(index);
+  if (it == m_textures.end()) {
+    auto image = m_images->tryGet(index);
+    if (!image)
+      return nullptr;
+    upload(index, *image);
+    it = m_textures.find(index);
+    if (it == m_textures.end())
+      return nullptr;
+  }
+  it->second.lastUse = ++m_useCounter;
+  return &it->second;
 }
 
-void ImageViewport::reshape(anari::math::int2 newSize)
+void ImageViewport::upload(size_t index, const Image &image)
 {
-  if (newSize.x <= 0 || newSize.y <= 0)
+  if (image.data.empty())
     return;
 
-  m_viewportSize = newSize;
+  GLenum format = GL_RED;
+  GLenum type = GL_UNSIGNED_BYTE;
+  GLint internalFormat;
+  size_t texelBytes;
+  switch (image.type) {
+  case Image::PixelType::R8:
+    internalFormat = GL_R8;
+    texelBytes = 1;
+    break;
+  case Image::PixelType::RGB8:
+    format = GL_RGB;
+    internalFormat = GL_RGB8;
+    texelBytes = 3;
+    break;
+  case Image::PixelType::RGBA8:
+    format = GL_RGBA;
+    internalFormat = GL_RGBA8;
+    texelBytes = 4;
+    break;
+  case Image::PixelType::R16:
+    type = GL_UNSIGNED_SHORT;
+    internalFormat = GL_R16;
+    texelBytes = 2;
+    break;
+  case Image::PixelType::R32F:
+    // displayed through a 16 bit texture, windowed on upload
+    type = GL_FLOAT;
+    internalFormat = GL_R16;
+    texelBytes = 2;
+    break;
+  default:
+    printf("bad image: unsupported pixel type %s\n", toString(image.type));
+    return;
+  }
+
+  CachedTexture cached;
+  glGenTextures(1, &cached.texture);
+  glBindTexture(GL_TEXTURE_2D, cached.texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  if (image.isSingleChannel()) {
+    GLint swizzle[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+  }
 
-  glViewport(0, 0, newSize.x, newSize.y);
+  // high bit depth images are stretched to their value range in the pixel
+  // transfer; GL normalizes 16 bit input before scale/bias
+  const bool window = image.type == Image::PixelType::R16
+      || image.type == Image::PixelType::R32F;
+  if (window) {
+    float lo, hi;
+    valueRange(image, lo, hi);
+    float scale = 1.f / (hi - lo);
+    float bias = -lo * scale;
+    if (image.type == Image::PixelType::R16)
+      scale *= 65535.f;
+    glPixelTransferf(GL_RED_SCALE, scale);
+    glPixelTransferf(GL_RED_BIAS, bias);
+  }
 
-  glBindTexture(GL_TEXTURE_2D, m_framebufferTexture);
+  // upload as is, rows of RGB8/R8/R16 images aren't 4 byte aligned
+  GLint alignment;
+  glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
   glTexImage2D(GL_TEXTURE_2D,
       0,
-      GL_RGBA8,
-      newSize.x,
-      newSize.y,
+      internalFormat,
+      image.width,
+      image.height,
       0,
-      GL_RGBA,
-      GL_UNSIGNED_BYTE,
-      0);
+      format,
+      type,
+      image.data.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
 
-  if (m_imageIndex >= 0)
-    showImage(m_imageIndex);
+  if (window) {
+    glPixelTransferf(GL_RED_SCALE, 1.f);
+    glPixelTransferf(GL_RED_BIAS, 0.f);
+  }
+
+  cached.width = image.width;
+  cached.height = image.height;
+  cached.bytes = image.width * image.height * texelBytes;
+  cached.lastUse = ++m_useCounter;
+  m_textureBytes += cached.bytes;
+  m_textures[index] = cached;
+
+  evict();
+}
+
+void ImageViewport::evict()
+{
+  // least recently used first, the displayed image always stays
+  while (m_textureBytes > m_textureBudget && m_textures.size() > 1) {
+    auto lru = m_textures.end();
+    for (auto it = m_textures.begin(); it != m_textures.end(); ++it) {
+      if (ssize_t(it->first) == m_imageIndex)
+        continue;
+      if (lru == m_textures.end() || it->second.lastUse < lru->second.lastUse)
+        lru = it;
+    }
+    if (lru == m_textures.end())
+      break;
+    glDeleteTextures(1, &lru->second.texture);
+    m_textureBytes -= lru->second.bytes;
+    m_textures.erase(lru);
+  }
 }
 
 } // namespace anari_viewer::windows
@@ -10,11 +10,15 @@
 // anari
 #include <anari/anari_cpp/ext/linalg.h>
 // std
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 // ours
-#include "Image.h"
+#include "ImageCache.h"
+#include "ImageRegion.h"
 #include "Window.h"
 
 namespace anari_viewer::windows {
@@ -22,21 +26,52 @@ namespace anari_viewer::windows {
 class ImageViewport : public anari_viewer::windows::Window
 {
  public:
-  ImageViewport(const std::vector<Image>& images, const char *name = "Image Viewport");
-  ~ImageViewport() = default;
+  ImageViewport(ImageCache& images, const char *name = "Image Viewport");
+  ~ImageViewport();
 
   void buildUI() override;
 
   void showImage(size_t index);
+  // GPU memory the cached image textures may occupy (default 512 MiB)
+  void setTextureBudget(size_t bytes);
+  // centered region of interest outlined on the image (which covers the full
+  // frame); Ctrl+drag draws one
+  void setImageRegion(const ImageRegion &region);
+  void setImageRegionCallback(std::function<void(const ImageRegion &)> callback);
 
  private:
-  void reshape(anari::math::int2 newWindowSize);
+  struct CachedTexture
+  {
+    GLuint texture{0};
+    size_t width{0};
+    size_t height{0};
+    size_t bytes{0};
+    uint64_t lastUse{0};
+  };
 
-  std::vector<Image> m_images;
+  // returns the image's texture, uploading it if not cached and decoded;
+  // nullptr while the image is still being decoded
+  const CachedTexture *texture(size_t index);
+  void upload(size_t index, const Image &image);
+  void evict();
+  void ui_regionSelect();
+
+  ImageCache* m_images;
   ssize_t m_imageIndex{-1};
 
-  GLuint m_framebufferTexture{0};
-  anari::math::int2 m_viewportSize{1920, 1080};
+  // one texture per image in native format, LRU evicted
+  std::unordered_map<size_t, CachedTexture> m_textures;
+  size_t m_textureBytes{0};
+  size_t m_textureBudget{size_t(512) << 20};
+  uint64_t m_useCounter{0};
+  // neighbours decoded in the background and uploaded one per UI frame
+  std::deque<size_t> m_prefetch;
+  int m_prefetchRadius{2};
+
+  ImageRegion m_imageRegion;
+  bool m_selectingRegion{false};
+  anari::math::float2 m_regionStart{0.f, 0.f};
+  std::function<void(const ImageRegion &)> m_imageRegionCallback;
 };
 
 } // namespace anari_viewer::windows
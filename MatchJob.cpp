@@ -0,0 +1,215 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#include "MatchJob.h"
+// std
+#include <array>
+
+static int64_t now()
+{
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+static float seconds(int64_t ticks)
+{
+  using clock = std::chrono::steady_clock;
+  return std::chrono::duration<float>(clock::duration(ticks)).count();
+}
+
+// MatchJob definitions ///////////////////////////////////////////////////////
+
+MatchJob::MatchJob()
+{
+  m_thread = std::thread([this]() { run(); });
+}
+
+MatchJob::~MatchJob()
+{
+  shutdown();
+}
+
+bool MatchJob::submit(image_transform_estimator *estimator, MatchInput input)
+{
+  if (!estimator)
+    return false;
+
+  std::unique_lock<std::mutex> l(m_mutex);
+  if (m_busy || m_quit)
+    return false;
+  m_estimator = estimator;
+  m_stage = input.reference.data ? MatchStage::SET_REFERENCE
+                                  : MatchStage::SET_DEPTH;
+  m_input = std::move(input);
+  m_pending = true;
+  m_hasResult = false;
+  m_cancel = false;
+  m_startTime = now();
+  m_endTime = 0;
+  m_busy = true;
+  l.unlock();
+  m_cond.notify_all();
+  return true;
+}
+
+void MatchJob::cancel()
+{
+  if (m_busy)
+    m_cancel = true;
+}
+
+void MatchJob::shutdown()
+{
+  {
+    std::unique_lock<std::mutex> l(m_mutex);
+    m_quit = true;
+  }
+  m_cancel = true;
+  m_cond.notify_all();
+  if (m_thread.joinable())
+    m_thread.join();
+}
+
+bool MatchJob::busy() const
+{
+  return m_busy;
+}
+
+bool MatchJob::cancelRequested() const
+{
+  return m_busy && m_cancel;
+}
+
+float MatchJob::progress() const
+{
+  return int(m_stage.load()) / float(MatchStage::DONE);
+}
+
+const char *MatchJob::stageName() const
+{
+  return toString(m_stage);
+}
+
+float MatchJob::elapsedSeconds() const
+{
+  int64_t start = m_startTime;
+  if (start == 0)
+    return 0.f;
+  int64_t end = m_endTime;
+  return seconds((end != 0 ? end : now()) - start);
+}
+
+bool MatchJob::takeResult(MatchResult &result)
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  if (m_busy || !m_hasResult)
+    return false;
+  result = m_result;
+  m_hasResult = false;
+  return true;
+}
+
+void MatchJob::run()
+{
+  for (;;) {
+    std::unique_lock<std::mutex> l(m_mutex);
+    m_cond.wait(l, [this]() { return m_quit || m_pending; });
+    if (m_quit)
+      return;
+    m_pending = false;
+    auto *estimator = m_estimator;
+    MatchInput input = std::move(m_input);
+    l.unlock();
+
+    MatchResult result = runMatch(estimator, input, m_cancel, m_stage);
+
+    l.lock();
+    m_endTime = now();
+    result.seconds = seconds(m_endTime - m_startTime);
+    m_hasResult = !m_cancel;
+    m_result = result;
+    m_stage = MatchStage::DONE;
+    m_busy = false;
+  }
+}
+
+// Helper functions ///////////////////////////////////////////////////////////
+
+const char *toString(MatchStage stage)
+{
+  switch (stage) {
+  case MatchStage::SET_REFERENCE:
+    return "reference image";
+  case MatchStage::SET_DEPTH:
+    return "depth image";
+  case MatchStage::SET_QUERY:
+    return "query image";
+  case MatchStage::CALIBRATE:
+    return "calibrate";
+  case MatchStage::MATCH:
+    return "match";
+  case MatchStage::UPDATE_CAMERA:
+    return "update camera";
+  default:
+    return "done";
+  }
+}
+
+MatchResult runMatch(image_transform_estimator *estimator,
+    MatchInput &input,
+    const std::atomic<bool> &cancel,
+    std::atomic<MatchStage> &stage)
+{
+  MatchResult result{input.eye, input.center, input.up};
+
+  if (const auto &ref = input.reference; ref.data) {
+    stage = MatchStage::SET_REFERENCE;
+    estimator->set_image(const_cast<uint8_t *>(ref.data.get()),
+        ref.width,
+        ref.height,
+        ref.pixelType,
+        image_transform_estimator::IMAGE_TYPE::REFERENCE,
+        ref.swizzle);
+    if (cancel)
+      return result;
+  }
+
+  stage = MatchStage::SET_DEPTH;
+  estimator->set_image(input.depth3d.data(),
+      input.width,
+      input.height,
+      image_transform_estimator::PIXEL_TYPE::F32X3,
+      image_transform_estimator::IMAGE_TYPE::DEPTH3D,
+      false /*swizzle*/);
+  if (cancel)
+    return result;
+
+  stage = MatchStage::SET_QUERY;
+  estimator->set_image(input.frame.data(),
+      input.width,
+      input.height,
+      input.pixelType,
+      image_transform_estimator::IMAGE_TYPE::QUERY,
+      false /*swizzle*/);
+  if (cancel)
+    return result;
+
+  stage = MatchStage::CALIBRATE;
+  estimator->calibrate(input.width, input.height, input.fovy, input.aspect);
+  if (cancel)
+    return result;
+
+  stage = MatchStage::MATCH;
+  estimator->match();
+  if (cancel)
+    return result;
+
+  stage = MatchStage::UPDATE_CAMERA;
+  std::array<float, 3> eye{input.eye.x, input.eye.y, input.eye.z};
+  std::array<float, 3> center{input.center.x, input.center.y, input.center.z};
+  std::array<float, 3> up{input.up.x, input.up.y, input.up.z};
+  estimator->update_camera(eye, center, up);
+  result.eye = anari::math::float3{eye[0], eye[1], eye[2]};
+  result.center = anari::math::float3{center[0], center[1], center[2]};
+  result.up = anari::math::float3{up[0], up[1], up[2]};
+  return result;
+}
@@ -0,0 +1,128 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+// anari
+#include <anari/anari_cpp/ext/linalg.h>
+// estimator
+#include <image_transform_estimator.h>
+
+// Reference image handed to set_image; the estimators only read it, so it is
+// shared (e.g. with the image cache) rather than copied
+struct MatchReference
+{
+  std::shared_ptr<const uint8_t> data;
+  image_transform_estimator::PIXEL_TYPE pixelType{
+      image_transform_estimator::PIXEL_TYPE::R8};
+  size_t width{0};
+  size_t height{0};
+  bool swizzle{false};
+};
+
+// Everything a match needs, copied at submission time so the viewport can
+// keep rendering (and the camera can move) while the estimator runs
+struct MatchInput
+{
+  // optional, set before the query if present
+  MatchReference reference;
+  std::vector<uint8_t> frame;
+  image_transform_estimator::PIXEL_TYPE pixelType;
+  std::vector<float> depth3d;
+  size_t width{0};
+  size_t height{0};
+  anari::math::float3 eye;
+  anari::math::float3 center;
+  anari::math::float3 up;
+  float fovy{0.f};
+  float aspect{1.f};
+};
+
+struct MatchResult
+{
+  anari::math::float3 eye;
+  anari::math::float3 center;
+  anari::math::float3 up;
+  float seconds{0.f};
+};
+
+enum class MatchStage
+{
+  SET_REFERENCE,
+  SET_DEPTH,
+  SET_QUERY,
+  CALIBRATE,
+  MATCH,
+  UPDATE_CAMERA,
+  DONE,
+};
+
+const char *toString(MatchStage stage);
+
+// set_image/calibrate/match/update_camera for one snapshot on the calling
+// thread; returns early (with the input pose) once cancel is set, stage is
+// updated as the calls proceed
+MatchResult runMatch(image_transform_estimator *estimator,
+    MatchInput &input,
+    const std::atomic<bool> &cancel,
+    std::atomic<MatchStage> &stage);
+
+// Runs set_image/calibrate/match/update_camera for one snapshot on a worker
+// thread. The estimator ABI can't be interrupted, so cancelling takes effect
+// between the stages and discards the result; the job stays busy until the
+// running stage returns. Only one job runs at a time, and the estimator must
+// not be used elsewhere while busy().
+class MatchJob
+{
+ public:
+  MatchJob();
+  ~MatchJob();
+
+  MatchJob(const MatchJob &) = delete;
+  MatchJob &operator=(const MatchJob &) = delete;
+
+  // false if a job is still busy
+  bool submit(image_transform_estimator *estimator, MatchInput input);
+  void cancel();
+  // cancel and join the worker thread, e.g. before the estimators go away;
+  // no jobs can be submitted afterwards (the destructor does it as well)
+  void shutdown();
+
+  bool busy() const;
+  bool cancelRequested() const;
+  // finished stages / total stages, and the name of the running one
+  float progress() const;
+  const char *stageName() const;
+  float elapsedSeconds() const;
+
+  // result of the last job, returned once; false while busy or if the job
+  // was cancelled
+  bool takeResult(MatchResult &result);
+
+ private:
+  void run();
+
+  image_transform_estimator *m_estimator{nullptr};
+  MatchInput m_input;
+  bool m_pending{false};
+  bool m_hasResult{false};
+  MatchResult m_result;
+  bool m_quit{false};
+  std::atomic<bool> m_busy{false};
+  std::atomic<bool> m_cancel{false};
+  std::atomic<MatchStage> m_stage{MatchStage::SET_DEPTH};
+  std::atomic<int64_t> m_startTime{0}; // steady clock ticks
+  std::atomic<int64_t> m_endTime{0};
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::thread m_thread;
+};
@@ -0,0 +1,206 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#include "MatchRace.h"
+// std
+#include <cmath>
+#include <cstdio>
+
+// MatchRace definitions //////////////////////////////////////////////////////
+
+MatchRace::~MatchRace()
+{
+  cancel();
+  join();
+}
+
+bool MatchRace::submit(const std::vector<image_transform_estimator *> &estimators,
+    const std::vector<std::string> &names,
+    const MatchInput &input,
+    ScoreFunction score,
+    const Settings &settings)
+{
+  if (estimators.empty() || busy())
+    return false;
+  join();
+
+  std::unique_lock<std::mutex> l(m_mutex);
+  m_runners.clear();
+  m_settings = settings;
+  m_score = std::move(score);
+  m_decided = false;
+  m_cancelled = false;
+  m_hasResult = false;
+  m_winner = size_t(-1);
+  m_start = std::chrono::steady_clock::now();
+  m_endTime = 0;
+  m_running = int(estimators.size());
+
+  for (size_t i = 0; i < estimators.size(); ++i) {
+    auto runner = std::make_unique<Runner>();
+    runner->entry.name = i < names.size() ? names[i] : std::to_string(i);
+    m_runners.push_back(std::move(runner));
+  }
+  // every estimator gets its own copy of the frame (set_image takes
+  // non-const pointers); the reference is shared
+  for (size_t i = 0; i < estimators.size(); ++i) {
+    m_runners[i]->thread = std::thread(
+        [this, i, estimator = estimators[i], input]() mutable {
+          run(i, estimator, std::move(input), m_score);
+        });
+  }
+  return true;
+}
+
+void MatchRace::cancel()
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  if (m_decided || m_runners.empty())
+    return;
+  for (auto &r : m_runners) {
+    r->cancel = true;
+    if (r->entry.state == State::RUNNING)
+      r->entry.state = State::CANCELLED;
+  }
+  m_cancelled = true;
+  m_decided = true;
+}
+
+bool MatchRace::busy() const
+{
+  return m_running > 0;
+}
+
+bool MatchRace::decided() const
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  return m_decided;
+}
+
+float MatchRace::elapsedSeconds() const
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  if (m_runners.empty())
+    return 0.f;
+  using clock = std::chrono::steady_clock;
+  int64_t end = m_endTime;
+  auto endTime = end != 0 ? clock::time_point(clock::duration(end)) : clock::now();
+  return std::chrono::duration<float>(endTime - m_start).count();
+}
+
+std::vector<MatchRace::Entry> MatchRace::entries() const
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  std::vector<Entry> result;
+  for (auto &r : m_runners) {
+    result.push_back(r->entry);
+    result.back().stage = r->stage;
+    if (r->entry.state == State::RUNNING) {
+      result.back().seconds = std::chrono::duration<float>(
+          std::chrono::steady_clock::now() - m_start)
+                                  .count();
+    }
+  }
+  return result;
+}
+
+size_t MatchRace::winner() const
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  return m_winner;
+}
+
+bool MatchRace::takeResult(MatchResult &result, size_t &winner)
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  if (!m_hasResult)
+    return false;
+  result = m_runners[m_winner]->result;
+  winner = m_winner;
+  m_hasResult = false;
+  return true;
+}
+
+void MatchRace::run(size_t index,
+    image_transform_estimator *estimator,
+    MatchInput input,
+    const ScoreFunction &score)
+{
+  auto &runner = *m_runners[index];
+  MatchResult result = runMatch(estimator, input, runner.cancel, runner.stage);
+  const float seconds = std::chrono::duration<float>(
+      std::chrono::steady_clock::now() - m_start)
+                            .count();
+  result.seconds = seconds;
+
+  float s = std::numeric_limits<float>::quiet_NaN();
+  if (!runner.cancel && score)
+    s = score(result);
+
+  std::unique_lock<std::mutex> l(m_mutex);
+  runner.result = result;
+  runner.entry.seconds = seconds;
+  runner.entry.score = s;
+  runner.stage = MatchStage::DONE;
+  if (!runner.cancel)
+    runner.entry.state = State::DONE;
+
+  if (!m_decided && runner.entry.state == State::DONE
+      && m_settings.cancelStragglers && std::isfinite(s)
+      && s <= m_settings.goodEnough)
+    decide(index);
+
+  if (--m_running == 0) {
+    m_endTime = std::chrono::steady_clock::now().time_since_epoch().count();
+    if (!m_decided) {
+      // best score; without any, the first to finish
+      size_t best = size_t(-1);
+      for (size_t i = 0; i < m_runners.size(); ++i) {
+        const auto &e = m_runners[i]->entry;
+        if (e.state != State::DONE)
+          continue;
+        if (best == size_t(-1))
+          best = i;
+        const auto &b = m_runners[best]->entry;
+        const bool better = std::isfinite(e.score)
+            && (!std::isfinite(b.score) || e.score < b.score
+                || (e.score == b.score && e.seconds < b.seconds));
+        const bool faster = !std::isfinite(e.score) && !std::isfinite(b.score)
+            && e.seconds < b.seconds;
+        if (better || faster)
+          best = i;
+      }
+      if (best != size_t(-1))
+        decide(best);
+      else
+        m_decided = true;
+    }
+  }
+}
+
+void MatchRace::decide(size_t winner)
+{
+  m_decided = true;
+  m_winner = winner;
+  m_hasResult = !m_cancelled;
+  for (size_t i = 0; i < m_runners.size(); ++i) {
+    auto &r = *m_runners[i];
+    if (i != winner && r.entry.state == State::RUNNING) {
+      r.cancel = true;
+      r.entry.state = State::CANCELLED;
+    }
+  }
+  const auto &e = m_runners[winner]->entry;
+  printf("match race: %s wins after %.2fs, score %.4f\n",
+      e.name.c_str(),
+      e.seconds,
+      e.score);
+}
+
+void MatchRace::join()
+{
+  for (auto &r : m_runners) {
+    if (r->thread.joinable())
+      r->thread.join();
+  }
+}
@@ -0,0 +1,104 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <functional>
+#include <limits>
+#include <string>
+// ours
+#include "MatchJob.h"
+
+// Runs the same snapshot (reference, query and depth3d) through several
+// estimators at once, one thread each, and keeps the best proposed camera.
+// Proposals are ranked by a score function (lower is better, NaN if
+// unknown), called on the estimator's thread. With cancelStragglers, the
+// first proposal scoring at most goodEnough wins and the others are
+// cancelled; they stop at their next stage boundary, and the race stays
+// busy() until their running calls returned.
+class MatchRace
+{
+ public:
+  using ScoreFunction = std::function<float(const MatchResult &)>;
+
+  struct Settings
+  {
+    bool enabled{false};
+    bool cancelStragglers{true};
+    float goodEnough{.1f};
+  };
+
+  enum class State
+  {
+    RUNNING,
+    DONE,
+    CANCELLED,
+  };
+
+  struct Entry
+  {
+    std::string name;
+    State state{State::RUNNING};
+    MatchStage stage{MatchStage::SET_REFERENCE};
+    float seconds{0.f};
+    float score{std::numeric_limits<float>::quiet_NaN()};
+  };
+
+  MatchRace() = default;
+  ~MatchRace();
+
+  MatchRace(const MatchRace &) = delete;
+  MatchRace &operator=(const MatchRace &) = delete;
+
+  // false if a race is still busy or there are no estimators
+  bool submit(const std::vector<image_transform_estimator *> &estimators,
+      const std::vector<std::string> &names,
+      const MatchInput &input,
+      ScoreFunction score,
+      const Settings &settings);
+  void cancel();
+
+  // an estimator is still running
+  bool busy() const;
+  // the winner is known (or the race was cancelled)
+  bool decided() const;
+  float elapsedSeconds() const;
+  // per-estimator state, latency and score
+  std::vector<Entry> entries() const;
+  // index of the winning estimator, -1 if none (yet)
+  size_t winner() const;
+
+  // best proposal of the last race, returned once
+  bool takeResult(MatchResult &result, size_t &winner);
+
+ private:
+  struct Runner
+  {
+    Entry entry;
+    MatchResult result;
+    std::atomic<bool> cancel{false};
+    std::atomic<MatchStage> stage{MatchStage::SET_REFERENCE};
+    std::thread thread;
+  };
+
+  void run(size_t index,
+      image_transform_estimator *estimator,
+      MatchInput input,
+      const ScoreFunction &score);
+  // with m_mutex held
+  void decide(size_t winner);
+  void join();
+
+  std::vector<std::unique_ptr<Runner>> m_runners;
+  Settings m_settings;
+  ScoreFunction m_score;
+  std::atomic<int> m_running{0};
+  bool m_decided{false};
+  bool m_cancelled{false};
+  bool m_hasResult{false};
+  size_t m_winner{size_t(-1)};
+  std::chrono::steady_clock::time_point m_start;
+  std::atomic<int64_t> m_endTime{0}; // steady clock ticks
+  mutable std::mutex m_mutex;
+};
@@ -0,0 +1,287 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// anari
+#include <anari/anari_cpp/ext/linalg.h>
+// std
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+struct PoseMatch
+{
+  size_t prediction;
+  bool refined; // refined or initial camera of the prediction
+  float distance;
+};
+
+// Nearest neighbour lookup over camera poses. A pose is a point in 6D:
+// the eye position and the unit view direction scaled by directionWeight
+// (world units per unit of direction difference). Points are kept as a
+// structure of arrays and indexed by an implicit, balanced KD-tree; poses
+// added or removed after a build are handled by a linear pending list and
+// tombstones until the next (automatic) rebuild.
+class PoseIndex
+{
+ public:
+  void clear()
+  {
+    for (auto &c : m_coords)
+      c.clear();
+    m_prediction.clear();
+    m_refined.clear();
+    m_removed.clear();
+    m_tree.clear();
+    m_splitDim.clear();
+    m_pending.clear();
+    m_slots.clear();
+    m_numRemoved = 0;
+  }
+
+  // adds or replaces the pose of a prediction's initial or refined camera
+  void add(size_t prediction,
+      bool refined,
+      const anari::math::float3 &eye,
+      const anari::math::float3 &center)
+  {
+    remove(prediction, refined);
+
+    anari::math::float3 dir = center - eye;
+    float len = anari::math::length(dir);
+    dir = len > 0.f ? dir / len : anari::math::float3(0.f, 0.f, -1.f);
+    const float p[6] = {eye.x, eye.y, eye.z, dir.x, dir.y, dir.z};
+    for (int d = 0; d < 6; ++d)
+      m_coords[d].push_back(p[d]);
+    uint32_t id = uint32_t(m_prediction.size());
+    m_prediction.push_back(uint32_t(prediction));
+    m_refined.push_back(refined);
+    m_removed.push_back(false);
+    m_slots[key(prediction, refined)] = id;
+    m_pending.push_back(id);
+
+    // bulk adds into an empty index wait for the explicit build()
+    if (!m_tree.empty()
+        && m_pending.size() > std::max<size_t>(64, m_tree.size() / 8))
+      build();
+  }
+
+  void remove(size_t prediction, bool refined)
+  {
+    auto it = m_slots.find(key(prediction, refined));
+    if (it == m_slots.end())
+      return;
+    m_removed[it->second] = true;
+    ++m_numRemoved;
+    m_slots.erase(it);
+
+    if (!m_tree.empty() && m_numRemoved > std::max<size_t>(64, size() / 4))
+      build();
+  }
+
+  // live poses
+  size_t size() const
+  {
+    return m_prediction.size() - m_numRemoved;
+  }
+
+  void setDirectionWeight(float w)
+  {
+    m_directionWeight = w;
+  }
+
+  float directionWeight() const
+  {
+    return m_directionWeight;
+  }
+
+  // rebuild the tree over all live poses, dropping removed ones
+  void build()
+  {
+    if (m_numRemoved > 0)
+      compact();
+
+    m_pending.clear();
+    m_tree.resize(m_prediction.size());
+    std::iota(m_tree.begin(), m_tree.end(), 0u);
+    m_splitDim.assign(m_tree.size(), 0);
+    buildRange(0, m_tree.size());
+  }
+
+  // k nearest poses, closest first
+  std::vector<PoseMatch> nearest(const anari::math::float3 &eye,
+      const anari::math::float3 &center,
+      size_t k) const
+  {
+    std::vector<PoseMatch> result;
+    if (k == 0 || size() == 0)
+      return result;
+
+    anari::math::float3 dir = center - eye;
+    float len = anari::math::length(dir);
+    dir = len > 0.f ? dir / len : anari::math::float3(0.f, 0.f, -1.f);
+    Query q;
+    q.p = {eye.x, eye.y, eye.z, dir.x, dir.y, dir.z};
+    q.w2 = m_directionWeight * m_directionWeight;
+    q.k = k;
+
+    if (!m_tree.empty())
+      searchRange(q, 0, m_tree.size());
+    for (uint32_t id : m_pending)
+      consider(q, id);
+
+    result.resize(q.best.size());
+    for (size_t i = result.size(); i-- > 0;) {
+      auto [d2, id] = q.best.top();
+      q.best.pop();
+      result[i] = {m_prediction[id], bool(m_refined[id]), std::sqrt(d2)};
+    }
+    return result;
+  }
+
+ private:
+  struct Query
+  {
+    std::array<float, 6> p;
+    float w2; // squared direction weight
+    size_t k;
+    // max-heap of (squared distance, id)
+    std::priority_queue<std::pair<float, uint32_t>> best;
+
+    float worst() const
+    {
+      return best.size() < k ? std::numeric_limits<float>::max()
+                             : best.top().first;
+    }
+  };
+
+  static uint64_t key(size_t prediction, bool refined)
+  {
+    return uint64_t(prediction) << 1 | uint64_t(refined);
+  }
+
+  float scale2(int dim, float w2) const
+  {
+    return dim < 3 ? 1.f : w2;
+  }
+
+  void consider(Query &q, uint32_t id) const
+  {
+    if (m_removed[id])
+      return;
+    float d2 = 0.f;
+    for (int d = 0; d < 6; ++d) {
+      float diff = m_coords[d][id] - q.p[d];
+      d2 += diff * diff * scale2(d, q.w2);
+    }
+    if (d2 < q.worst()) {
+      q.best.push({d2, id});
+      if (q.best.size() > q.k)
+        q.best.pop();
+    }
+  }
+
+  // median split on the dimension with the largest extent; the median of
+  // [lo, hi) sits at its middle, its children in the two halves
+  void buildRange(size_t lo, size_t hi)
+  {
+    if (hi - lo <= 1)
+      return;
+
+    int dim = 0;
+    float extent = -1.f;
+    for (int d = 0; d < 6; ++d) {
+      auto [mn, mx] = std::minmax_element(m_tree.begin() + lo,
+          m_tree.begin() + hi,
+          [&](uint32_t a, uint32_t b) {
+            return m_coords[d][a] < m_coords[d][b];
+          });
+      float e = (m_coords[d][*mx] - m_coords[d][*mn])
+          * (d < 3 ? 1.f : m_directionWeight);
+      if (e > extent) {
+        extent = e;
+        dim = d;
+      }
+    }
+
+    size_t mid = lo + (hi - lo) / 2;
+    std::nth_element(m_tree.begin() + lo,
+        m_tree.begin() + mid,
+        m_tree.begin() + hi,
+        [&](uint32_t a, uint32_t b) {
+          return m_coords[dim][a] < m_coords[dim][b];
+        });
+    m_splitDim[mid] = uint8_t(dim);
+    buildRange(lo, mid);
+    buildRange(mid + 1, hi);
+  }
+
+  void searchRange(Query &q, size_t lo, size_t hi) const
+  {
+    if (lo >= hi)
+      return;
+    size_t mid = lo + (hi - lo) / 2;
+    uint32_t id = m_tree[mid];
+    consider(q, id);
+    if (hi - lo == 1)
+      return;
+
+    int dim = m_splitDim[mid];
+    float diff = q.p[dim] - m_coords[dim][id];
+    bool left = diff < 0.f;
+    if (left)
+      searchRange(q, lo, mid);
+    else
+      searchRange(q, mid + 1, hi);
+    if (diff * diff * scale2(dim, q.w2) < q.worst()) {
+      if (left)
+        searchRange(q, mid + 1, hi);
+      else
+        searchRange(q, lo, mid);
+    }
+  }
+
+  void compact()
+  {
+    size_t n = 0;
+    m_slots.clear();
+    for (size_t i = 0; i < m_prediction.size(); ++i) {
+      if (m_removed[i])
+        continue;
+      for (auto &c : m_coords)
+        c[n] = c[i];
+      m_prediction[n] = m_prediction[i];
+      m_refined[n] = m_refined[i];
+      m_removed[n] = false;
+      m_slots[key(m_prediction[n], m_refined[n])] = uint32_t(n);
+      ++n;
+    }
+    for (auto &c : m_coords)
+      c.resize(n);
+    m_prediction.resize(n);
+    m_refined.resize(n);
+    m_removed.resize(n);
+    m_numRemoved = 0;
+  }
+
+  // eye x, y, z, direction x, y, z
+  std::array<std::vector<float>, 6> m_coords;
+  std::vector<uint32_t> m_prediction;
+  std::vector<uint8_t> m_refined;
+  std::vector<uint8_t> m_removed;
+  size_t m_numRemoved{0};
+  // point ids in implicit tree order and the split dimension per node
+  std::vector<uint32_t> m_tree;
+  std::vector<uint8_t> m_splitDim;
+  // ids added since the last build, searched linearly
+  std::vector<uint32_t> m_pending;
+  std::unordered_map<uint64_t, uint32_t> m_slots;
+  float m_directionWeight{1.f};
+};
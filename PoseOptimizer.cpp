@@ -0,0 +1,515 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#include "PoseOptimizer.h"
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <numeric>
+#include <random>
+
+using anari::math::float3;
+
+namespace {
+
+constexpr int N = 6;
+
+} // namespace
+
+// PoseOptimizer definitions //////////////////////////////////////////////////
+
+PoseOptimizer::~PoseOptimizer()
+{
+  cancel();
+  if (m_thread.joinable())
+    m_thread.join();
+}
+
+bool PoseOptimizer::start(const CpuDrrRenderer &renderer,
+    std::shared_ptr<const Image> reference,
+    const CameraKey &pose,
+    float fovy,
+    float aspect,
+    const Settings &settings)
+{
+  if (busy() || !reference || reference->width == 0 || !renderer.field())
+    return false;
+  if (m_thread.joinable())
+    m_thread.join();
+
+  m_settings = settings;
+  m_settings.width = std::max(settings.width, 16);
+  m_settings.levels = 1;
+  while (m_settings.levels < settings.levels
+      && (m_settings.width >> m_settings.levels) >= 16)
+    ++m_settings.levels;
+  m_fovy = fovy;
+  m_aspect = aspect;
+  m_reference = std::move(reference);
+
+  // as many jobs as candidates per iteration, the cores split among them
+  const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  const int batch = settings.method == Method::CMA_ES
+      ? (settings.population > 0 ? settings.population
+                                 : 4 + int(3.f * std::log(float(N))))
+      : N + 1;
+  m_settings.jobs = std::clamp(
+      settings.jobs ? settings.jobs : cores, 1u, unsigned(std::max(batch, 1)));
+  m_renderer = renderer;
+  m_renderer.setNumThreads(std::max(1u, cores / m_settings.jobs));
+  m_frames.resize(m_settings.jobs);
+
+  m_evaluations = 0;
+  {
+    std::unique_lock<std::mutex> l(m_mutex);
+    m_start = pose;
+    m_best.fill(0.f);
+    m_bestCost = std::numeric_limits<float>::max();
+    m_iterations.clear();
+    m_levels.clear();
+    m_stopReason = StopReason::NONE;
+    m_hasResult = false;
+    m_startTime = std::chrono::steady_clock::now();
+    m_seconds = 0.f;
+  }
+  m_cancel = false;
+  m_busy = true;
+  m_thread = std::thread([this]() { run(); });
+  return true;
+}
+
+void PoseOptimizer::cancel()
+{
+  m_cancel = true;
+}
+
+bool PoseOptimizer::busy() const
+{
+  return m_busy;
+}
+
+float PoseOptimizer::elapsedSeconds() const
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  if (!m_busy)
+    return m_seconds;
+  return std::chrono::duration<float>(
+      std::chrono::steady_clock::now() - m_startTime)
+      .count();
+}
+
+std::vector<PoseOptimizer::Iteration> PoseOptimizer::iterations() const
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  return m_iterations;
+}
+
+std::vector<PoseOptimizer::Level> PoseOptimizer::levels() const
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  return m_levels;
+}
+
+PoseOptimizer::StopReason PoseOptimizer::stopReason() const
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  return m_stopReason;
+}
+
+bool PoseOptimizer::takeResult(CameraKey &pose, float &cost)
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  if (!m_hasResult)
+    return false;
+  pose = poseAt(m_best);
+  cost = m_bestCost;
+  m_hasResult = false;
+  return true;
+}
+
+CameraKey PoseOptimizer::poseAt(const Params &x) const
+{
+  const float ts = m_settings.translationStep * m_scale;
+  const float rs = m_settings.rotationStep * m_scale;
+  const float t[3] = {x[0] * ts, x[1] * ts, x[2] * ts};
+  const float r[3] = {x[3] * rs, x[4] * rs, x[5] * rs};
+  return offsetPose(m_start, t, r);
+}
+
+void PoseOptimizer::run()
+{
+  printf("pose optimizer: %s, %s, %i level(s)\n",
+      toString(m_settings.method),
+      toString(m_settings.metric),
+      m_settings.levels);
+
+  for (int level = m_settings.levels - 1; level >= 0 && !m_cancel; --level) {
+    const auto levelStart = std::chrono::steady_clock::now();
+    const int evaluations = m_evaluations;
+    m_width = m_settings.width >> level;
+    m_height = std::max(8, int(std::lround(m_width / m_aspect)));
+    const size_t factor =
+        std::max<size_t>(1, m_reference->width / size_t(m_width));
+    m_fixed = MetricImage::fromImage(factor > 1
+            ? downsample(*m_reference, factor)
+            : *m_reference,
+        m_width,
+        m_height);
+    {
+      // continue at the previous level's best pose, costs start over
+      std::unique_lock<std::mutex> l(m_mutex);
+      if (level != m_settings.levels - 1)
+        m_start = poseAt(m_best);
+      m_level = level;
+      m_scale = 1.f / float(1 << (m_settings.levels - 1 - level));
+      m_best.fill(0.f);
+      m_bestCost = std::numeric_limits<float>::max();
+      m_stopReason = StopReason::NONE;
+    }
+
+    const float startCost = evaluate({Params{}})[0];
+    if (m_settings.method == Method::CMA_ES)
+      runCmaEs();
+    else
+      runNelderMead(startCost);
+
+    std::unique_lock<std::mutex> l(m_mutex);
+    Level result;
+    result.level = level;
+    result.width = m_width;
+    result.height = m_height;
+    result.iterations = 0;
+    for (const auto &it : m_iterations)
+      result.iterations += it.level == level;
+    result.evaluations = m_evaluations - evaluations;
+    result.seconds = std::chrono::duration<float>(
+        std::chrono::steady_clock::now() - levelStart)
+                         .count();
+    result.startCost = startCost;
+    result.cost = m_bestCost;
+    m_levels.push_back(result);
+    printf("pose optimizer %ix%i: %s, %i iteration(s), %i evaluations, %.2fs",
+        result.width,
+        result.height,
+        toString(m_stopReason),
+        result.iterations,
+        result.evaluations,
+        result.seconds);
+    if (m_bestCost != std::numeric_limits<float>::max())
+      printf(", cost %.4f -> %.4f", result.startCost, result.cost);
+    printf("\n");
+  }
+
+  std::unique_lock<std::mutex> l(m_mutex);
+  if (m_stopReason == StopReason::NONE || m_cancel)
+    m_stopReason = m_cancel ? StopReason::CANCELLED : StopReason::FAILED;
+  if (m_bestCost == std::numeric_limits<float>::max())
+    m_stopReason = m_cancel ? StopReason::CANCELLED : StopReason::FAILED;
+  m_hasResult = m_stopReason == StopReason::CONVERGED
+      || m_stopReason == StopReason::MAX_ITERATIONS;
+  m_seconds = std::chrono::duration<float>(
+      std::chrono::steady_clock::now() - m_startTime)
+                  .count();
+  printf("pose optimizer: %s after %zu iteration(s), %i evaluations, %.2fs\n",
+      toString(m_stopReason),
+      m_iterations.size(),
+      m_evaluations,
+      m_seconds);
+  m_busy = false;
+}
+
+std::vector<float> PoseOptimizer::evaluate(const std::vector<Params> &candidates)
+{
+  const int width = m_width, height = m_height;
+  MetricSettings metricSettings;
+  metricSettings.numThreads = 1;
+
+  std::vector<float> costs(candidates.size(), std::numeric_limits<float>::max());
+  std::atomic<size_t> next{0};
+  auto worker = [&](CpuDrrFrame &frame) {
+    for (size_t i = next++; i < candidates.size(); i = next++) {
+      const CameraKey pose = poseAt(candidates[i]);
+      CpuDrrCamera camera{pose.eye, pose.center, pose.up, m_fovy, m_aspect};
+      if (!m_renderer.render(camera, width, height, frame, &m_cancel))
+        continue;
+      const float value = computeMetric(m_settings.metric,
+          MetricImage::fromFrame(frame.lineIntegral.data(), width, height),
+          m_fixed,
+          nullptr,
+          metricSettings);
+      // NaN (e.g. the volume is out of view) ranks last
+      if (std::isfinite(value))
+        costs[i] = metricCost(m_settings.metric, value);
+    }
+  };
+
+  const size_t jobs = std::min<size_t>(m_frames.size(), candidates.size());
+  std::vector<std::thread> threads;
+  for (size_t j = 1; j < jobs; ++j)
+    threads.emplace_back(worker, std::ref(m_frames[j]));
+  worker(m_frames[0]);
+  for (auto &t : threads)
+    t.join();
+
+  std::unique_lock<std::mutex> l(m_mutex);
+  m_evaluations += int(candidates.size());
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (costs[i] < m_bestCost) {
+      m_bestCost = costs[i];
+      m_best = candidates[i];
+    }
+  }
+  return costs;
+}
+
+bool PoseOptimizer::iterationDone(float bestCost, float step, int &iteration)
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  Iteration it;
+  it.level = m_level;
+  it.index = ++iteration;
+  it.bestCost = bestCost;
+  it.evaluations = m_evaluations;
+  it.seconds = std::chrono::duration<float>(
+      std::chrono::steady_clock::now() - m_startTime)
+                   .count();
+  m_iterations.push_back(it);
+
+  if (m_cancel)
+    m_stopReason = StopReason::CANCELLED;
+  // in absolute terms, the radius may shrink to minStep at the finest level
+  // and twice that per coarser level
+  else if (step * m_scale < m_settings.minStep * float(1 << m_level))
+    m_stopReason = StopReason::CONVERGED;
+  else if (it.index >= m_settings.maxIterations)
+    m_stopReason = StopReason::MAX_ITERATIONS;
+  return m_stopReason != StopReason::NONE;
+}
+
+void PoseOptimizer::runCmaEs()
+{
+  // sep-CMA-ES in units of the initial step, diagonal covariance
+  const int lambda = m_settings.population > 0
+      ? std::max(m_settings.population, 2)
+      : 4 + int(3.f * std::log(float(N)));
+  const int mu = lambda / 2;
+  std::vector<float> weights(mu);
+  for (int i = 0; i < mu; ++i)
+    weights[i] = std::log(mu + .5f) - std::log(i + 1.f);
+  const float sum = std::accumulate(weights.begin(), weights.end(), 0.f);
+  float sumSq = 0.f;
+  for (auto &w : weights) {
+    w /= sum;
+    sumSq += w * w;
+  }
+  const float mueff = 1.f / sumSq;
+
+  const float cs = (mueff + 2.f) / (N + mueff + 5.f);
+  const float ds =
+      1.f + 2.f * std::max(0.f, std::sqrt((mueff - 1.f) / (N + 1.f)) - 1.f) + cs;
+  const float cc = (4.f + mueff / N) / (N + 4.f + 2.f * mueff / N);
+  // the diagonal covariance learns (n + 2) / 3 times faster
+  const float c1 = 2.f / ((N + 1.3f) * (N + 1.3f) + mueff) * (N + 2.f) / 3.f;
+  const float cmu = std::min(1.f - c1,
+      2.f * (mueff - 2.f + 1.f / mueff) / ((N + 2.f) * (N + 2.f) + mueff)
+          * (N + 2.f) / 3.f);
+  const float chiN = std::sqrt(float(N)) * (1.f - 1.f / (4.f * N) + 1.f / (21.f * N * N));
+
+  Params mean{}, C, D, pc{}, ps{};
+  C.fill(1.f);
+  D.fill(1.f);
+  float sigma = 1.f;
+
+  std::mt19937 rng(1);
+  std::normal_distribution<float> normal;
+  std::vector<Params> y(lambda), x(lambda);
+  std::vector<int> order(lambda);
+
+  for (int g = 0;;) {
+    for (int k = 0; k < lambda; ++k) {
+      for (int i = 0; i < N; ++i) {
+        y[k][i] = D[i] * normal(rng);
+        x[k][i] = mean[i] + sigma * y[k][i];
+      }
+    }
+    const std::vector<float> costs = evaluate(x);
+    if (m_cancel) {
+      iterationDone(m_bestCost, sigma, g);
+      return;
+    }
+
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+      return costs[a] < costs[b];
+    });
+
+    Params yw{};
+    for (int k = 0; k < mu; ++k) {
+      for (int i = 0; i < N; ++i)
+        yw[i] += weights[k] * y[order[k]][i];
+    }
+    float psNorm = 0.f;
+    for (int i = 0; i < N; ++i) {
+      mean[i] += sigma * yw[i];
+      ps[i] = (1.f - cs) * ps[i]
+          + std::sqrt(cs * (2.f - cs) * mueff) * yw[i] / D[i];
+      psNorm += ps[i] * ps[i];
+    }
+    psNorm = std::sqrt(psNorm);
+    const bool hsig = psNorm / std::sqrt(1.f - std::pow(1.f - cs, 2.f * (g + 1)))
+        < (1.4f + 2.f / (N + 1.f)) * chiN;
+
+    float step = 0.f;
+    for (int i = 0; i < N; ++i) {
+      pc[i] = (1.f - cc) * pc[i]
+          + (hsig ? std::sqrt(cc * (2.f - cc) * mueff) * yw[i] : 0.f);
+      float rankMu = 0.f;
+      for (int k = 0; k < mu; ++k)
+        rankMu += weights[k] * y[order[k]][i] * y[order[k]][i];
+      C[i] = (1.f - c1 - cmu) * C[i]
+          + c1 * (pc[i] * pc[i] + (hsig ? 0.f : cc * (2.f - cc) * C[i]))
+          + cmu * rankMu;
+      D[i] = std::sqrt(C[i]);
+    }
+    sigma *= std::exp((cs / ds) * (psNorm / chiN - 1.f));
+    for (int i = 0; i < N; ++i)
+      step = std::max(step, sigma * D[i]);
+
+    if (iterationDone(m_bestCost, step, g))
+      return;
+  }
+}
+
+void PoseOptimizer::runNelderMead(float startCost)
+{
+  // initial simplex: the start pose and one step along every parameter
+  std::vector<Params> simplex(N + 1, Params{});
+  for (int i = 0; i < N; ++i)
+    simplex[i + 1][i] = 1.f;
+  std::vector<float> costs(N + 1);
+  {
+    std::vector<Params> vertices(simplex.begin() + 1, simplex.end());
+    const std::vector<float> c = evaluate(vertices);
+    costs[0] = startCost;
+    std::copy(c.begin(), c.end(), costs.begin() + 1);
+  }
+
+  std::vector<int> order(N + 1);
+  for (int g = 0;;) {
+    if (m_cancel) {
+      iterationDone(m_bestCost, 0.f, g);
+      return;
+    }
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+      return costs[a] < costs[b];
+    });
+    const int best = order[0], worst = order[N], secondWorst = order[N - 1];
+
+    Params centroid{};
+    for (int k = 0; k < N; ++k) {
+      for (int i = 0; i < N; ++i)
+        centroid[i] += simplex[order[k]][i] / N;
+    }
+    // reflection, expansion, outside and inside contraction at once
+    const float coefficients[4] = {1.f, 2.f, .5f, -.5f};
+    std::vector<Params> trial(4);
+    for (int t = 0; t < 4; ++t) {
+      for (int i = 0; i < N; ++i) {
+        trial[t][i] = centroid[i]
+            + coefficients[t] * (centroid[i] - simplex[worst][i]);
+      }
+    }
+    const std::vector<float> f = evaluate(trial);
+    if (m_cancel)
+      continue;
+
+    int accepted = -1;
+    if (f[0] < costs[best])
+      accepted = f[1] < f[0] ? 1 : 0;
+    else if (f[0] < costs[secondWorst])
+      accepted = 0;
+    else if (f[0] < costs[worst])
+      accepted = f[2] <= f[0] ? 2 : -1;
+    else
+      accepted = f[3] < costs[worst] ? 3 : -1;
+
+    if (accepted >= 0) {
+      simplex[worst] = trial[accepted];
+      costs[worst] = f[accepted];
+    } else {
+      // shrink towards the best vertex
+      std::vector<Params> shrunk;
+      for (int k = 1; k <= N; ++k) {
+        Params &v = simplex[order[k]];
+        for (int i = 0; i < N; ++i)
+          v[i] = simplex[best][i] + .5f * (v[i] - simplex[best][i]);
+        shrunk.push_back(v);
+      }
+      const std::vector<float> c = evaluate(shrunk);
+      for (int k = 1; k <= N; ++k)
+        costs[order[k]] = c[k - 1];
+    }
+
+    float step = 0.f;
+    for (int k = 0; k <= N; ++k) {
+      for (int i = 0; i < N; ++i)
+        step = std::max(step, std::abs(simplex[k][i] - simplex[best][i]));
+    }
+    if (iterationDone(m_bestCost, step, g))
+      return;
+  }
+}
+
+const char *toString(PoseOptimizer::Method method)
+{
+  switch (method) {
+  case PoseOptimizer::Method::CMA_ES:
+    return "CMA-ES";
+  case PoseOptimizer::Method::NELDER_MEAD:
+    return "Nelder-Mead";
+  }
+  return "unknown";
+}
+
+const char *toString(PoseOptimizer::StopReason reason)
+{
+  switch (reason) {
+  case PoseOptimizer::StopReason::NONE:
+    return "none";
+  case PoseOptimizer::StopReason::CONVERGED:
+    return "converged";
+  case PoseOptimizer::StopReason::MAX_ITERATIONS:
+    return "max iterations";
+  case PoseOptimizer::StopReason::CANCELLED:
+    return "cancelled";
+  case PoseOptimizer::StopReason::FAILED:
+    return "failed";
+  }
+  return "unknown";
+}
+
+CameraKey offsetPose(const CameraKey &pose, const float t[3], const float r[3])
+{
+  const float distance = anari::math::length(pose.center - pose.eye);
+  const float3 forward = (pose.center - pose.eye) / std::max(distance, 1e-6f);
+  const float3 right = anari::math::normalize(anari::math::cross(forward, pose.up));
+  const float3 up = anari::math::cross(right, forward);
+  const float3 back = forward * -1.f;
+
+  CameraKey result = pose;
+  const float3 rv = right * r[0] + up * r[1] + back * r[2];
+  const float angle = anari::math::length(rv);
+  if (angle > 0.f) {
+    const float3 axis = rv / angle;
+    const float radians = angle * float(M_PI) / 180.f;
+    result.eye = pose.center + rotate(pose.eye - pose.center, axis, radians);
+    result.up = rotate(pose.up, axis, radians);
+  }
+  const float3 d = (right * t[0] + up * t[1] + back * t[2]) * distance;
+  result.eye = result.eye + d;
+  result.center = result.center + d;
+  return result;
+}
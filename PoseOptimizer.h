@@ -0,0 +1,168 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+// ours
+#include "CameraPath.h" // CameraKey, rotate
+#include "CpuDrrRenderer.h"
+#include "Image.h"
+#include "SimilarityMetrics.h"
+
+// Intensity-based 2D/3D registration without an estimator plugin: searches
+// the six pose parameters (translation of eye and center, rotation about the
+// center, both in camera axes) for the DRR most similar to the reference
+// image. Every iteration renders its candidate poses at once, each job on
+// its own CPU frame; the search runs on a worker thread. With several
+// levels, the search runs coarse to fine: at 1/2^level of the evaluation
+// width against the reference downsampled to match, each level starting at
+// the previous level's best pose with half its search radius.
+class PoseOptimizer
+{
+ public:
+  enum class Method
+  {
+    // separable CMA-ES (Ros and Hansen 2008): one population per iteration
+    CMA_ES,
+    // reflection, expansion and both contractions evaluated together
+    NELDER_MEAD,
+  };
+
+  struct Settings
+  {
+    Method method{Method::CMA_ES};
+    Metric metric{Metric::NCC};
+    // evaluation resolution of the finest level, the height follows the
+    // aspect ratio
+    int width{256};
+    // pyramid levels, the coarsest at least 16 pixels wide
+    int levels{1};
+    // per level
+    int maxIterations{60};
+    // CMA-ES candidates per iteration, 0: 4 + 3 ln(6)
+    int population{0};
+    // initial search radius: eye movement relative to the viewing distance
+    // and rotation in degrees
+    float translationStep{.02f};
+    float rotationStep{2.f};
+    // stop once the search radius shrank to this fraction of the initial one
+    // (at the finest level, twice that per coarser level)
+    float minStep{.02f};
+    // candidates rendered concurrently, 0: hardware concurrency
+    unsigned jobs{0};
+  };
+
+  struct Iteration
+  {
+    int level; // 0: finest
+    int index; // within the level
+    float bestCost; // metricCost() of the best pose so far
+    int evaluations; // in total
+    float seconds; // since start
+  };
+
+  struct Level
+  {
+    int level;
+    int width;
+    int height;
+    int iterations;
+    int evaluations;
+    float seconds;
+    float startCost; // of the level's start pose
+    float cost; // best
+  };
+
+  enum class StopReason
+  {
+    NONE,
+    CONVERGED,
+    MAX_ITERATIONS,
+    CANCELLED,
+    FAILED,
+  };
+
+  PoseOptimizer() = default;
+  ~PoseOptimizer();
+
+  PoseOptimizer(const PoseOptimizer &) = delete;
+  PoseOptimizer &operator=(const PoseOptimizer &) = delete;
+
+  // false if still busy or there's nothing to compare against; the renderer
+  // is copied (it must keep its field alive until the run is done)
+  bool start(const CpuDrrRenderer &renderer,
+      std::shared_ptr<const Image> reference,
+      const CameraKey &pose,
+      float fovy,
+      float aspect,
+      const Settings &settings);
+  void cancel();
+
+  bool busy() const;
+  float elapsedSeconds() const;
+  std::vector<Iteration> iterations() const;
+  // finished levels, coarsest first
+  std::vector<Level> levels() const;
+  StopReason stopReason() const;
+  // the best pose once after a run that wasn't cancelled
+  bool takeResult(CameraKey &pose, float &cost);
+
+ private:
+  using Params = std::array<float, 6>;
+
+  // m_start moved by x (in units of the level's initial steps)
+  CameraKey poseAt(const Params &x) const;
+  void run();
+  // costs of the candidates, rendered by up to m_settings.jobs threads
+  std::vector<float> evaluate(const std::vector<Params> &candidates);
+  bool iterationDone(float bestCost, float step, int &iteration);
+  void runCmaEs();
+  // startCost: the cost of the start pose, the initial simplex's first vertex
+  void runNelderMead(float startCost);
+
+  Settings m_settings;
+  CpuDrrRenderer m_renderer;
+  CameraKey m_start;
+  float m_fovy{0.f};
+  float m_aspect{1.f};
+  std::shared_ptr<const Image> m_reference;
+  // current level
+  int m_level{0};
+  int m_width{0};
+  int m_height{0};
+  float m_scale{1.f};
+  MetricImage m_fixed;
+  // one per job, reused across iterations
+  std::vector<CpuDrrFrame> m_frames;
+
+  Params m_best{};
+  float m_bestCost{0.f};
+  int m_evaluations{0};
+
+  std::thread m_thread;
+  std::atomic<bool> m_busy{false};
+  std::atomic<bool> m_cancel{false};
+  mutable std::mutex m_mutex;
+  std::vector<Iteration> m_iterations;
+  std::vector<Level> m_levels;
+  StopReason m_stopReason{StopReason::NONE};
+  bool m_hasResult{false};
+  std::chrono::steady_clock::time_point m_startTime;
+  float m_seconds{0.f};
+};
+
+const char *toString(PoseOptimizer::Method method);
+const char *toString(PoseOptimizer::StopReason reason);
+
+// pose moved by t (translation of eye and center along the camera's right,
+// up and backward axes, relative to the viewing distance) and rotated by the
+// rotation vector r (degrees, same axes) about the center
+CameraKey offsetPose(const CameraKey &pose, const float t[3], const float r[3]);
@@ -4,7 +4,10 @@
 #include "PredictionsEditor.h"
 // std
 #include <algorithm>
+#include <cfloat>
 #include <cmath>
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
 #include <stdexcept>
 
@@ -23,6 +26,12 @@ PredictionsEditor::PredictionsEditor(
       [](const std::string &s) { return s.c_str(); });
 }
 
+PredictionsEditor::~PredictionsEditor()
+{
+  for (auto &[index, t] : m_thumbnailTextures)
+    glDeleteTextures(1, &t.texture);
+}
+
 void PredictionsEditor::buildUI()
 {
   if (ImGui::Button("reset view"))
@@ -37,27 +46,18 @@ void PredictionsEditor::buildUI()
     if (ImGui::Button("export predictions"))
       triggerExportPredictionsCallback();
 
+    ImGui::SameLine();
+    if (ImGui::Button("camera path from predictions"))
+      triggerCameraPathFromPredictionsCallback();
+
+    if (ImGui::Button("jump to nearest"))
+      triggerJumpToNearestCallback();
+    if (ImGui::IsItemHovered())
+      ImGui::SetTooltip("select the prediction whose initial or refined camera is closest to the current view");
+
     ImGui::Separator();
 
-    ImGui::Text("Select image:");
-    if (ImGui::BeginTable("Images", numPredictions))
-    {
-      ImGui::PushStyleVar(ImGuiStyleVar_SelectableTextAlign, ImVec2(0.5f, 0.5f));
-      for (size_t i=0; i<numPredictions; ++i)
-      {
-        ImGui::TableNextColumn();
-        std::string itemid = std::to_string(i+1);
-        if (ImGui::Selectable(itemid.c_str(), i == m_selectedImage))
-        {
-          m_selectedImage = i;
-          m_filename = m_predictions->predictions[m_selectedImage].filename;
-          triggerShowImageCallback(m_selectedImage);
-          triggerLoadReferenceImageCallback(m_selectedImage);
-        }
-      }
-      ImGui::PopStyleVar();
-      ImGui::EndTable();
-    }
+    buildImageList();
     if (!m_filename.empty())
       ImGui::Text("%s", m_filename.c_str());
 
@@ -71,8 +71,9 @@ void PredictionsEditor::buildUI()
             m_predictions->predictions[m_selectedImage].initial_camera.up);
       }
 
-      if (ImGui::Button("Save current camera"))
+      if (ImGui::Button("Save current camera")) {
         triggerSaveCameraCallback(m_selectedImage);
+      }
 
       if (m_predictions->predictions[m_selectedImage].refined_camera.initialized)
       {
@@ -110,18 +111,543 @@ void PredictionsEditor::buildUI()
     triggerLoadFramebufferAsReferenceImageCallback();
   }
 
-  if (ImGui::Button("Match")) {
-    triggerMatchCallback();
+  if (m_matchJob && m_matchJob->busy()) {
+    char overlay[64];
+    snprintf(overlay,
+        sizeof(overlay),
+        "%s (%.1fs)",
+        m_matchJob->cancelRequested() ? "cancelling" : m_matchJob->stageName(),
+        m_matchJob->elapsedSeconds());
+    ImGui::ProgressBar(m_matchJob->progress(), ImVec2(-1.f, 0.f), overlay);
+    ImGui::BeginDisabled(m_matchJob->cancelRequested());
+    if (ImGui::Button("Cancel match"))
+      m_matchJob->cancel();
+    ImGui::EndDisabled();
+  } else {
+    // a running race is shown (and cancelled) by buildMatchRaceUI();
+    // auto-refine submits its own matches, also between them while rendering
+    ImGui::BeginDisabled((m_matchRace && m_matchRace->busy())
+        || (m_autoRefine
+            && m_autoRefine->phase() != AutoRefine::Phase::IDLE));
+    if (ImGui::Button("Match")) {
+      if (m_raceSettings.enabled)
+        triggerRaceMatchCallback();
+      else
+        triggerMatchCallback();
+    }
+    ImGui::EndDisabled();
   }
 
+  if (m_matchRace && m_estimatorNames.size() > 1)
+    buildMatchRaceUI();
+
   if (ImGui::SliderFloat("Match Threshold", &m_matchThreshold, 0.f, 100.f)) {
     triggerSetMatchThresholdCallback(m_matchThreshold);
   }
 
+  if (m_poseOptimizer)
+    buildPoseOptimizerUI();
+
+  if (m_selectedImage < numPredictions)
+    buildAutoRefineUI();
+
   ImGui::Separator();
   ImGui::Text("Select pixel: Shift + LMB");
 }
 
+void PredictionsEditor::buildImageList()
+{
+  const auto &predictions = m_predictions->predictions;
+  if (!m_thumbnails || m_thumbnails->size() != predictions.size()) {
+    std::vector<std::string> filenames;
+    for (const auto &p : predictions)
+      filenames.push_back(p.filename);
+    for (auto &[index, t] : m_thumbnailTextures)
+      glDeleteTextures(1, &t.texture);
+    m_thumbnailTextures.clear();
+    m_thumbnails = std::make_unique<ThumbnailCache>(
+        std::move(filenames), unsigned(m_thumbnailSize * 2));
+  }
+  // refined cameras change the refined filter and sort order
+  if (m_rowsPredictions != predictions.size()
+      || m_rowsRevision != m_predictions->revision)
+    m_rowsDirty = true;
+  ++m_frameCounter;
+
+  ImGui::Text("Select image:");
+  if (m_filter.Draw("filter", ImGui::GetFontSize() * 12))
+    m_rowsDirty = true;
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(ImGui::GetFontSize() * 7);
+  if (ImGui::Combo("##refined", &m_refinedFilter, "all\0refined\0not refined\0"))
+    m_rowsDirty = true;
+
+  const ImGuiTableFlags flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg
+      | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersV
+      | ImGuiTableFlags_Resizable | ImGuiTableFlags_Sortable;
+  const float rowHeight =
+      m_thumbnailSize + ImGui::GetStyle().CellPadding.y * 2.f;
+  const ImVec2 outerSize(0.f, rowHeight * 6.5f);
+  if (ImGui::BeginTable("Images", 4, flags, outerSize)) {
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("#",
+        ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_WidthFixed,
+        0.f,
+        SORT_INDEX);
+    ImGui::TableSetupColumn("image",
+        ImGuiTableColumnFlags_NoSort | ImGuiTableColumnFlags_WidthFixed,
+        m_thumbnailSize,
+        SORT_THUMBNAIL);
+    ImGui::TableSetupColumn(
+        "file", ImGuiTableColumnFlags_WidthStretch, 0.f, SORT_FILENAME);
+    ImGui::TableSetupColumn(
+        "refined", ImGuiTableColumnFlags_WidthFixed, 0.f, SORT_REFINED);
+    ImGui::TableHeadersRow();
+
+    if (auto *specs = ImGui::TableGetSortSpecs(); specs && specs->SpecsDirty) {
+      if (specs->SpecsCount > 0) {
+        m_sortColumn = int(specs->Specs[0].ColumnUserID);
+        m_sortAscending =
+            specs->Specs[0].SortDirection == ImGuiSortDirection_Ascending;
+      }
+      specs->SpecsDirty = false;
+      m_rowsDirty = true;
+    }
+    if (m_rowsDirty)
+      rebuildRows();
+
+    // only the visible rows are laid out
+    int uploadsLeft = m_maxUploadsPerFrame;
+    ImGuiListClipper clipper;
+    clipper.Begin(int(m_rows.size()), rowHeight);
+    while (clipper.Step()) {
+      for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+        const size_t i = m_rows[row];
+        const auto &p = predictions[i];
+        ImGui::TableNextRow(ImGuiTableRowFlags_None, rowHeight);
+        ImGui::PushID(int(i));
+
+        ImGui::TableNextColumn();
+        std::string itemid = std::to_string(i + 1);
+        if (ImGui::Selectable(itemid.c_str(),
+                i == m_selectedImage,
+                ImGuiSelectableFlags_SpanAllColumns
+                    | ImGuiSelectableFlags_AllowOverlap,
+                ImVec2(0.f, m_thumbnailSize)))
+          selectImage(i);
+
+        ImGui::TableNextColumn();
+        if (auto *t = thumbnail(i, uploadsLeft)) {
+          // fit into a square cell, images are stored bottom to top
+          float s = m_thumbnailSize / std::max(t->width, t->height);
+          ImGui::Image((void *)(intptr_t)t->texture,
+              ImVec2(t->width * s, t->height * s),
+              ImVec2(0, 1),
+              ImVec2(1, 0));
+        } else if (m_thumbnails->failed(i))
+          ImGui::TextDisabled("n/a");
+
+        ImGui::TableNextColumn();
+        std::string name =
+            std::filesystem::path(p.filename).filename().string();
+        ImGui::TextUnformatted(name.c_str());
+        if (ImGui::IsItemHovered())
+          ImGui::SetTooltip("%s", p.filename.c_str());
+
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(p.refined_camera.initialized ? "yes" : "-");
+
+        ImGui::PopID();
+      }
+    }
+    ImGui::EndTable();
+  }
+  ImGui::Text("%zu of %zu images", m_rows.size(), predictions.size());
+
+  evictThumbnails();
+}
+
+void PredictionsEditor::buildAutoRefineUI()
+{
+  const bool running =
+      m_autoRefine && m_autoRefine->phase() != AutoRefine::Phase::IDLE;
+  if (running) {
+    const auto &iterations = m_autoRefine->iterations();
+    ImGui::Text("auto-refine image %zu: iteration %zu/%i (%s)",
+        m_autoRefine->prediction() + 1,
+        iterations.size() + 1,
+        m_autoRefine->settings().maxIterations,
+        m_autoRefine->phase() == AutoRefine::Phase::RENDERING ? "rendering"
+                                                              : "matching");
+    if (!iterations.empty()) {
+      const auto &it = iterations.back();
+      ImGui::Text("last: translation %.2e, rotation %.3f deg, residual %.4f",
+          it.translation,
+          it.rotation,
+          it.residual);
+    }
+    ImGui::BeginDisabled(m_autoRefine->stopRequested());
+    if (ImGui::Button("Stop auto-refine"))
+      m_autoRefine->requestStop();
+    ImGui::EndDisabled();
+    return;
+  }
+
+  ImGui::BeginDisabled((m_matchJob && m_matchJob->busy())
+      || (m_matchRace && m_matchRace->busy()));
+  if (ImGui::Button("Auto-refine"))
+    triggerAutoRefineCallback(m_selectedImage);
+  ImGui::EndDisabled();
+  if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+    ImGui::SetTooltip(
+        "render, match and update until the pose converges; the result is "
+        "saved as refined camera");
+  }
+
+  if (m_autoRefine
+      && m_autoRefine->stopReason() != AutoRefine::StopReason::NONE) {
+    ImGui::SameLine();
+    ImGui::Text("last run: %s, %zu iteration(s)",
+        toString(m_autoRefine->stopReason()),
+        m_autoRefine->iterations().size());
+  }
+
+  if (ImGui::TreeNode("auto-refine settings")) {
+    auto &s = m_autoRefineSettings;
+    ImGui::DragFloat("translation tolerance",
+        &s.translationTolerance,
+        1e-4f,
+        0.f,
+        1.f,
+        "%.1e");
+    if (ImGui::IsItemHovered())
+      ImGui::SetTooltip("eye movement relative to the viewing distance");
+    ImGui::DragFloat(
+        "rotation tolerance (deg)", &s.rotationTolerance, .01f, 0.f, 10.f);
+    ImGui::SliderInt("max iterations", &s.maxIterations, 1, 100);
+    ImGui::SliderInt("patience", &s.patience, 1, 10);
+    if (ImGui::IsItemHovered()) {
+      ImGui::SetTooltip(
+          "stop after this many iterations without residual improvement");
+    }
+    ImGui::TreePop();
+  }
+}
+
+void PredictionsEditor::buildMatchRaceUI()
+{
+  auto &s = m_raceSettings;
+  ImGui::Checkbox("race all estimators", &s.enabled);
+  if (ImGui::IsItemHovered()) {
+    ImGui::SetTooltip(
+        "match with every estimator in parallel and apply the proposal whose "
+        "re-rendered image fits the reference best");
+  }
+  if (s.enabled) {
+    ImGui::Checkbox("cancel stragglers", &s.cancelStragglers);
+    ImGui::BeginDisabled(!s.cancelStragglers);
+    ImGui::DragFloat("good enough score", &s.goodEnough, .005f, 0.f, 2.f);
+    ImGui::EndDisabled();
+    if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+      ImGui::SetTooltip(
+          "the first proposal scoring at most this (1 - NCC) wins, the "
+          "remaining estimators are cancelled");
+    }
+  }
+
+  const auto entries = m_matchRace->entries();
+  if (entries.empty())
+    return;
+
+  const bool decided = m_matchRace->decided();
+  if (!decided) {
+    ImGui::Text("race: %.1fs", m_matchRace->elapsedSeconds());
+    ImGui::SameLine();
+    if (ImGui::Button("Cancel race"))
+      m_matchRace->cancel();
+  }
+
+  const size_t winner = m_matchRace->winner();
+  if (ImGui::BeginTable("race", 4, ImGuiTableFlags_Borders)) {
+    ImGui::TableSetupColumn("estimator");
+    ImGui::TableSetupColumn("state");
+    ImGui::TableSetupColumn("latency");
+    ImGui::TableSetupColumn("score");
+    ImGui::TableHeadersRow();
+    for (size_t i = 0; i < entries.size(); ++i) {
+      const auto &e = entries[i];
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::Text("%s%s", e.name.c_str(), i == winner ? " (best)" : "");
+      ImGui::TableNextColumn();
+      if (e.state == MatchRace::State::RUNNING)
+        ImGui::Text("%s", toString(e.stage));
+      else if (e.state == MatchRace::State::CANCELLED)
+        ImGui::Text("%s", e.stage == MatchStage::DONE ? "cancelled" : "cancelling");
+      else
+        ImGui::Text("done");
+      ImGui::TableNextColumn();
+      ImGui::Text("%.2fs", e.seconds);
+      ImGui::TableNextColumn();
+      if (std::isfinite(e.score))
+        ImGui::Text("%.4f", e.score);
+      else
+        ImGui::Text("-");
+    }
+    ImGui::EndTable();
+  }
+}
+
+void PredictionsEditor::buildPoseOptimizerUI()
+{
+  const auto iterations = m_poseOptimizer->iterations();
+  if (m_poseOptimizer->busy()) {
+    const int level = iterations.empty() ? 0 : iterations.back().level;
+    ImGui::Text("optimizing pose: level %i, iteration %i/%i, %.1fs",
+        level,
+        iterations.empty() ? 0 : iterations.back().index,
+        m_poseOptimizerSettings.maxIterations,
+        m_poseOptimizer->elapsedSeconds());
+    ImGui::SameLine();
+    if (ImGui::Button("Cancel optimizer"))
+      m_poseOptimizer->cancel();
+  } else {
+    ImGui::BeginDisabled(m_autoRefine
+        && m_autoRefine->phase() != AutoRefine::Phase::IDLE);
+    if (ImGui::Button("Optimize pose"))
+      triggerOptimizePoseCallback();
+    ImGui::EndDisabled();
+    if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+      ImGui::SetTooltip(
+          "search the pose whose DRR is most similar to the reference image, "
+          "without an estimator");
+    }
+    if (!iterations.empty()) {
+      ImGui::SameLine();
+      ImGui::Text("last run: %s, %zu iteration(s), %.1fs",
+          toString(m_poseOptimizer->stopReason()),
+          iterations.size(),
+          m_poseOptimizer->elapsedSeconds());
+    }
+  }
+
+  if (!iterations.empty()) {
+    std::vector<float> curve(iterations.size());
+    for (size_t i = 0; i < iterations.size(); ++i)
+      curve[i] = iterations[i].bestCost;
+    char overlay[64];
+    snprintf(overlay,
+        sizeof(overlay),
+        "cost %.4f, %i evaluations",
+        curve.back(),
+        iterations.back().evaluations);
+    ImGui::PlotLines("convergence",
+        curve.data(),
+        int(curve.size()),
+        0,
+        overlay,
+        FLT_MAX,
+        FLT_MAX,
+        ImVec2(0.f, 60.f));
+  }
+
+  const auto levels = m_poseOptimizer->levels();
+  if (levels.size() > 1
+      && ImGui::BeginTable("levels", 5, ImGuiTableFlags_Borders)) {
+    ImGui::TableSetupColumn("level");
+    ImGui::TableSetupColumn("iterations");
+    ImGui::TableSetupColumn("evaluations");
+    ImGui::TableSetupColumn("time");
+    ImGui::TableSetupColumn("cost");
+    ImGui::TableHeadersRow();
+    for (const auto &l : levels) {
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::Text("%ix%i", l.width, l.height);
+      ImGui::TableNextColumn();
+      ImGui::Text("%i", l.iterations);
+      ImGui::TableNextColumn();
+      ImGui::Text("%i", l.evaluations);
+      ImGui::TableNextColumn();
+      ImGui::Text("%.2fs", l.seconds);
+      ImGui::TableNextColumn();
+      // nothing was rendered if cancelled early
+      if (l.cost < FLT_MAX)
+        ImGui::Text("%.4f -> %.4f", l.startCost, l.cost);
+      else
+        ImGui::Text("-");
+    }
+    ImGui::EndTable();
+  }
+
+  if (ImGui::TreeNode("pose optimizer settings")) {
+    auto &s = m_poseOptimizerSettings;
+    const char *methods[] = {toString(PoseOptimizer::Method::CMA_ES),
+        toString(PoseOptimizer::Method::NELDER_MEAD)};
+    int method = int(s.method);
+    if (ImGui::Combo("method", &method, methods, IM_ARRAYSIZE(methods)))
+      s.method = PoseOptimizer::Method(method);
+    const char *metrics[NUM_METRICS];
+    for (int i = 0; i < NUM_METRICS; ++i)
+      metrics[i] = toString(Metric(i));
+    int metric = int(s.metric);
+    if (ImGui::Combo("metric", &metric, metrics, NUM_METRICS))
+      s.metric = Metric(metric);
+    ImGui::SliderInt("evaluation width", &s.width, 64, 1024);
+    ImGui::SliderInt("pyramid levels", &s.levels, 1, 4);
+    if (ImGui::IsItemHovered()) {
+      ImGui::SetTooltip(
+          "search at 1/8, 1/4 and 1/2 of the evaluation width first");
+    }
+    ImGui::SliderInt("max iterations per level", &s.maxIterations, 1, 500);
+    if (s.method == PoseOptimizer::Method::CMA_ES) {
+      ImGui::SliderInt("population", &s.population, 0, 64);
+      if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("candidates rendered per iteration, 0: automatic");
+    }
+    ImGui::DragFloat("translation step",
+        &s.translationStep,
+        1e-3f,
+        1e-4f,
+        1.f,
+        "%.3f");
+    if (ImGui::IsItemHovered())
+      ImGui::SetTooltip("initial search radius relative to the viewing distance");
+    ImGui::DragFloat("rotation step (deg)", &s.rotationStep, .1f, .01f, 45.f);
+    ImGui::TreePop();
+  }
+}
+
+void PredictionsEditor::rebuildRows()
+{
+  const auto &predictions = m_predictions->predictions;
+  m_rows.clear();
+  for (size_t i = 0; i < predictions.size(); ++i) {
+    const auto &p = predictions[i];
+    const bool refined = p.refined_camera.initialized;
+    if ((m_refinedFilter == 1 && !refined) || (m_refinedFilter == 2 && refined))
+      continue;
+    if (!m_filter.PassFilter(p.filename.c_str()))
+      continue;
+    m_rows.push_back(i);
+  }
+
+  auto less = [&](size_t a, size_t b) {
+    const auto &pa = predictions[a];
+    const auto &pb = predictions[b];
+    if (m_sortColumn == SORT_FILENAME && pa.filename != pb.filename)
+      return pa.filename < pb.filename;
+    if (m_sortColumn == SORT_REFINED
+        && pa.refined_camera.initialized != pb.refined_camera.initialized)
+      return pa.refined_camera.initialized < pb.refined_camera.initialized;
+    return a < b;
+  };
+  if (m_sortAscending)
+    std::stable_sort(m_rows.begin(), m_rows.end(), less);
+  else
+    std::stable_sort(m_rows.begin(), m_rows.end(),
+        [&](size_t a, size_t b) { return less(b, a); });
+
+  m_rowsPredictions = predictions.size();
+  m_rowsRevision = m_predictions->revision;
+  m_rowsDirty = false;
+}
+
+void PredictionsEditor::selectImage(size_t index)
+{
+  m_selectedImage = index;
+  m_filename = m_predictions->predictions[m_selectedImage].filename;
+  triggerShowImageCallback(m_selectedImage);
+  triggerLoadReferenceImageCallback(m_selectedImage);
+}
+
+const PredictionsEditor::ThumbnailTexture *PredictionsEditor::thumbnail(
+    size_t index, int &uploadsLeft)
+{
+  auto it = m_thumbnailTextures.find(index);
+  if (it != m_thumbnailTextures.end()) {
+    it->second.lastUse = m_frameCounter;
+    return &it->second;
+  }
+
+  if (uploadsLeft <= 0)
+    return nullptr;
+  auto image = m_thumbnails->tryGet(index);
+  if (!image) {
+    m_thumbnails->request(index);
+    return nullptr;
+  }
+  --uploadsLeft;
+
+  ThumbnailTexture t;
+  t.width = image->width;
+  t.height = image->height;
+  t.lastUse = m_frameCounter;
+  glGenTextures(1, &t.texture);
+  glBindTexture(GL_TEXTURE_2D, t.texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  const bool gray = image->type == Image::PixelType::R8;
+  if (gray) {
+    GLint swizzle[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+  }
+  GLint alignment;
+  glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D,
+      0,
+      gray ? GL_R8 : GL_RGB8,
+      image->width,
+      image->height,
+      0,
+      gray ? GL_RED : GL_RGB,
+      GL_UNSIGNED_BYTE,
+      image->data.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+  return &(m_thumbnailTextures[index] = t);
+}
+
+void PredictionsEditor::evictThumbnails()
+{
+  // textures drawn this frame stay
+  while (m_thumbnailTextures.size() > m_maxThumbnailTextures) {
+    auto lru = m_thumbnailTextures.begin();
+    for (auto it = m_thumbnailTextures.begin(); it != m_thumbnailTextures.end();
+         ++it) {
+      if (it->second.lastUse < lru->second.lastUse)
+        lru = it;
+    }
+    if (lru->second.lastUse == m_frameCounter)
+      break;
+    glDeleteTextures(1, &lru->second.texture);
+    m_thumbnailTextures.erase(lru);
+  }
+}
+
+void PredictionsEditor::setMatchJob(MatchJob *job)
+{
+  m_matchJob = job;
+}
+
+void PredictionsEditor::setAutoRefine(AutoRefine *autoRefine)
+{
+  m_autoRefine = autoRefine;
+}
+
+void PredictionsEditor::setMatchRace(MatchRace *race)
+{
+  m_matchRace = race;
+}
+
+void PredictionsEditor::setPoseOptimizer(PoseOptimizer *optimizer)
+{
+  m_poseOptimizer = optimizer;
+}
+
 void PredictionsEditor::setUpdateCameraCallback(UpdateCameraCallback cb)
 {
   m_updateCameraCallback = cb;
@@ -177,6 +703,31 @@ void PredictionsEditor::setSetMatchThresholdCallback(SetMatchThresholdCallback c
   m_setMatchThresholdCallback = cb;
 }
 
+void PredictionsEditor::setCameraPathFromPredictionsCallback(CameraPathFromPredictionsCallback cb)
+{
+  m_cameraPathFromPredictionsCallback = cb;
+}
+
+void PredictionsEditor::setJumpToNearestCallback(JumpToNearestCallback cb)
+{
+  m_jumpToNearestCallback = cb;
+}
+
+void PredictionsEditor::setAutoRefineCallback(AutoRefineCallback cb)
+{
+  m_autoRefineCallback = cb;
+}
+
+void PredictionsEditor::setRaceMatchCallback(RaceMatchCallback cb)
+{
+  m_raceMatchCallback = cb;
+}
+
+void PredictionsEditor::setOptimizePoseCallback(OptimizePoseCallback cb)
+{
+  m_optimizePoseCallback = cb;
+}
+
 void PredictionsEditor::triggerResetCameraCallback()
 {
   if (m_resetCameraCallback)
@@ -246,4 +797,34 @@ void PredictionsEditor::triggerSetMatchThresholdCallback(float threshold)
     m_setMatchThresholdCallback(threshold);
 }
 
+void PredictionsEditor::triggerCameraPathFromPredictionsCallback()
+{
+  if (m_cameraPathFromPredictionsCallback)
+    m_cameraPathFromPredictionsCallback();
+}
+
+void PredictionsEditor::triggerJumpToNearestCallback()
+{
+  if (m_jumpToNearestCallback)
+    m_jumpToNearestCallback();
+}
+
+void PredictionsEditor::triggerAutoRefineCallback(size_t index)
+{
+  if (m_autoRefineCallback)
+    m_autoRefineCallback(index, m_autoRefineSettings);
+}
+
+void PredictionsEditor::triggerRaceMatchCallback()
+{
+  if (m_raceMatchCallback)
+    m_raceMatchCallback(m_raceSettings);
+}
+
+void PredictionsEditor::triggerOptimizePoseCallback()
+{
+  if (m_optimizePoseCallback)
+    m_optimizePoseCallback(m_poseOptimizerSettings);
+}
+
 } // namespace anari_viewer::windows
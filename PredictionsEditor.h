@@ -3,15 +3,24 @@
 
 #pragma once
 
+// glad
+#include "glad/glad.h"
 // std
 #include <functional>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 // anari
 #include "anari/anari_cpp/ext/linalg.h" // math::float3
 
 // ours
+#include "AutoRefine.h"
+#include "MatchJob.h"
+#include "MatchRace.h"
+#include "PoseOptimizer.h"
 #include "prediction.h"
+#include "ThumbnailCache.h"
 #include "Window.h"
 
 namespace anari_viewer::windows {
@@ -30,6 +39,13 @@ using ExportScreenshotCallback = std::function<void(void)>;
 using SaveCameraCallback = std::function<void(size_t)>;
 using ExportPredictionsCallback = std::function<void(void)>;
 using SetMatchThresholdCallback = std::function<void(float)>;
+using CameraPathFromPredictionsCallback = std::function<void(void)>;
+using JumpToNearestCallback = std::function<void(void)>;
+using AutoRefineCallback =
+    std::function<void(size_t, const AutoRefine::Settings&)>;
+using RaceMatchCallback = std::function<void(const MatchRace::Settings&)>;
+using OptimizePoseCallback =
+    std::function<void(const PoseOptimizer::Settings&)>;
 
 class PredictionsEditor : public anari_viewer::windows::Window
 {
@@ -38,10 +54,21 @@ class PredictionsEditor : public anari_viewer::windows::Window
         const prediction_container& predictions,
         std::vector<std::string> estimatorNames,
         const char *name = "Predictions Editor");
-  ~PredictionsEditor() = default;
+  ~PredictionsEditor();
 
   void buildUI() override;
 
+  // select an image as if clicked in the list
+  void selectImage(size_t index);
+  // running matches are shown with progress and can be cancelled
+  void setMatchJob(MatchJob *job);
+  // the auto-refine loop's progress is shown and it can be stopped
+  void setAutoRefine(AutoRefine *autoRefine);
+  // per-estimator latency and score of races, stragglers can be cancelled
+  void setMatchRace(MatchRace *race);
+  // the intensity-based optimizer's convergence curve, it can be cancelled
+  void setPoseOptimizer(PoseOptimizer *optimizer);
+
   void setUpdateCameraCallback(UpdateCameraCallback cb);
   void setResetCameraCallback(ResetCameraCallback cb);
   void setShowImageCallback(ShowImageCallback cb);
@@ -53,6 +80,11 @@ class PredictionsEditor : public anari_viewer::windows::Window
   void setSaveCameraCallback(SaveCameraCallback cb);
   void setExportPredictionsCallback(ExportPredictionsCallback cb);
   void setSetMatchThresholdCallback(SetMatchThresholdCallback cb);
+  void setCameraPathFromPredictionsCallback(CameraPathFromPredictionsCallback cb);
+  void setJumpToNearestCallback(JumpToNearestCallback cb);
+  void setAutoRefineCallback(AutoRefineCallback cb);
+  void setRaceMatchCallback(RaceMatchCallback cb);
+  void setOptimizePoseCallback(OptimizePoseCallback cb);
   void triggerUpdateCameraCallback(
       const anari::math::float3& eye,
       const anari::math::float3& center,
@@ -67,8 +99,39 @@ class PredictionsEditor : public anari_viewer::windows::Window
   void triggerSaveCameraCallback(size_t index);
   void triggerExportPredictionsCallback();
   void triggerSetMatchThresholdCallback(float threshold);
+  void triggerCameraPathFromPredictionsCallback();
+  void triggerJumpToNearestCallback();
+  void triggerAutoRefineCallback(size_t index);
+  void triggerRaceMatchCallback();
+  void triggerOptimizePoseCallback();
 
  private:
+  struct ThumbnailTexture
+  {
+    GLuint texture{0};
+    size_t width{0};
+    size_t height{0};
+    uint64_t lastUse{0};
+  };
+
+  enum SortColumn
+  {
+    SORT_INDEX,
+    SORT_THUMBNAIL,
+    SORT_FILENAME,
+    SORT_REFINED,
+  };
+
+  void buildImageList();
+  void rebuildRows();
+  void buildAutoRefineUI();
+  void buildMatchRaceUI();
+  void buildPoseOptimizerUI();
+  // texture of the thumbnail, nullptr while it is being generated or if the
+  // upload budget of this frame is used up
+  const ThumbnailTexture *thumbnail(size_t index, int &uploadsLeft);
+  void evictThumbnails();
+
   // callback called whenever new camera selected
   UpdateCameraCallback m_updateCameraCallback;
   // callback called whenever reset camera selected
@@ -84,13 +147,48 @@ class PredictionsEditor : public anari_viewer::windows::Window
   SaveCameraCallback m_saveCameraCallback;
   ExportPredictionsCallback m_exportPredictionsCallback;
   SetMatchThresholdCallback m_setMatchThresholdCallback;
+  // callback called to build a viewport camera path through the predictions
+  CameraPathFromPredictionsCallback m_cameraPathFromPredictionsCallback;
+  // callback called to select the prediction closest to the viewport camera
+  JumpToNearestCallback m_jumpToNearestCallback;
+  // callback called to start the render/match loop for an image
+  AutoRefineCallback m_autoRefineCallback;
+  // callback called instead of m_matchCallback to match with all estimators
+  RaceMatchCallback m_raceMatchCallback;
+  // callback called to optimize the viewport pose against the reference
+  OptimizePoseCallback m_optimizePoseCallback;
 
   const prediction_container* m_predictions;
+  MatchJob* m_matchJob{nullptr};
+  AutoRefine* m_autoRefine{nullptr};
+  AutoRefine::Settings m_autoRefineSettings;
+  MatchRace* m_matchRace{nullptr};
+  MatchRace::Settings m_raceSettings;
+  PoseOptimizer* m_poseOptimizer{nullptr};
+  PoseOptimizer::Settings m_poseOptimizerSettings;
   size_t m_estimatorIndex;
   std::vector<std::string> m_estimatorNamesStr;
   std::vector<const char*> m_estimatorNames;
   size_t m_selectedImage{static_cast<size_t>(-1)};
   std::string m_filename;
+
+  // image list: indices of the predictions passing the filter, in sort order;
+  // only rebuilt when the filter, sort order or predictions change
+  std::vector<size_t> m_rows;
+  bool m_rowsDirty{true};
+  size_t m_rowsPredictions{0};
+  uint64_t m_rowsRevision{0};
+  ImGuiTextFilter m_filter;
+  int m_refinedFilter{0}; // all, refined, not refined
+  int m_sortColumn{SORT_INDEX};
+  bool m_sortAscending{true};
+  // thumbnails of the visible rows, a bounded number of uploads per frame
+  std::unique_ptr<ThumbnailCache> m_thumbnails;
+  std::unordered_map<size_t, ThumbnailTexture> m_thumbnailTextures;
+  size_t m_maxThumbnailTextures{256};
+  int m_maxUploadsPerFrame{4};
+  uint64_t m_frameCounter{0};
+  float m_thumbnailSize{48.f};
   float m_matchThreshold{50.f};
 };
 
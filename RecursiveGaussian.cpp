@@ -0,0 +1,122 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#include "RecursiveGaussian.h"
+// std
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr int COLUMN_STRIP = 16; // columns filtered together, row by row
+
+struct Coefficients
+{
+  double B, b1, b2, b3; // b1..b3 already divided by b0
+};
+
+Coefficients computeCoefficients(float sigma)
+{
+  // double precision: for large sigma the poles approach 1 and float
+  // recursions become unstable
+  double s = sigma;
+  double q = s >= 2.5 ? 0.98711 * s - 0.96330
+                      : 3.97156 - 4.14554 * std::sqrt(1.0 - 0.26891 * s);
+  double q2 = q * q, q3 = q2 * q;
+  double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+  double b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+  double b2 = -(1.4281 * q2 + 1.26661 * q3);
+  double b3 = 0.422205 * q3;
+  Coefficients c;
+  c.b1 = b1 / b0;
+  c.b2 = b2 / b0;
+  c.b3 = b3 / b0;
+  c.B = 1.0 - (c.b1 + c.b2 + c.b3);
+  return c;
+}
+
+// Causal and anti-causal pass over n samples with the given stride,
+// boundaries are replicated (steady state for a constant signal)
+void filterLine(float *x, int n, int stride, const Coefficients &c)
+{
+  double w1 = x[0], w2 = x[0], w3 = x[0];
+  for (int i = 0; i < n; ++i) {
+    double w = c.B * x[i * stride] + c.b1 * w1 + c.b2 * w2 + c.b3 * w3;
+    x[i * stride] = w;
+    w3 = w2;
+    w2 = w1;
+    w1 = w;
+  }
+  double y1 = x[(n - 1) * stride], y2 = y1, y3 = y1;
+  for (int i = n - 1; i >= 0; --i) {
+    double y = c.B * x[i * stride] + c.b1 * y1 + c.b2 * y2 + c.b3 * y3;
+    x[i * stride] = y;
+    y3 = y2;
+    y2 = y1;
+    y1 = y;
+  }
+}
+
+// Same as filterLine for COLUMN_STRIP adjacent columns at once; the inner
+// loops run over contiguous memory and vectorize
+void filterColumns(float *image, int width, int height, int x0, int numCols,
+    const Coefficients &c)
+{
+  double w1[COLUMN_STRIP], w2[COLUMN_STRIP], w3[COLUMN_STRIP];
+  for (int k = 0; k < numCols; ++k)
+    w1[k] = w2[k] = w3[k] = image[x0 + k];
+  for (int y = 0; y < height; ++y) {
+    float *row = image + size_t(y) * width + x0;
+    for (int k = 0; k < numCols; ++k) {
+      double w = c.B * row[k] + c.b1 * w1[k] + c.b2 * w2[k] + c.b3 * w3[k];
+      row[k] = w;
+      w3[k] = w2[k];
+      w2[k] = w1[k];
+      w1[k] = w;
+    }
+  }
+  const float *last = image + size_t(height - 1) * width + x0;
+  for (int k = 0; k < numCols; ++k)
+    w1[k] = w2[k] = w3[k] = last[k];
+  for (int y = height - 1; y >= 0; --y) {
+    float *row = image + size_t(y) * width + x0;
+    for (int k = 0; k < numCols; ++k) {
+      double w = c.B * row[k] + c.b1 * w1[k] + c.b2 * w2[k] + c.b3 * w3[k];
+      row[k] = w;
+      w3[k] = w2[k];
+      w2[k] = w1[k];
+      w1[k] = w;
+    }
+  }
+}
+
+} // namespace
+
+void recursiveGaussian(
+    float *image, int width, int height, float sigma, WorkerPool &workers)
+{
+  if (sigma < 0.5f || width <= 0 || height <= 0)
+    return;
+
+  const Coefficients c = computeCoefficients(sigma);
+
+  workers.parallelFor(height, [&](int y) {
+    filterLine(image + size_t(y) * width, width, 1, c);
+  });
+
+  const int numStrips = (width + COLUMN_STRIP - 1) / COLUMN_STRIP;
+  workers.parallelFor(numStrips, [&](int s) {
+    int x0 = s * COLUMN_STRIP;
+    filterColumns(
+        image, width, height, x0, std::min(COLUMN_STRIP, width - x0), c);
+  });
+}
+
+void recursiveGaussian(
+    float *image, int width, int height, float sigma, unsigned numThreads)
+{
+  if (sigma < 0.5f || width <= 0 || height <= 0)
+    return;
+  WorkerPool workers(numThreads);
+  recursiveGaussian(image, width, height, sigma, workers);
+}
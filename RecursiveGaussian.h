@@ -0,0 +1,18 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// ours
+#include "WorkerPool.h"
+
+// Recursive (IIR) Gaussian filter after Young and van Vliet, "Recursive
+// implementation of the Gaussian filter" (Signal Processing 44, 1995). Cost is
+// O(width * height) independent of sigma. Filters in place, rows and column
+// strips are distributed over the workers' threads. Sigma below 0.5 leaves
+// the image unchanged.
+void recursiveGaussian(
+    float *image, int width, int height, float sigma, WorkerPool &workers);
+// Same on numThreads threads started for the call (0: hardware concurrency)
+void recursiveGaussian(
+    float *image, int width, int height, float sigma, unsigned numThreads = 0);
@@ -0,0 +1,326 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Registration.h"
+// std
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+// ours
+#include "Image.h"
+
+void frameForEstimator(const CpuDrrFrame &frame,
+    std::vector<uint8_t> &gray,
+    std::vector<float> &depth3d)
+{
+  const auto &L = frame.lineIntegral;
+  const size_t n = L.size();
+  gray.resize(n);
+  depth3d.resize(n * 3);
+  if (n == 0)
+    return;
+
+  auto [lo, hi] = std::minmax_element(L.begin(), L.end());
+  const float scale = *hi > *lo ? 255.f / (*hi - *lo) : 0.f;
+  for (size_t i = 0; i < n; ++i) {
+    gray[i] = uint8_t((L[i] - *lo) * scale);
+    depth3d[3 * i] = frame.origin[i].x;
+    depth3d[3 * i + 1] = frame.origin[i].y;
+    depth3d[3 * i + 2] = frame.origin[i].z;
+  }
+}
+
+// Reference pixels as handed to set_image: 8 bit types as loaded, high bit
+// depth types narrowed to R8 (the estimator ABI has no such types)
+static void referenceForEstimator(const Image &im,
+    std::vector<uint8_t> &pixels,
+    image_transform_estimator::PIXEL_TYPE &pixelType)
+{
+  switch (im.type) {
+  case Image::PixelType::RGB8:
+    pixelType = image_transform_estimator::PIXEL_TYPE::RGB8;
+    pixels = im.data;
+    break;
+  case Image::PixelType::RGBA8:
+    pixelType = image_transform_estimator::PIXEL_TYPE::RGBA8;
+    pixels = im.data;
+    break;
+  default:
+    pixelType = image_transform_estimator::PIXEL_TYPE::R8;
+    narrowToR8(im, pixels);
+    break;
+  }
+}
+
+namespace {
+
+struct RegistrationItem
+{
+  size_t index;
+  Image image;
+  // at the current pyramid level
+  std::vector<uint8_t> reference;
+  image_transform_estimator::PIXEL_TYPE pixelType;
+  size_t width;
+  size_t height;
+  CameraKey pose;
+  int iterations{0};
+  bool done{false};
+  bool failed{false};
+};
+
+} // namespace
+
+RegistrationStats registerPredictions(prediction_container &predictions,
+    const CpuDrrRenderer &renderer,
+    ImageTransformEstimatorWrapper &estimators,
+    size_t estimatorIndex,
+    const RegistrationSettings &settings)
+{
+  using clock = std::chrono::steady_clock;
+
+  RegistrationStats stats;
+  const size_t count = predictions.predictions.size();
+  stats.latencyMs.assign(count, 0.f);
+  if (estimatorIndex >= estimators.m_estimators.size() || count == 0)
+    return stats;
+
+  unsigned jobs = settings.jobs;
+  if (jobs == 0)
+    jobs = std::max(1u, std::thread::hardware_concurrency() / 2);
+  const size_t batchSize = std::max<size_t>(settings.batchSize, 1);
+  jobs = std::min<unsigned>(jobs, (count + batchSize - 1) / batchSize);
+
+  const int maxIterations = std::max(1, settings.iterations);
+  const float aspect = settings.width / float(settings.height);
+  int numLevels = 1;
+  while (numLevels < settings.levels
+      && (std::min(settings.width, settings.height) >> numLevels) >= 16)
+    ++numLevels;
+  std::vector<RegistrationLevel> pyramid(numLevels);
+  for (int l = 0; l < numLevels; ++l) {
+    pyramid[l].width = settings.width >> (numLevels - 1 - l);
+    pyramid[l].height = settings.height >> (numLevels - 1 - l);
+  }
+  stats.levels = pyramid;
+  std::vector<CameraKey> results(count);
+  std::vector<uint8_t> ok(count, 0);
+  std::atomic<size_t> next{0};
+  std::mutex printMutex;
+
+  auto work = [&]() {
+    CpuDrrFrame frame;
+    std::vector<uint8_t> gray;
+    std::vector<float> depth3d;
+    // contiguous batch buffers
+    std::vector<uint8_t> references, queries;
+    std::vector<float> depths, cameras;
+    std::vector<RegistrationItem *> run;
+    // per worker, added to stats.levels after every chunk
+    std::vector<RegistrationLevel> levels = pyramid;
+
+    for (size_t first = next.fetch_add(batchSize); first < count;
+         first = next.fetch_add(batchSize)) {
+      const auto start = clock::now();
+      const size_t last = std::min(first + batchSize, count);
+
+      std::vector<RegistrationItem> items;
+      for (size_t i = first; i < last; ++i) {
+        const auto &p = predictions.predictions[i];
+        Image image;
+        if (!loadImage(p.filename, image)) {
+          ok[i] = 0;
+          std::lock_guard<std::mutex> l(printMutex);
+          fprintf(stderr,
+              "ERROR: could not load image %zu/%zu: %s\n",
+              i + 1,
+              count,
+              p.filename.c_str());
+          printf("failed %zu/%zu: %s (image not loaded)\n",
+              i + 1,
+              count,
+              p.filename.c_str());
+          continue;
+        }
+        RegistrationItem item;
+        item.index = i;
+        item.image = std::move(image);
+        item.pose = {
+            p.initial_camera.eye, p.initial_camera.center, p.initial_camera.up};
+        items.push_back(std::move(item));
+      }
+
+      for (auto &level : levels) {
+        const auto levelStart = clock::now();
+        const size_t w = level.width, h = level.height;
+        const size_t factor = settings.width / w;
+        for (auto &item : items) {
+          // the estimator is calibrated with the level's size, the field of
+          // view stays
+          referenceForEstimator(
+              factor > 1 ? downsample(item.image, factor) : item.image,
+              item.reference,
+              item.pixelType);
+          item.width = std::max<size_t>(item.image.width / factor, 1);
+          item.height = std::max<size_t>(item.image.height / factor, 1);
+          item.done = item.failed;
+        }
+
+        for (int iteration = 0; iteration < maxIterations; ++iteration) {
+          // pairs still moving, submitted in runs of equally sized references
+          for (size_t i = 0; i < items.size();) {
+            run.clear();
+            for (; i < items.size(); ++i) {
+              auto &item = items[i];
+              if (item.done)
+                continue;
+              if (!run.empty()
+                  && (item.width != run[0]->width
+                      || item.height != run[0]->height
+                      || item.pixelType != run[0]->pixelType))
+                break;
+              run.push_back(&item);
+            }
+            if (run.empty())
+              break;
+
+            const size_t referenceSize = run[0]->reference.size();
+            references.resize(run.size() * referenceSize);
+            queries.resize(run.size() * w * h);
+            depths.resize(run.size() * w * h * 3);
+            cameras.resize(run.size() * 9);
+            size_t rendered = 0;
+            for (auto *item : run) {
+              const auto &pose = item->pose;
+              CpuDrrCamera camera{
+                  pose.eye, pose.center, pose.up, predictions.fovy, aspect};
+              if (!renderer.render(camera, int(w), int(h), frame)) {
+                // a pose from a coarser level is no registration either
+                item->done = item->failed = true;
+                ok[item->index] = 0;
+                continue;
+              }
+              frameForEstimator(frame, gray, depth3d);
+              std::copy(item->reference.begin(),
+                  item->reference.end(),
+                  references.begin() + rendered * referenceSize);
+              std::copy(gray.begin(), gray.end(), queries.begin() + rendered * w * h);
+              std::copy(depth3d.begin(),
+                  depth3d.end(),
+                  depths.begin() + rendered * w * h * 3);
+              float *c = cameras.data() + 9 * rendered;
+              for (auto v : {pose.eye, pose.center, pose.up}) {
+                *c++ = v.x;
+                *c++ = v.y;
+                *c++ = v.z;
+              }
+              run[rendered++] = item;
+            }
+            if (rendered == 0)
+              continue;
+
+            estimator_batch batch;
+            batch.count = rendered;
+            batch.references = references.data();
+            batch.reference_width = run[0]->width;
+            batch.reference_height = run[0]->height;
+            batch.reference_pixel_type = run[0]->pixelType;
+            batch.reference_swizzle = true;
+            batch.queries = queries.data();
+            batch.query_pixel_type = image_transform_estimator::PIXEL_TYPE::R8;
+            batch.depth3d = depths.data();
+            batch.width = w;
+            batch.height = h;
+            batch.fovy = predictions.fovy;
+            batch.aspect = aspect;
+            batch.cameras = cameras.data();
+            if (!estimators.matchBatch(estimatorIndex, batch)) {
+              // no estimator instance to match with (matchBatch already fell
+              // back to pair by pair): the run's pairs fail, the rest of the
+              // chunk and its timings are still reported
+              {
+                std::lock_guard<std::mutex> l(printMutex);
+                fprintf(stderr,
+                    "ERROR: could not match %zu pair(s) with estimator %zu\n",
+                    rendered,
+                    estimatorIndex);
+              }
+              for (size_t j = 0; j < rendered; ++j) {
+                run[j]->done = run[j]->failed = true;
+                ok[run[j]->index] = 0;
+              }
+              continue;
+            }
+
+            for (size_t j = 0; j < rendered; ++j) {
+              auto &item = *run[j];
+              const float *c = cameras.data() + 9 * j;
+              CameraKey updated{
+                  {c[0], c[1], c[2]}, {c[3], c[4], c[5]}, {c[6], c[7], c[8]}};
+              float translation, rotation;
+              poseDelta(item.pose, updated, translation, rotation);
+              item.pose = updated;
+              ++item.iterations;
+              ++level.iterations;
+              ok[item.index] = 1;
+              if (translation <= settings.tolerances.translationTolerance
+                  && rotation <= settings.tolerances.rotationTolerance)
+                item.done = true;
+            }
+          }
+        }
+        level.seconds +=
+            std::chrono::duration<float>(clock::now() - levelStart).count();
+      }
+
+      // the pairs of a batch finish together
+      const float ms =
+          std::chrono::duration<float, std::milli>(clock::now() - start).count();
+      std::lock_guard<std::mutex> l(printMutex);
+      for (size_t i = 0; i < levels.size(); ++i) {
+        stats.levels[i].iterations += levels[i].iterations;
+        stats.levels[i].seconds += levels[i].seconds;
+        levels[i].iterations = 0;
+        levels[i].seconds = 0.f;
+      }
+      for (auto &item : items) {
+        const auto &p = predictions.predictions[item.index];
+        results[item.index] = item.pose;
+        stats.latencyMs[item.index] = ms;
+        printf("%s %zu/%zu: %s (%i iteration(s), %.1fms)\n",
+            ok[item.index] ? "registered" : "failed",
+            item.index + 1,
+            count,
+            p.filename.c_str(),
+            item.iterations,
+            ms);
+      }
+    }
+  };
+  const auto start = clock::now();
+  std::vector<std::thread> workers;
+  for (unsigned j = 0; j < jobs; ++j)
+    workers.emplace_back(work);
+  for (auto &w : workers)
+    w.join();
+  stats.wallSeconds =
+      std::chrono::duration<float>(clock::now() - start).count();
+
+  std::vector<float> latencies;
+  for (size_t i = 0; i < count; ++i) {
+    if (!ok[i]) {
+      ++stats.failed;
+      continue;
+    }
+    predictions.set_refined_camera(
+        i, results[i].eye, results[i].center, results[i].up);
+    latencies.push_back(stats.latencyMs[i]);
+    ++stats.registered;
+  }
+  stats.latencyMs = std::move(latencies);
+  return stats;
+}
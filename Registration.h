@@ -0,0 +1,69 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <vector>
+// ours
+#include "AutoRefine.h"
+#include "CpuDrrRenderer.h"
+#include "ImageTransformEstimatorWrapper.h"
+#include "prediction.h"
+
+// Render a DRR in the layout the viewer hands to the estimators: the line
+// integral windowed to its range as R8 (frame row order, columns as
+// rendered) and the per-pixel origin as F32X3
+void frameForEstimator(const CpuDrrFrame &frame,
+    std::vector<uint8_t> &gray,
+    std::vector<float> &depth3d);
+
+struct RegistrationSettings
+{
+  int width{1024};
+  int height{1024};
+  // predictions registered concurrently
+  unsigned jobs{0}; // 0: hardware_concurrency / 2
+  // render -> match -> update iterations per prediction and pyramid level,
+  // fewer once the pose update is below the tolerances
+  int iterations{1};
+  // coarse-to-fine pyramid: levels - 1 .. 0 render at (width, height) >> level
+  // against the reference downsampled to match, each level starting at the
+  // pose of the previous one (at least 16 pixels wide and high)
+  int levels{1};
+  // predictions matched per estimator call with the batched plugin ABI,
+  // pair by pair otherwise
+  size_t batchSize{1};
+  AutoRefine::Settings tolerances;
+};
+
+struct RegistrationLevel
+{
+  int width{0};
+  int height{0};
+  // over all predictions
+  int iterations{0};
+  float seconds{0.f}; // summed over the workers
+};
+
+struct RegistrationStats
+{
+  size_t registered{0};
+  size_t failed{0};
+  float wallSeconds{0.f};
+  // per prediction: reference load, render(s) and match(es)
+  std::vector<float> latencyMs;
+  // coarsest first
+  std::vector<RegistrationLevel> levels;
+};
+
+// Register every prediction against its reference image, starting at the
+// initial camera, and store the result as refined camera. Predictions are
+// processed by settings.jobs workers sharing the renderer, in chunks of
+// settings.batchSize handed to ImageTransformEstimatorWrapper::matchBatch
+// (pooled per-image instances for plugins without the batched ABI).
+RegistrationStats registerPredictions(prediction_container &predictions,
+    const CpuDrrRenderer &renderer,
+    ImageTransformEstimatorWrapper &estimators,
+    size_t estimatorIndex,
+    const RegistrationSettings &settings);
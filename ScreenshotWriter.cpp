@@ -0,0 +1,210 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#include "ScreenshotWriter.h"
+// std
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+// nlohmann
+#include <nlohmann/json.hpp>
+// stb_image
+#include "stb_image/stb_image_write.h"
+
+// FileNameCounter definitions ////////////////////////////////////////////////
+
+FileNameCounter::FileNameCounter(std::string base, std::string extension)
+    : m_base(std::move(base)), m_extension(std::move(extension))
+{}
+
+std::string FileNameCounter::next()
+{
+  if (m_index < 0) {
+    m_index = 0;
+    while (std::filesystem::exists(name(m_index) + m_extension))
+      ++m_index;
+  }
+  return name(m_index++);
+}
+
+std::string FileNameCounter::name(int index) const
+{
+  if (index == 0)
+    return m_base;
+  char suffix[16];
+  std::snprintf(suffix, sizeof(suffix), "-%04d", index);
+  return m_base + suffix;
+}
+
+// AsyncWriter definitions ////////////////////////////////////////////////////
+
+AsyncWriter::AsyncWriter(size_t maxPending, unsigned numThreads)
+    : m_maxPending(std::max<size_t>(maxPending, 1))
+{
+  for (unsigned i = 0; i < std::max(numThreads, 1u); ++i)
+    m_threads.emplace_back([this]() { run(); });
+}
+
+AsyncWriter::~AsyncWriter()
+{
+  {
+    std::unique_lock<std::mutex> l(m_mutex);
+    m_quit = true;
+  }
+  m_cond.notify_all();
+  for (auto &t : m_threads)
+    t.join();
+}
+
+void AsyncWriter::push(std::function<void()> job)
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  m_cond.wait(l, [this]() { return m_jobs.size() < m_maxPending; });
+  m_jobs.push_back(std::move(job));
+  l.unlock();
+  m_cond.notify_all();
+}
+
+void AsyncWriter::wait()
+{
+  std::unique_lock<std::mutex> l(m_mutex);
+  m_cond.wait(l, [this]() { return m_jobs.empty() && m_busy == 0; });
+}
+
+void AsyncWriter::run()
+{
+  for (;;) {
+    std::unique_lock<std::mutex> l(m_mutex);
+    m_cond.wait(l, [this]() { return m_quit || !m_jobs.empty(); });
+    if (m_jobs.empty())
+      return; // quit, and all jobs done
+    auto job = std::move(m_jobs.front());
+    m_jobs.pop_front();
+    ++m_busy;
+    l.unlock();
+    m_cond.notify_all();
+
+    job();
+
+    l.lock();
+    --m_busy;
+    l.unlock();
+    m_cond.notify_all();
+  }
+}
+
+// Export helpers /////////////////////////////////////////////////////////////
+
+void flipFrameForExport(const uint8_t *src,
+    uint8_t *dst,
+    size_t width,
+    size_t height,
+    size_t bpp)
+{
+  if (bpp == 1) {
+    for (size_t y = 0; y < height; ++y) {
+      const uint8_t *s = src + y * width;
+      uint8_t *d = dst + y * width;
+      std::reverse_copy(s, s + width, d);
+    }
+    return;
+  }
+
+  // RGBA8 -> RGB8, columns mirrored; unrolled by four pixels, copied in as
+  // one 16 byte and out as one 12 byte block (plain scalar code)
+  for (size_t y = 0; y < height; ++y) {
+    const uint8_t *s = src + (y * width + width) * 4;
+    uint8_t *d = dst + y * width * 3;
+    size_t x = 0;
+    for (; x + 4 <= width; x += 4, d += 12) {
+      s -= 16;
+      uint8_t rgba[16], rgb[12];
+      std::memcpy(rgba, s, 16);
+      for (int i = 0; i < 4; ++i) {
+        rgb[3 * i + 0] = rgba[4 * (3 - i) + 0];
+        rgb[3 * i + 1] = rgba[4 * (3 - i) + 1];
+        rgb[3 * i + 2] = rgba[4 * (3 - i) + 2];
+      }
+      std::memcpy(d, rgb, 12);
+    }
+    for (; x < width; ++x, d += 3) {
+      s -= 4;
+      d[0] = s[0];
+      d[1] = s[1];
+      d[2] = s[2];
+    }
+  }
+}
+
+bool writePng(const std::string &filename,
+    const uint8_t *pixels,
+    size_t components,
+    size_t width,
+    size_t height)
+{
+  return stbi_write_png(filename.c_str(),
+             int(width),
+             int(height),
+             int(components),
+             pixels,
+             int(width * components))
+      != 0;
+}
+
+// ScreenshotWriter definitions ///////////////////////////////////////////////
+
+ScreenshotWriter::ScreenshotWriter(std::string fileBase)
+    : m_names(std::move(fileBase), ".png")
+{}
+
+void ScreenshotWriter::save(std::vector<uint8_t> &&pixels,
+    size_t components,
+    size_t width,
+    size_t height,
+    anari::math::float3 eye,
+    anari::math::float3 center,
+    anari::math::float3 up,
+    float fovy)
+{
+  std::string base = m_names.next();
+
+  m_writer.push([=, pixels = std::move(pixels)]() {
+    std::string filename = base + ".png";
+    if (writePng(filename, pixels.data(), components, width, height))
+      std::cout << "Screenshot saved to file: " << filename << '\n';
+    else
+      std::cerr << "Error saving screenshot to file: " << filename << '\n';
+
+    // export camera
+    std::string json_filename{base + ".json"};
+    std::ofstream json_file(json_filename);
+    if (json_file.fail()) {
+      std::cerr << "ERROR: Could not open json file: " << json_filename << "\n"
+                << std::strerror(errno) << std::endl;
+      return;
+    }
+    try {
+      nlohmann::json data;
+      const auto fovx = fovy;
+      data["sensor"]["fov_x_rad"] = fovx;
+      data["sensor"]["fov_y_rad"] = fovy;
+      data["predictions"]["file"] = filename;
+      data["predictions"]["eye"]["x"] = eye.x;
+      data["predictions"]["eye"]["y"] = eye.y;
+      data["predictions"]["eye"]["z"] = eye.z;
+      data["predictions"]["center"]["x"] = center.x;
+      data["predictions"]["center"]["y"] = center.y;
+      data["predictions"]["center"]["z"] = center.z;
+      data["predictions"]["up"]["x"] = up.x;
+      data["predictions"]["up"]["y"] = up.y;
+      data["predictions"]["up"]["z"] = up.z;
+      json_file << data.dump(4);
+    } catch (...) {
+      std::cerr << "ERROR: Could not write json file.\n" << std::endl;
+    }
+  });
+}
@@ -0,0 +1,103 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+// anari
+#include <anari/anari_cpp/ext/linalg.h>
+
+// Sequential file names <base>, <base>-0001, ... (without extension). The file
+// system is probed once for the first free name, later calls continue from
+// the cached index.
+class FileNameCounter
+{
+ public:
+  FileNameCounter(std::string base, std::string extension);
+
+  std::string next();
+
+ private:
+  std::string name(int index) const;
+
+  std::string m_base;
+  std::string m_extension;
+  int m_index{-1};
+};
+
+// Runs jobs on numThreads background threads (in order for a single thread).
+// The queue is bounded: push() blocks while maxPending jobs are waiting, so
+// bursts of exports can't pile up frame copies without limit. Pending jobs
+// are finished on destruction.
+class AsyncWriter
+{
+ public:
+  explicit AsyncWriter(size_t maxPending = 8, unsigned numThreads = 1);
+  ~AsyncWriter();
+
+  AsyncWriter(const AsyncWriter &) = delete;
+  AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+  void push(std::function<void()> job);
+
+  // block until all queued jobs are done
+  void wait();
+
+ private:
+  void run();
+
+  size_t m_maxPending;
+  std::deque<std::function<void()>> m_jobs;
+  unsigned m_busy{0};
+  bool m_quit{false};
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::vector<std::thread> m_threads;
+};
+
+// Mirror columns (the frame is stored mirrored) and drop alpha in a single
+// pass: bpp == 4 writes RGB8, bpp == 1 writes R8
+void flipFrameForExport(const uint8_t *src,
+    uint8_t *dst,
+    size_t width,
+    size_t height,
+    size_t bpp);
+
+// Encode R8 (components 1) or RGB8 (components 3) pixels as PNG
+bool writePng(const std::string &filename,
+    const uint8_t *pixels,
+    size_t components,
+    size_t width,
+    size_t height);
+
+// Asynchronous export of viewport frames as PNG plus the camera as JSON
+// (same layout as the predictions file). Frames come ready to encode (see
+// DRRViewport::getExportFrame()), encoding and file IO happen on the writer
+// thread.
+class ScreenshotWriter
+{
+ public:
+  explicit ScreenshotWriter(std::string fileBase = "screenshot");
+
+  // pixels: R8 (components 1) or RGB8 (components 3), rows top to bottom
+  void save(std::vector<uint8_t> &&pixels,
+      size_t components,
+      size_t width,
+      size_t height,
+      anari::math::float3 eye,
+      anari::math::float3 center,
+      anari::math::float3 up,
+      float fovy);
+
+ private:
+  FileNameCounter m_names;
+  AsyncWriter m_writer;
+};
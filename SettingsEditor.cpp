@@ -13,13 +13,6 @@ SettingsEditor::SettingsEditor(const char *name)
 
 void SettingsEditor::buildUI()
 {
-  if (m_settingsChanged) {
-    triggerUpdateScatterFractionCallback();
-    triggerUpdateScatterSigmaCallback();
-    triggerUpdateVoxelSpacingCallback();
-    m_settingsChanged = false;
-  }
-
   //combo box
   std::vector<const char *> names(m_names.size(), nullptr);
   std::transform(m_names.begin(),
@@ -32,14 +25,16 @@ void SettingsEditor::buildUI()
 
   ImGui::Separator();
 
-  m_settingsChanged |=
-      ImGui::SliderFloat("scatter fraction", &m_scatterFraction, 0.f, 1.f);
+  // only notify what changed: scatter updates are cheap (post-process),
+  // voxel spacing changes require rendering the volume again
+  if (ImGui::SliderFloat("scatter fraction", &m_scatterFraction, 0.f, 1.f))
+    triggerUpdateScatterFractionCallback();
 
-  m_settingsChanged |=
-      ImGui::SliderFloat("scatter sigma", &m_scatterSigma, 0.f, 1000.f);
+  if (ImGui::SliderFloat("scatter sigma", &m_scatterSigma, 0.f, 1000.f))
+    triggerUpdateScatterSigmaCallback();
 
-  m_settingsChanged |=
-      ImGui::InputFloat3("voxel spacing [mm]", m_voxelSpacing, "%.5f");
+  if (ImGui::InputFloat3("voxel spacing [mm]", m_voxelSpacing, "%.5f"))
+    triggerUpdateVoxelSpacingCallback();
 
   ImGui::Separator();
 
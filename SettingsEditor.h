@@ -49,9 +49,6 @@ class SettingsEditor : public anari_viewer::windows::Window
   SettingsUpdateLacLutCallback m_updateLacLutCallback;
   SettingsUpdateVoxelSpacingCallback m_updateVoxelSpacingCallback;
 
-  // flag indicating transfer function has changed in UI
-  bool m_settingsChanged{true};
-
   // LAC LUTs
   std::vector<std::pair<size_t, std::string>> m_names;
   size_t m_lacLutId{0};
@@ -0,0 +1,665 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#include "SimilarityMetrics.h"
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
+// ours
+#include "WorkerPool.h"
+
+namespace {
+
+// Inner loops accumulate into LANES independent partial sums so they
+// vectorize without reassociating floating point math; rows are summed in
+// double
+constexpr int LANES = 8;
+// rows per parallel work item
+constexpr int BAND_ROWS = 16;
+
+// Sum of func(y0, y1, partial) over bands of rows, bands distributed over
+// the pool's threads; Partial needs += and a default (zero) state
+template <typename Partial, typename Func>
+Partial reduceRows(int y0, int y1, WorkerPool &workers, Partial zero, Func func)
+{
+  const int numBands = std::max(0, (y1 - y0 + BAND_ROWS - 1) / BAND_ROWS);
+  std::vector<Partial> partials(numBands, zero);
+  workers.parallelFor(numBands, [&](int b) {
+    const int ya = y0 + b * BAND_ROWS;
+    func(ya, std::min(ya + BAND_ROWS, y1), partials[b]);
+  });
+
+  Partial result = zero;
+  for (auto &p : partials)
+    result += p;
+  return result;
+}
+
+// Sums of the samples less a shift (ka, kb) close to their means: raw sums
+// of squares of data with a large offset (e.g. native 16 bit detector
+// values) cancel in saa - sa * sa / n
+struct Moments
+{
+  double n{0.0}, sa{0.0}, sb{0.0}, saa{0.0}, sbb{0.0}, sab{0.0};
+  float ka{0.f}, kb{0.f};
+
+  Moments &operator+=(const Moments &o)
+  {
+    n += o.n;
+    sa += o.sa;
+    sb += o.sb;
+    saa += o.saa;
+    sbb += o.sbb;
+    sab += o.sab;
+    return *this;
+  }
+
+  // weighted lanes of one row segment
+  template <typename A, typename B, typename M>
+  void addRow(int x0, int x1, A a, B b, M m)
+  {
+    float n_[LANES]{}, sa_[LANES]{}, sb_[LANES]{}, saa_[LANES]{},
+        sbb_[LANES]{}, sab_[LANES]{};
+    int x = x0;
+    for (; x + LANES <= x1; x += LANES) {
+      for (int l = 0; l < LANES; ++l) {
+        const float w = m(x + l), va = a(x + l) - ka, vb = b(x + l) - kb;
+        n_[l] += w;
+        sa_[l] += w * va;
+        sb_[l] += w * vb;
+        saa_[l] += w * va * va;
+        sbb_[l] += w * vb * vb;
+        sab_[l] += w * va * vb;
+      }
+    }
+    for (; x < x1; ++x) {
+      const float w = m(x), va = a(x) - ka, vb = b(x) - kb;
+      n_[0] += w;
+      sa_[0] += w * va;
+      sb_[0] += w * vb;
+      saa_[0] += w * va * va;
+      sbb_[0] += w * vb * vb;
+      sab_[0] += w * va * vb;
+    }
+    for (int l = 0; l < LANES; ++l) {
+      n += n_[l];
+      sa += sa_[l];
+      sb += sb_[l];
+      saa += saa_[l];
+      sbb += sbb_[l];
+      sab += sab_[l];
+    }
+  }
+
+  double meanA() const
+  {
+    return ka + sa / n;
+  }
+  double meanB() const
+  {
+    return kb + sb / n;
+  }
+  double varA() const
+  {
+    return std::max(saa / n - (sa / n) * (sa / n), 0.0);
+  }
+  double varB() const
+  {
+    return std::max(sbb / n - (sb / n) * (sb / n), 0.0);
+  }
+  double correlation() const
+  {
+    const double cov = sab - sa * sb / n;
+    const double va = saa - sa * sa / n;
+    const double vb = sbb - sb * sb / n;
+    if (n <= 0.0 || va <= 0.0 || vb <= 0.0)
+      return 0.0;
+    return cov / std::sqrt(va * vb);
+  }
+};
+
+struct GradientMoments
+{
+  Moments x, y;
+
+  GradientMoments &operator+=(const GradientMoments &o)
+  {
+    x += o.x;
+    y += o.y;
+    return *this;
+  }
+};
+
+struct Sum
+{
+  double value{0.0}, n{0.0};
+
+  Sum &operator+=(const Sum &o)
+  {
+    value += o.value;
+    n += o.n;
+    return *this;
+  }
+};
+
+struct Range
+{
+  float loA{std::numeric_limits<float>::max()};
+  float hiA{std::numeric_limits<float>::lowest()};
+  float loB{std::numeric_limits<float>::max()};
+  float hiB{std::numeric_limits<float>::lowest()};
+
+  Range &operator+=(const Range &o)
+  {
+    loA = std::min(loA, o.loA);
+    hiA = std::max(hiA, o.hiA);
+    loB = std::min(loB, o.loB);
+    hiB = std::max(hiB, o.hiB);
+    return *this;
+  }
+};
+
+struct Histogram
+{
+  std::vector<double> joint;
+
+  Histogram &operator+=(const Histogram &o)
+  {
+    for (size_t i = 0; i < joint.size(); ++i)
+      joint[i] += o.joint[i];
+    return *this;
+  }
+};
+
+// per-pixel weight of an optional mask
+struct MaskRow
+{
+  const uint8_t *row;
+
+  float operator()(int x) const
+  {
+    return row ? float(row[x] != 0) : 1.f;
+  }
+};
+
+// mean of at most ~1024 evenly spaced pixels, the shift of Moments
+float coarseMean(const MetricImage &image)
+{
+  const size_t size = image.pixels.size();
+  if (size == 0)
+    return 0.f;
+  const size_t stride = std::max<size_t>(size / 1024, 1);
+  double sum = 0.0;
+  size_t count = 0;
+  for (size_t i = 0; i < size; i += stride, ++count)
+    sum += image.pixels[i];
+  return float(sum / count);
+}
+
+Moments intensityMoments(const MetricImage &a,
+    const MetricImage &b,
+    const uint8_t *mask,
+    WorkerPool &workers)
+{
+  const int w = a.width;
+  Moments zero;
+  zero.ka = coarseMean(a);
+  zero.kb = coarseMean(b);
+  return reduceRows(0, a.height, workers, zero, [&](int y0, int y1, Moments &m) {
+    for (int y = y0; y < y1; ++y) {
+      const float *ra = a.pixels.data() + size_t(y) * w;
+      const float *rb = b.pixels.data() + size_t(y) * w;
+      if (mask) {
+        const uint8_t *rm = mask + size_t(y) * w;
+        m.addRow(0, w, [&](int x) { return ra[x]; }, [&](int x) { return rb[x]; },
+            MaskRow{rm});
+      } else {
+        m.addRow(0, w, [&](int x) { return ra[x]; }, [&](int x) { return rb[x]; },
+            [](int) { return 1.f; });
+      }
+    }
+  });
+}
+
+// central differences at interior pixels
+GradientMoments gradientMoments(const MetricImage &a,
+    const MetricImage &b,
+    const uint8_t *mask,
+    WorkerPool &workers)
+{
+  const int w = a.width;
+  return reduceRows(1, a.height - 1, workers, GradientMoments(),
+      [&](int y0, int y1, GradientMoments &g) {
+        for (int y = y0; y < y1; ++y) {
+          const float *ra = a.pixels.data() + size_t(y) * w;
+          const float *rb = b.pixels.data() + size_t(y) * w;
+          const MaskRow m{mask ? mask + size_t(y) * w : nullptr};
+          g.x.addRow(1, w - 1, [&](int x) { return ra[x + 1] - ra[x - 1]; },
+              [&](int x) { return rb[x + 1] - rb[x - 1]; }, m);
+          g.y.addRow(1, w - 1, [&](int x) { return ra[x + w] - ra[x - w]; },
+              [&](int x) { return rb[x + w] - rb[x - w]; }, m);
+        }
+      });
+}
+
+float gradientDifference(const MetricImage &a,
+    const MetricImage &b,
+    const uint8_t *mask,
+    WorkerPool &workers)
+{
+  const int w = a.width;
+  // z-scored intensities, then Av and Ah are the variances of the fixed
+  // image's gradients
+  const Moments m = intensityMoments(a, b, mask, workers);
+  const double sdA = std::sqrt(m.varA()), sdB = std::sqrt(m.varB());
+  if (m.n <= 0.0 || sdA <= 0.0 || sdB <= 0.0)
+    return std::numeric_limits<float>::quiet_NaN();
+  const GradientMoments g = gradientMoments(a, b, mask, workers);
+  const float Av = std::max(g.x.varB() / (sdB * sdB), 1e-12);
+  const float Ah = std::max(g.y.varB() / (sdB * sdB), 1e-12);
+  const float ia = float(1.0 / sdA), ib = float(1.0 / sdB);
+
+  const Sum s = reduceRows(1, a.height - 1, workers, Sum(), [&](int y0, int y1, Sum &sum) {
+    for (int y = y0; y < y1; ++y) {
+      const float *ra = a.pixels.data() + size_t(y) * w;
+      const float *rb = b.pixels.data() + size_t(y) * w;
+      const MaskRow mr{mask ? mask + size_t(y) * w : nullptr};
+      float v[LANES]{}, n[LANES]{};
+      int x = 1;
+      auto term = [&](int x) {
+        float dx = (rb[x + 1] - rb[x - 1]) * ib - (ra[x + 1] - ra[x - 1]) * ia;
+        float dy = (rb[x + w] - rb[x - w]) * ib - (ra[x + w] - ra[x - w]) * ia;
+        return Av / (Av + dx * dx) + Ah / (Ah + dy * dy);
+      };
+      for (; x + LANES <= w - 1; x += LANES) {
+        for (int l = 0; l < LANES; ++l) {
+          const float wt = mr(x + l);
+          v[l] += wt * term(x + l);
+          n[l] += wt;
+        }
+      }
+      for (; x < w - 1; ++x) {
+        v[0] += mr(x) * term(x);
+        n[0] += mr(x);
+      }
+      for (int l = 0; l < LANES; ++l) {
+        sum.value += v[l];
+        sum.n += n[l];
+      }
+    }
+  });
+  return s.n > 0.0 ? float(s.value / (2.0 * s.n))
+                   : std::numeric_limits<float>::quiet_NaN();
+}
+
+float mutualInformation(const MetricImage &a,
+    const MetricImage &b,
+    const uint8_t *mask,
+    int bins,
+    WorkerPool &workers)
+{
+  const int w = a.width;
+  bins = std::clamp(bins, 2, 256);
+
+  const Range r = reduceRows(0, a.height, workers, Range(), [&](int y0, int y1, Range &range) {
+    for (int y = y0; y < y1; ++y) {
+      const float *ra = a.pixels.data() + size_t(y) * w;
+      const float *rb = b.pixels.data() + size_t(y) * w;
+      const uint8_t *rm = mask ? mask + size_t(y) * w : nullptr;
+      for (int x = 0; x < w; ++x) {
+        if (rm && !rm[x])
+          continue;
+        range.loA = std::min(range.loA, ra[x]);
+        range.hiA = std::max(range.hiA, ra[x]);
+        range.loB = std::min(range.loB, rb[x]);
+        range.hiB = std::max(range.hiB, rb[x]);
+      }
+    }
+  });
+  if (r.loA > r.hiA)
+    return std::numeric_limits<float>::quiet_NaN();
+
+  const float scaleA = r.hiA > r.loA ? bins / (r.hiA - r.loA) : 0.f;
+  const float scaleB = r.hiB > r.loB ? bins / (r.hiB - r.loB) : 0.f;
+  Histogram zero;
+  zero.joint.assign(size_t(bins) * bins, 0.0);
+  const Histogram h = reduceRows(0, a.height, workers, zero, [&](int y0, int y1, Histogram &hist) {
+    std::vector<uint32_t> counts(size_t(bins) * bins, 0);
+    int ia[LANES], ib[LANES];
+    for (int y = y0; y < y1; ++y) {
+      const float *ra = a.pixels.data() + size_t(y) * w;
+      const float *rb = b.pixels.data() + size_t(y) * w;
+      const uint8_t *rm = mask ? mask + size_t(y) * w : nullptr;
+      for (int x = 0; x < w; x += LANES) {
+        const int n = std::min(LANES, w - x);
+        // bin indices vectorize, the scatter doesn't
+        for (int l = 0; l < LANES; ++l) {
+          const int xi = x + std::min(l, n - 1);
+          ia[l] = std::min(int((ra[xi] - r.loA) * scaleA), bins - 1);
+          ib[l] = std::min(int((rb[xi] - r.loB) * scaleB), bins - 1);
+        }
+        for (int l = 0; l < n; ++l) {
+          if (!rm || rm[x + l])
+            ++counts[size_t(ia[l]) * bins + ib[l]];
+        }
+      }
+    }
+    for (size_t i = 0; i < counts.size(); ++i)
+      hist.joint[i] += counts[i];
+  });
+
+  std::vector<double> pa(bins, 0.0), pb(bins, 0.0);
+  double total = 0.0;
+  for (int i = 0; i < bins; ++i) {
+    for (int j = 0; j < bins; ++j) {
+      const double c = h.joint[size_t(i) * bins + j];
+      pa[i] += c;
+      pb[j] += c;
+      total += c;
+    }
+  }
+  if (total <= 0.0)
+    return std::numeric_limits<float>::quiet_NaN();
+  double mi = 0.0;
+  for (int i = 0; i < bins; ++i) {
+    for (int j = 0; j < bins; ++j) {
+      const double c = h.joint[size_t(i) * bins + j];
+      if (c > 0.0)
+        mi += c / total * std::log(c * total / (pa[i] * pb[j]));
+    }
+  }
+  return float(mi);
+}
+
+float patternIntensity(const MetricImage &a,
+    const MetricImage &b,
+    const uint8_t *mask,
+    float sigma,
+    int radius,
+    WorkerPool &workers)
+{
+  const int w = a.width, h = a.height;
+  const Moments m = intensityMoments(a, b, mask, workers);
+  const double sdA = std::sqrt(m.varA()), sdB = std::sqrt(m.varB());
+  if (m.n <= 0.0 || sdA <= 0.0 || sdB <= 0.0)
+    return std::numeric_limits<float>::quiet_NaN();
+
+  // difference of the z-scored images
+  std::vector<float> d(size_t(w) * h);
+  const float ia = float(1.0 / sdA), ib = float(1.0 / sdB);
+  const float ma = float(m.meanA()), mb = float(m.meanB());
+  reduceRows(0, h, workers, Sum(), [&](int y0, int y1, Sum &) {
+    for (size_t i = size_t(y0) * w; i < size_t(y1) * w; ++i)
+      d[i] = (b.pixels[i] - mb) * ib - (a.pixels[i] - ma) * ia;
+  });
+
+  // each unordered pair within the radius once
+  std::vector<std::pair<int, int>> offsets;
+  for (int dy = 0; dy <= radius; ++dy) {
+    for (int dx = -radius; dx <= radius; ++dx) {
+      if ((dy == 0 && dx <= 0) || dx * dx + dy * dy > radius * radius)
+        continue;
+      offsets.emplace_back(dx, dy);
+    }
+  }
+  const float s2 = sigma * sigma;
+
+  const Sum s = reduceRows(0, h, workers, Sum(), [&](int y0, int y1, Sum &sum) {
+    for (int y = y0; y < y1; ++y) {
+      const float *r0 = d.data() + size_t(y) * w;
+      const uint8_t *m0 = mask ? mask + size_t(y) * w : nullptr;
+      for (auto [dx, dy] : offsets) {
+        if (y + dy >= h)
+          continue;
+        const float *r1 = r0 + size_t(dy) * w + dx;
+        const uint8_t *m1 = m0 ? m0 + size_t(dy) * w + dx : nullptr;
+        const int x0 = std::max(0, -dx), x1 = std::min(w, w - dx);
+        float v[LANES]{}, n[LANES]{};
+        int x = x0;
+        auto weight = [&](int x) {
+          return m0 ? float(m0[x] != 0 && m1[x] != 0) : 1.f;
+        };
+        for (; x + LANES <= x1; x += LANES) {
+          for (int l = 0; l < LANES; ++l) {
+            const float t = r0[x + l] - r1[x + l];
+            const float wt = weight(x + l);
+            v[l] += wt * s2 / (s2 + t * t);
+            n[l] += wt;
+          }
+        }
+        for (; x < x1; ++x) {
+          const float t = r0[x] - r1[x];
+          v[0] += weight(x) * s2 / (s2 + t * t);
+          n[0] += weight(x);
+        }
+        for (int l = 0; l < LANES; ++l) {
+          sum.value += v[l];
+          sum.n += n[l];
+        }
+      }
+    }
+  });
+  return s.n > 0.0 ? float(s.value / s.n)
+                   : std::numeric_limits<float>::quiet_NaN();
+}
+
+} // namespace
+
+// MetricImage definitions ////////////////////////////////////////////////////
+
+MetricImage MetricImage::fromImage(const Image &image, int width, int height)
+{
+  MetricImage result;
+  result.width = width > 0 ? width : int(image.width);
+  result.height = height > 0 ? height : int(image.height);
+  result.pixels.resize(size_t(result.width) * result.height);
+  if (image.width == 0 || image.height == 0)
+    return result;
+
+  std::vector<int> columns(result.width);
+  for (int x = 0; x < result.width; ++x)
+    columns[x] = int(size_t(x) * image.width / result.width);
+
+  for (int y = 0; y < result.height; ++y) {
+    const size_t sy = size_t(y) * image.height / result.height;
+    const uint8_t *row = image.data.data() + sy * image.width * image.bpp;
+    float *dst = result.pixels.data() + size_t(y) * result.width;
+    switch (image.type) {
+    case Image::PixelType::R8:
+      for (int x = 0; x < result.width; ++x)
+        dst[x] = row[columns[x]];
+      break;
+    case Image::PixelType::R16: {
+      auto src = reinterpret_cast<const uint16_t *>(row);
+      for (int x = 0; x < result.width; ++x)
+        dst[x] = src[columns[x]];
+      break;
+    }
+    case Image::PixelType::R32F: {
+      auto src = reinterpret_cast<const float *>(row);
+      for (int x = 0; x < result.width; ++x)
+        dst[x] = std::isfinite(src[columns[x]]) ? src[columns[x]] : 0.f;
+      break;
+    }
+    default:
+      // color: luminance
+      for (int x = 0; x < result.width; ++x) {
+        const uint8_t *p = row + columns[x] * image.bpp;
+        dst[x] = .2126f * p[0] + .7152f * p[1] + .0722f * p[2];
+      }
+      break;
+    }
+  }
+  return result;
+}
+
+MetricImage MetricImage::fromFrame(
+    const uint8_t *frame, size_t bpp, int width, int height)
+{
+  MetricImage result;
+  result.width = width;
+  result.height = height;
+  result.pixels.resize(size_t(width) * height);
+  for (int y = 0; y < height; ++y) {
+    const uint8_t *src = frame + size_t(y) * width * bpp;
+    float *dst = result.pixels.data() + size_t(y) * width;
+    for (int x = 0; x < width; ++x) {
+      const uint8_t *p = src + size_t(width - 1 - x) * bpp;
+      dst[x] = bpp == 1 ? p[0] : .2126f * p[0] + .7152f * p[1] + .0722f * p[2];
+    }
+  }
+  return result;
+}
+
+MetricImage MetricImage::fromFrame(const float *frame, int width, int height)
+{
+  MetricImage result;
+  result.width = width;
+  result.height = height;
+  result.pixels.resize(size_t(width) * height);
+  for (int y = 0; y < height; ++y) {
+    const float *src = frame + size_t(y) * width;
+    std::reverse_copy(src, src + width, result.pixels.data() + size_t(y) * width);
+  }
+  return result;
+}
+
+// Metric functions ///////////////////////////////////////////////////////////
+
+const char *toString(Metric metric)
+{
+  switch (metric) {
+  case Metric::NCC:
+    return "ncc";
+  case Metric::GRADIENT_CORRELATION:
+    return "gradient correlation";
+  case Metric::GRADIENT_DIFFERENCE:
+    return "gradient difference";
+  case Metric::MUTUAL_INFORMATION:
+    return "mutual information";
+  case Metric::PATTERN_INTENSITY:
+    return "pattern intensity";
+  }
+  return "unknown";
+}
+
+float computeMetric(Metric metric,
+    const MetricImage &moving,
+    const MetricImage &fixed,
+    const uint8_t *mask,
+    const MetricSettings &settings)
+{
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  if (moving.width != fixed.width || moving.height != fixed.height
+      || moving.width < 3 || moving.height < 3)
+    return nan;
+
+  // the settings' pool, else one kept between calls; a caller that finds
+  // the kept pool busy (another thread evaluating) runs its rows inline
+  WorkerPool inlinePool(1);
+  std::unique_lock<std::mutex> sharedLock;
+  WorkerPool *workers = settings.workers;
+  if (!workers && settings.numThreads != 1) {
+    static std::mutex sharedMutex;
+    static std::optional<WorkerPool> shared;
+    sharedLock = std::unique_lock<std::mutex>(sharedMutex, std::try_to_lock);
+    if (sharedLock.owns_lock()) {
+      const unsigned numThreads = settings.numThreads
+          ? settings.numThreads
+          : std::max(1u, std::thread::hardware_concurrency());
+      if (!shared || shared->size() != numThreads)
+        shared.emplace(numThreads);
+      workers = &*shared;
+    }
+  }
+  WorkerPool &threads = workers ? *workers : inlinePool;
+  switch (metric) {
+  case Metric::NCC: {
+    const Moments m = intensityMoments(moving, fixed, mask, threads);
+    return m.n > 0.0 ? float(m.correlation()) : nan;
+  }
+  case Metric::GRADIENT_CORRELATION: {
+    const GradientMoments g = gradientMoments(moving, fixed, mask, threads);
+    if (g.x.n <= 0.0)
+      return nan;
+    return float(.5 * (g.x.correlation() + g.y.correlation()));
+  }
+  case Metric::GRADIENT_DIFFERENCE:
+    return gradientDifference(moving, fixed, mask, threads);
+  case Metric::MUTUAL_INFORMATION:
+    return mutualInformation(moving, fixed, mask, settings.bins, threads);
+  case Metric::PATTERN_INTENSITY:
+    return patternIntensity(moving,
+        fixed,
+        mask,
+        settings.piSigma,
+        std::max(settings.piRadius, 1),
+        threads);
+  }
+  return nan;
+}
+
+float metricCost(Metric metric, float value)
+{
+  return metric == Metric::MUTUAL_INFORMATION ? -value : 1.f - value;
+}
+
+void benchmarkMetrics(int width, int height, int repetitions, unsigned numThreads)
+{
+  // smooth pattern plus noise, the moving image slightly shifted
+  MetricImage fixed, moving;
+  fixed.width = moving.width = width;
+  fixed.height = moving.height = height;
+  fixed.pixels.resize(size_t(width) * height);
+  moving.pixels.resize(size_t(width) * height);
+  std::vector<uint8_t> mask(size_t(width) * height);
+  std::mt19937 rng(1);
+  std::normal_distribution<float> noise(0.f, 4.f);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      const size_t i = size_t(y) * width + x;
+      auto f = [&](float u, float v) {
+        return 128.f + 60.f * std::sin(u * .05f) * std::cos(v * .03f);
+      };
+      fixed.pixels[i] = f(x, y) + noise(rng);
+      moving.pixels[i] = f(x + 1.5f, y - 1.f) + noise(rng);
+      const float dx = x - width * .5f, dy = y - height * .5f;
+      mask[i] = dx * dx + dy * dy < .16f * width * height;
+    }
+  }
+
+  WorkerPool workers(numThreads);
+  MetricSettings settings;
+  settings.workers = &workers;
+  const double mpixels = double(width) * height * 1e-6;
+  printf("metrics benchmark: %i x %i, %i repetitions, %u thread(s)\n",
+      width,
+      height,
+      repetitions,
+      workers.size());
+  for (int i = 0; i < NUM_METRICS; ++i) {
+    const Metric metric = Metric(i);
+    for (const uint8_t *m : {(const uint8_t *)nullptr, (const uint8_t *)mask.data()}) {
+      float value = computeMetric(metric, moving, fixed, m, settings);
+      auto start = std::chrono::steady_clock::now();
+      for (int r = 0; r < repetitions; ++r)
+        value = computeMetric(metric, moving, fixed, m, settings);
+      const double seconds = std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start)
+                                 .count();
+      printf("  %-22s %-7s %9.1f Mpixels/s  %8.3f ms  value %.4f\n",
+          toString(metric),
+          m ? "masked" : "",
+          mpixels * repetitions / std::max(seconds, 1e-9),
+          seconds * 1e3 / std::max(repetitions, 1),
+          value);
+    }
+  }
+}
@@ -0,0 +1,78 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <cstdint>
+#include <vector>
+// ours
+#include "Image.h"
+
+class WorkerPool;
+
+// Intensity similarity between a rendered DRR (moving) and a reference image
+// (fixed) of the same size, for scoring poses without feature matching:
+//   NCC                  normalized cross correlation, [-1, 1]
+//   GRADIENT_CORRELATION mean NCC of the x and y gradients, [-1, 1]
+//   GRADIENT_DIFFERENCE  Penney et al. 1998 on z-scored intensities, (0, 1]
+//   MUTUAL_INFORMATION   from a joint histogram, nats, >= 0
+//   PATTERN_INTENSITY    Weese et al. 1997 on z-scored intensities, (0, 1]
+// Higher is better for all of them; metricCost() maps them to costs.
+enum class Metric
+{
+  NCC,
+  GRADIENT_CORRELATION,
+  GRADIENT_DIFFERENCE,
+  MUTUAL_INFORMATION,
+  PATTERN_INTENSITY,
+};
+
+constexpr int NUM_METRICS = 5;
+
+const char *toString(Metric metric);
+
+struct MetricSettings
+{
+  unsigned numThreads{0}; // 0: hardware concurrency
+  // rows are spread over this pool's threads when set, numThreads is ignored
+  WorkerPool *workers{nullptr};
+  // mutual information
+  int bins{64};
+  // pattern intensity, sigma in standard deviations of the intensities
+  float piSigma{.2f};
+  int piRadius{3};
+};
+
+// Grayscale float plane in reference image layout (row 0 first as stored,
+// columns not mirrored)
+struct MetricImage
+{
+  int width{0};
+  int height{0};
+  std::vector<float> pixels;
+
+  // luminance of an image, resampled (nearest) to width x height unless 0;
+  // single channel types keep their native precision
+  static MetricImage fromImage(const Image &image, int width = 0, int height = 0);
+  // viewport frame (R8 or RGBA8) or CPU line integral, columns mirrored as
+  // returned by getFrame / CpuDrrRenderer
+  static MetricImage fromFrame(
+      const uint8_t *frame, size_t bpp, int width, int height);
+  static MetricImage fromFrame(const float *frame, int width, int height);
+};
+
+// Metric value over the pixels where mask (width * height, nullptr for all)
+// is non-zero; NaN if the sizes differ or there is nothing to compare
+float computeMetric(Metric metric,
+    const MetricImage &moving,
+    const MetricImage &fixed,
+    const uint8_t *mask = nullptr,
+    const MetricSettings &settings = {});
+
+// lower is better: 1 - value for the bounded metrics, -value for MI
+float metricCost(Metric metric, float value);
+
+// Time every metric on a synthetic width x height pair and print
+// Mpixels/s, with and without a mask
+void benchmarkMetrics(int width, int height, int repetitions, unsigned numThreads);
@@ -0,0 +1,68 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#include "ThumbnailCache.h"
+// std
+#include <algorithm>
+
+// ThumbnailCache definitions /////////////////////////////////////////////////
+
+ThumbnailCache::ThumbnailCache(std::vector<std::string> filenames,
+    unsigned maxSize,
+    size_t memoryBudget,
+    unsigned numThreads)
+    : ImageCache(std::move(filenames),
+        memoryBudget,
+        std::max(1u, numThreads),
+        [maxSize = std::max(1u, maxSize)](Image &&image) {
+          return makeThumbnail(image, maxSize);
+        })
+{
+  setMaxQueued(64);
+}
+
+// Thumbnails /////////////////////////////////////////////////////////////////
+
+Image makeThumbnail(const Image &image, unsigned maxSize)
+{
+  // 8 bit source with 1 or 3 used channels
+  std::vector<uint8_t> gray;
+  const uint8_t *src = image.data.data();
+  size_t stride = image.bpp;
+  size_t channels = 3;
+  if (image.isSingleChannel()) {
+    narrowToR8(image, gray);
+    src = gray.data();
+    stride = 1;
+    channels = 1;
+  }
+
+  const size_t w = image.width, h = image.height;
+  const size_t longer = std::max(w, h);
+  const size_t tw = std::max<size_t>(1, w * maxSize / std::max<size_t>(longer, maxSize));
+  const size_t th = std::max<size_t>(1, h * maxSize / std::max<size_t>(longer, maxSize));
+
+  std::vector<uint8_t> pixels(tw * th * channels);
+  for (size_t y = 0; y < th; ++y) {
+    const size_t y0 = y * h / th, y1 = std::max(y0 + 1, (y + 1) * h / th);
+    for (size_t x = 0; x < tw; ++x) {
+      const size_t x0 = x * w / tw, x1 = std::max(x0 + 1, (x + 1) * w / tw);
+      uint32_t sum[3] = {0, 0, 0};
+      for (size_t sy = y0; sy < y1; ++sy) {
+        const uint8_t *row = src + sy * w * stride;
+        for (size_t sx = x0; sx < x1; ++sx) {
+          for (size_t c = 0; c < channels; ++c)
+            sum[c] += row[sx * stride + c];
+        }
+      }
+      const uint32_t n = uint32_t((y1 - y0) * (x1 - x0));
+      for (size_t c = 0; c < channels; ++c)
+        pixels[(y * tw + x) * channels + c] = uint8_t((sum[c] + n / 2) / n);
+    }
+  }
+
+  return Image(tw,
+      th,
+      channels == 1 ? Image::PixelType::R8 : Image::PixelType::RGB8,
+      pixels.data());
+}
@@ -0,0 +1,25 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// ours
+#include "ImageCache.h"
+
+// Reduced size previews of the prediction images for the predictions
+// browser: an ImageCache that downsamples every decoded image and only keeps
+// the thumbnails (R8 or RGB8, within a memory budget). Requests are served
+// latest first and the queue is bounded, so scrolling through a long list
+// only decodes what is (or was recently) visible.
+class ThumbnailCache : public ImageCache
+{
+ public:
+  ThumbnailCache(std::vector<std::string> filenames,
+      unsigned maxSize = 96,
+      size_t memoryBudget = size_t(64) << 20,
+      unsigned numThreads = 2);
+};
+
+// Box filtered copy of the image with its longer side at most maxSize
+// pixels; high bit depth images are stretched to R8, RGBA8 drops alpha
+Image makeThumbnail(const Image &image, unsigned maxSize);
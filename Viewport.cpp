@@ -7,12 +7,17 @@
 #include <common/input/mouse.h>
 #include <common/manip/arcball_manipulator.h>
 // std
+#include <algorithm>
 #include <cstring>
+#include <filesystem>
 #include <memory>
 #include <chrono>
+#include <cmath>
 #include <thread>
 // stb_image
 #include "stb_image/stb_image_write.h"
+// ours
+#include "RecursiveGaussian.h"
 
 namespace anari_viewer::windows {
 
@@ -37,15 +42,7 @@ DRRViewport::DRRViewport(anari::Device device, visionaray::pinhole_camera &camer
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexImage2D(GL_TEXTURE_2D,
-      0,
-      GL_RGBA8,
-      m_viewportSize.x,
-      m_viewportSize.y,
-      0,
-      GL_RGBA,
-      GL_UNSIGNED_BYTE,
-      0);
+  allocateTexture();
 
   // ANARI //
 
@@ -85,7 +82,7 @@ DRRViewport::DRRViewport(anari::Device device, visionaray::pinhole_camera &camer
 DRRViewport::~DRRViewport()
 {
   cancelFrame();
-  anari::wait(m_device, m_frame);
+  waitFrame();
 
   anari::release(m_device, m_perspCamera);
   anari::release(m_device, m_world);
@@ -100,25 +97,52 @@ void DRRViewport::buildUI()
   ImVec2 _viewportSize = ImGui::GetContentRegionAvail();
   anari::math::int2 viewportSize(_viewportSize.x, _viewportSize.y);
 
-  if (m_viewportSize != viewportSize)
+  // sequence capture and benchmarks render at a fixed resolution
+  if (m_viewportSize != viewportSize && !m_sequenceCapture && !m_benchmark)
     reshape(viewportSize);
 
-  if (m_viewChanged || (!m_singleShot)) {
+  if (m_benchmark)
+    runBenchmarkFrame();
+
+  if (m_viewChanged || m_saveNextFrame || !m_accumulation.converged()) {
     updateCamera();
     updateImage();
   }
 
-  ImGui::Image((void *)(intptr_t)m_framebufferTexture,
-      ImGui::GetContentRegionAvail(),
-      ImVec2(1, 0),
-      ImVec2(0, 1));
+  if (m_sequencePlaying)
+    advanceCameraPath();
+
+  const ImageRegion region = imageRegion();
+  if (region.full()) {
+    ImGui::Image((void *)(intptr_t)m_framebufferTexture,
+        ImGui::GetContentRegionAvail(),
+        ImVec2(1, 0),
+        ImVec2(0, 1));
+  } else {
+    // the region's frame fills the lower left of the texture and is shown
+    // at its place in the view, the rest stays dark
+    const ImVec2 avail = ImGui::GetContentRegionAvail();
+    const ImVec2 pos = ImGui::GetCursorScreenPos();
+    ImGui::Dummy(avail);
+    const auto frame = frameSize();
+    const ImVec2 lo(pos.x + .5f * (avail.x - frame.x),
+        pos.y + .5f * (avail.y - frame.y));
+    const ImVec2 hi(lo.x + frame.x, lo.y + frame.y);
+    auto *drawList = ImGui::GetWindowDrawList();
+    drawList->AddImage((void *)(intptr_t)m_framebufferTexture,
+        lo,
+        hi,
+        ImVec2(frame.x / float(m_viewportSize.x), 0),
+        ImVec2(0, frame.y / float(m_viewportSize.y)));
+    drawList->AddRect(lo, hi, IM_COL32(255, 200, 0, 255));
+  }
 
   if (m_showOverlay)
     ui_overlay();
 
   ui_contextMenu();
 
-  if (!m_contextMenuVisible)
+  if (!m_contextMenuVisible && !ui_regionSelect())
   {
     ui_picking();
     ui_handleInput();
@@ -205,6 +229,30 @@ void DRRViewport::setView(anari::math::float3 eye, anari::math::float3 center, a
   updateImage();
 }
 
+void DRRViewport::setImageRegion(const ImageRegion &region)
+{
+  m_imageRegion = region;
+
+  updateFrame();
+  cancelFrame();
+  updateCamera(true);
+  startNewFrame();
+  updateImage();
+}
+
+ImageRegion DRRViewport::imageRegion() const
+{
+  if (m_sequenceCapture || m_benchmark)
+    return {};
+  return m_imageRegion.snapped(m_viewportSize.x, m_viewportSize.y);
+}
+
+void DRRViewport::setImageRegionCallback(
+    std::function<void(const ImageRegion &)> callback)
+{
+  m_imageRegionCallback = std::move(callback);
+}
+
 void DRRViewport::getView(anari::math::float3& eye, anari::math::float3& center, anari::math::float3& up, float& fovy, float& aspect)
 {
   auto& e = m_camera.eye();
@@ -240,9 +288,16 @@ anari::Device DRRViewport::device() const
 
 void DRRViewport::setScatterFraction(float scatterFraction)
 {
-  anari::setParameter(m_device, m_renderers[m_currentRenderer], "scatterFraction", ANARI_FLOAT32, &scatterFraction);
-  anari::commitParameters(m_device, m_renderers[m_currentRenderer]);
-  
+  m_scatterFraction = scatterFraction;
+  if (scatterPostProcess()) {
+    // re-filter the cached primary image, no need to render again
+    applyScatter();
+    redisplay();
+    return;
+  }
+
+  updateRendererScatter();
+
   m_viewChanged = true;
   cancelFrame();
   updateCamera(true);
@@ -252,9 +307,15 @@ void DRRViewport::setScatterFraction(float scatterFraction)
 
 void DRRViewport::setScatterSigma(float scatterSigma)
 {
-  anari::setParameter(m_device, m_renderers[m_currentRenderer], "scatterSigma", ANARI_FLOAT32, &scatterSigma);
-  anari::commitParameters(m_device, m_renderers[m_currentRenderer]);
-  
+  m_scatterSigma = scatterSigma;
+  if (scatterPostProcess()) {
+    applyScatter();
+    redisplay();
+    return;
+  }
+
+  updateRendererScatter();
+
   m_viewChanged = true;
   cancelFrame();
   updateCamera(true);
@@ -262,26 +323,281 @@ void DRRViewport::setScatterSigma(float scatterSigma)
   updateImage();
 }
 
-bool DRRViewport::getFrame(std::vector<uint8_t>& color, std::vector<float>& depth3d, size_t& width, size_t& height)
+void DRRViewport::setColorFormat(anari::DataType format)
 {
-    auto fb = anari::map<uint32_t>(m_device, m_frame, "channel.color");
-    auto db = anari::map<anari::math::float3>(m_device, m_frame, "channel.origin");
+  if (format != ANARI_UFIXED8_RGBA_SRGB && format != ANARI_FLOAT32
+      && format != ANARI_UFIXED16) {
+    printf("WARNING: unsupported color format, keeping current one\n");
+    return;
+  }
+  if (format == m_format)
+    return;
 
-    if (fb.data && db.data) {
-      width = m_viewportSize.x;
-      height = m_viewportSize.y;
-      const auto fbDataU8 = reinterpret_cast<const uint8_t*>(fb.data);
-      const auto dbDataFloat = reinterpret_cast<const float*>(db.data);
-      color = std::vector<uint8_t>(fbDataU8, fbDataU8 + width * height * sizeof(uint32_t)); //TODO
-      depth3d = std::vector<float>(dbDataFloat, dbDataFloat + width * height * sizeof(anari::math::float3)/4); //TODO
-    } else {
-      printf("mapped bad frame: %p | %i x %i\n", fb.data, fb.width, fb.height);
-      return false;
+  m_format = format;
+  m_autoWindow = true;
+  // re-encode the cached frame so m_postColor matches the new layout
+  applyScatter();
+
+  allocateTexture();
+  updateFrame();
+  cancelFrame();
+  startNewFrame();
+  updateImage();
+}
+
+anari::DataType DRRViewport::colorFormat() const
+{
+  return m_format;
+}
+
+bool DRRViewport::isSingleChannel() const
+{
+  return m_format == ANARI_FLOAT32 || m_format == ANARI_UFIXED16;
+}
+
+void DRRViewport::setIntensityWindow(float lo, float hi)
+{
+  m_window = {lo, hi};
+  m_autoWindow = false;
+  redisplay();
+}
+
+bool DRRViewport::getFrame(std::vector<uint8_t>& color, anari::DataType& format, std::vector<float>& depth3d, size_t& width, size_t& height)
+{
+    anari::math::int2 size, originSize;
+    auto fb = mapColor(size);
+    auto db = mapOrigin(originSize);
+
+    bool ok = mappedFrameValid(fb, size, db, originSize);
+    if (ok) {
+      width = size.x;
+      height = size.y;
+      format = m_format;
+      const auto dbDataFloat = reinterpret_cast<const float*>(db);
+      color = std::vector<uint8_t>(fb, fb + width * height * anari::sizeOf(m_format));
+      depth3d = std::vector<float>(dbDataFloat, dbDataFloat + width * height * 3);
     }
 
-    anari::unmap(m_device, m_frame, "channel.color");
-    anari::unmap(m_device, m_frame, "channel.origin");
-    return true;
+    unmapColor();
+    unmapOrigin();
+    return ok;
+}
+
+bool DRRViewport::getFrameR8(std::vector<uint8_t>& gray, std::vector<float>& depth3d, size_t& width, size_t& height)
+{
+  if (!isSingleChannel())
+    return false;
+
+  anari::math::int2 size, originSize;
+  auto fb = mapColor(size);
+  auto db = mapOrigin(originSize);
+
+  bool ok = mappedFrameValid(fb, size, db, originSize);
+  if (ok) {
+    width = size.x;
+    height = size.y;
+    const size_t numPixels = width * height;
+    gray.resize(numPixels);
+    windowToR8(fb, numPixels, gray.data());
+    const auto dbDataFloat = reinterpret_cast<const float*>(db);
+    depth3d = std::vector<float>(dbDataFloat, dbDataFloat + numPixels * 3);
+  }
+
+  unmapColor();
+  unmapOrigin();
+  return ok;
+}
+
+bool DRRViewport::getExportFrame(std::vector<uint8_t>& pixels, size_t& components, size_t& width, size_t& height)
+{
+  anari::math::int2 size;
+  auto fb = mapColor(size);
+  if (!fb) {
+    unmapColor();
+    return false;
+  }
+
+  width = size.x;
+  height = size.y;
+  components = isSingleChannel() ? 1 : 3;
+  pixels.resize(width * height * components);
+  if (isSingleChannel()) {
+    // window in place, then mirror the rows
+    windowToR8(fb, width * height, pixels.data());
+    for (size_t y = 0; y < height; ++y)
+      std::reverse(pixels.begin() + y * width, pixels.begin() + (y + 1) * width);
+  } else
+    flipFrameForExport(fb, pixels.data(), width, height, 4);
+  unmapColor();
+  return true;
+}
+
+void DRRViewport::setCameraPath(const CameraPath &path)
+{
+  stopCameraPath();
+  m_cameraPath = path;
+}
+
+const CameraPath &DRRViewport::cameraPath() const
+{
+  return m_cameraPath;
+}
+
+void DRRViewport::playCameraPath(int numFrames, bool capture)
+{
+  if (m_cameraPath.size() < 2 || numFrames < 2)
+    return;
+
+  stopCameraPath();
+
+  m_sequenceFrames = numFrames;
+  m_sequenceFrame = 0;
+  m_sequencePlaying = true;
+  m_sequenceCapture = capture;
+
+  if (capture) {
+    // wait for frames still being encoded from a previous capture
+    m_sequenceWriter.reset();
+    m_sequenceDir = m_sequenceNames.next();
+    std::error_code ec;
+    std::filesystem::create_directories(m_sequenceDir, ec);
+    if (ec) {
+      printf("ERROR: could not create directory '%s'\n", m_sequenceDir.c_str());
+      m_sequencePlaying = m_sequenceCapture = false;
+      return;
+    }
+    m_sequenceWriter = std::make_unique<AsyncWriter>(
+        16, std::max(1u, std::thread::hardware_concurrency()));
+    m_sequenceWritten = 0;
+    m_sequenceFps = 0.f;
+    m_sequenceStart = std::chrono::steady_clock::now();
+    reshape(m_sequenceSize);
+  }
+
+  const auto key = m_cameraPath.sample(0.f);
+  setView(key.eye, key.center, key.up);
+}
+
+void DRRViewport::stopCameraPath()
+{
+  m_sequencePlaying = false;
+  m_sequenceCapture = false; // buildUI() restores the viewport size
+}
+
+void DRRViewport::advanceCameraPath()
+{
+  // playback moves on after the first sample, capture waits for convergence
+  const bool done = m_sequenceCapture
+      ? m_accumulation.converged() && !m_currentlyRendering
+      : m_accumulation.samples() > 0;
+  if (m_viewChanged || !done)
+    return;
+
+  if (m_sequenceCapture)
+    writeSequenceFrame();
+
+  if (++m_sequenceFrame >= m_sequenceFrames) {
+    stopCameraPath();
+    return;
+  }
+
+  const auto key =
+      m_cameraPath.sample(m_sequenceFrame / float(m_sequenceFrames - 1));
+  setView(key.eye, key.center, key.up);
+}
+
+void DRRViewport::writeSequenceFrame()
+{
+  std::vector<uint8_t> pixels;
+  size_t components, width, height;
+  if (!getExportFrame(pixels, components, width, height))
+    return;
+
+  char name[32];
+  std::snprintf(name, sizeof(name), "/frame-%05i.png", m_sequenceFrame);
+  std::string filename = m_sequenceDir + name;
+  const int total = m_sequenceFrames;
+  // the writer threads only touch their copies and the atomics
+  const std::string dir = m_sequenceDir;
+  const auto start = m_sequenceStart;
+
+  m_sequenceWriter->push([=, this, pixels = std::move(pixels)]() {
+    if (!writePng(filename, pixels.data(), components, width, height))
+      printf("ERROR: could not write '%s'\n", filename.c_str());
+
+    int written = ++m_sequenceWritten;
+    float seconds = std::chrono::duration<float>(
+        std::chrono::steady_clock::now() - start)
+                        .count();
+    const float fps = written / std::max(seconds, 1e-3f);
+    m_sequenceFps = fps;
+    if (written == total) {
+      printf("sequence written to '%s': %i frames, %.2f frames/s\n",
+          dir.c_str(),
+          written,
+          fps);
+    }
+  });
+}
+
+void DRRViewport::startBenchmark(const BenchmarkSpec &spec, BenchmarkInfo info)
+{
+  stopCameraPath();
+
+  anari::math::float3 eye, center, up;
+  float fovy, aspect;
+  getView(eye, center, up, fovy, aspect);
+
+  m_benchmarkPath = spec.cameraPath({eye, center, up});
+  m_benchmarkInfo = std::move(info);
+  m_benchmarkInfo.emplace_back("renderer",
+      m_useCpuRenderer ? "cpu-drr" : m_rendererNames[m_currentRenderer]);
+  m_benchmarkFrame = 0;
+  m_benchmarkFinished = false;
+  m_benchmark = std::make_unique<BenchmarkRecorder>(spec);
+
+  reshape({spec.width, spec.height});
+}
+
+bool DRRViewport::benchmarkFinished() const
+{
+  return m_benchmarkFinished;
+}
+
+bool DRRViewport::frameSettled() const
+{
+  return !m_viewChanged && !m_currentlyRendering && m_accumulation.converged();
+}
+
+void DRRViewport::runBenchmarkFrame()
+{
+  const auto &spec = m_benchmark->spec();
+  const auto key = spec.camera(m_benchmarkPath, m_benchmarkFrame);
+
+  // blocking on purpose: wall clock spans camera update to frame ready
+  auto start = std::chrono::steady_clock::now();
+  m_camera.look_at({key.eye.x, key.eye.y, key.eye.z},
+      {key.center.x, key.center.y, key.center.z},
+      {key.up.x, key.up.y, key.up.z});
+  m_viewChanged = true;
+  cancelFrame();
+  waitFrame();
+  updateCamera(true);
+  startNewFrame();
+  waitFrame();
+  updateImage();
+  float wallMs = std::chrono::duration<float, std::milli>(
+      std::chrono::steady_clock::now() - start)
+                     .count();
+
+  // m_latestFL holds the device's "duration" of the frame just consumed
+  m_benchmark->addFrame(m_benchmarkFrame, m_latestFL, wallMs);
+
+  if (++m_benchmarkFrame >= spec.totalFrames()) {
+    m_benchmark->write(m_benchmarkInfo);
+    m_benchmark.reset();
+    m_benchmarkFinished = true;
+  }
 }
 
 void DRRViewport::reshape(anari::math::int2 newSize)
@@ -293,16 +609,7 @@ void DRRViewport::reshape(anari::math::int2 newSize)
 
   glViewport(0, 0, newSize.x, newSize.y);
 
-  glBindTexture(GL_TEXTURE_2D, m_framebufferTexture);
-  glTexImage2D(GL_TEXTURE_2D,
-      0,
-      GL_RGBA8,
-      newSize.x,
-      newSize.y,
-      0,
-      GL_RGBA,
-      GL_UNSIGNED_BYTE,
-      0);
+  allocateTexture();
 
   m_camera.set_viewport(0, 0, newSize.x, newSize.y);
   float fovy = m_camera.fovy();
@@ -318,22 +625,428 @@ void DRRViewport::reshape(anari::math::int2 newSize)
   updateImage();
 }
 
+anari::math::int2 DRRViewport::frameSize() const
+{
+  const ImageRegion region = imageRegion();
+  return {region.pixelWidth(m_viewportSize.x),
+      region.pixelHeight(m_viewportSize.y)};
+}
+
+void DRRViewport::allocateTexture()
+{
+  glBindTexture(GL_TEXTURE_2D, m_framebufferTexture);
+
+  if (isSingleChannel()) {
+    // windowing happens in the pixel transfer on upload (see
+    // uploadTexture()), so a normalized 16 bit luminance texture suffices
+    GLint swizzle[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    glTexImage2D(GL_TEXTURE_2D,
+        0,
+        GL_R16,
+        m_viewportSize.x,
+        m_viewportSize.y,
+        0,
+        GL_RED,
+        GL_UNSIGNED_SHORT,
+        0);
+  } else {
+    GLint swizzle[] = {GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA};
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    glTexImage2D(GL_TEXTURE_2D,
+        0,
+        GL_RGBA8,
+        m_viewportSize.x,
+        m_viewportSize.y,
+        0,
+        GL_RGBA,
+        GL_UNSIGNED_BYTE,
+        0);
+  }
+}
+
+void DRRViewport::uploadTexture(const void *data, int width, int height)
+{
+  glBindTexture(GL_TEXTURE_2D, m_framebufferTexture);
+
+  if (!isSingleChannel()) {
+    glTexSubImage2D(GL_TEXTURE_2D,
+        0,
+        0,
+        0,
+        width,
+        height,
+        GL_RGBA,
+        GL_UNSIGNED_BYTE,
+        data);
+    return;
+  }
+
+  // map [lo, hi] to [0, 1]; GL normalizes 16 bit input before scale/bias
+  float range = m_window.y - m_window.x;
+  if (range == 0.f)
+    range = 1.f;
+  float scale = 1.f / range;
+  float bias = -m_window.x / range;
+  if (m_format == ANARI_UFIXED16)
+    scale *= 65535.f;
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelTransferf(GL_RED_SCALE, scale);
+  glPixelTransferf(GL_RED_BIAS, bias);
+  glTexSubImage2D(GL_TEXTURE_2D,
+      0,
+      0,
+      0,
+      width,
+      height,
+      GL_RED,
+      m_format == ANARI_FLOAT32 ? GL_FLOAT : GL_UNSIGNED_SHORT,
+      data);
+  glPixelTransferf(GL_RED_SCALE, 1.f);
+  glPixelTransferf(GL_RED_BIAS, 0.f);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void DRRViewport::redisplay()
+{
+  // re-upload the last frame (e.g., after the window changed) without
+  // rendering it again
+  anari::math::int2 size;
+  auto fb = mapColor(size);
+  if (fb) {
+    if (m_autoWindow && isSingleChannel())
+      computeAutoWindow(fb, size_t(size.x) * size.y);
+    uploadTexture(fb, size.x, size.y);
+  }
+  unmapColor();
+}
+
+void DRRViewport::computeAutoWindow(const void *data, size_t numPixels)
+{
+  float lo = std::numeric_limits<float>::max();
+  float hi = -std::numeric_limits<float>::max();
+  if (m_format == ANARI_FLOAT32) {
+    auto src = reinterpret_cast<const float *>(data);
+    for (size_t i = 0; i < numPixels; ++i) {
+      lo = std::min(lo, src[i]);
+      hi = std::max(hi, src[i]);
+    }
+  } else {
+    auto src = reinterpret_cast<const uint16_t *>(data);
+    for (size_t i = 0; i < numPixels; ++i) {
+      lo = std::min(lo, float(src[i]));
+      hi = std::max(hi, float(src[i]));
+    }
+  }
+  if (lo < hi)
+    m_window = {lo, hi};
+  m_autoWindow = false;
+}
+
+void DRRViewport::windowToR8(
+    const uint8_t *fb, size_t numPixels, uint8_t *gray) const
+{
+  // same degenerate-window guard as uploadTexture()
+  float range = m_window.y - m_window.x;
+  if (range == 0.f)
+    range = 1.f;
+  const float lo = m_window.x;
+  const float scale = 255.f / range;
+  auto window = [=](float v) -> uint8_t {
+    return uint8_t(std::clamp((v - lo) * scale, 0.f, 255.f));
+  };
+  if (m_format == ANARI_FLOAT32) {
+    auto src = reinterpret_cast<const float *>(fb);
+    for (size_t i = 0; i < numPixels; ++i)
+      gray[i] = window(src[i]);
+  } else {
+    auto src = reinterpret_cast<const uint16_t *>(fb);
+    for (size_t i = 0; i < numPixels; ++i)
+      gray[i] = window(src[i]);
+  }
+}
+
+void DRRViewport::setCpuRendererField(const StructuredField *field)
+{
+  if (!m_cpuRenderer) {
+    m_cpuRenderer = std::make_unique<CpuDrrRenderer>();
+    m_cpuRenderer->setStepSize(m_cpuStepSize);
+  }
+  waitFrame();
+  m_cpuRenderer->setField(field);
+  if (m_useCpuRenderer)
+    m_viewChanged = true;
+}
+
+void DRRViewport::setVolumeOfInterest(const VolumeOfInterest &voi)
+{
+  m_volumeOfInterest = voi;
+  if (m_cpuRenderer) {
+    cancelFrame();
+    waitFrame();
+    m_cpuRenderer->setVolumeOfInterest(voi);
+  }
+  // ANARI devices render the field the callback uploaded
+  m_viewChanged = true;
+}
+
+void DRRViewport::setVolumeOfInterestCallback(
+    std::function<void(const VolumeOfInterest &)> callback)
+{
+  m_volumeOfInterestCallback = std::move(callback);
+}
+
+void DRRViewport::setUseCpuRenderer(bool useCpuRenderer)
+{
+  if (useCpuRenderer && !m_cpuRenderer)
+    return;
+
+  cancelFrame();
+  waitFrame();
+  m_useCpuRenderer = useCpuRenderer;
+  m_singleShot = true;
+  updateFrame();
+  startNewFrame();
+  updateImage();
+}
+
+void DRRViewport::startCpuFrame()
+{
+  if (m_cpuFuture.valid())
+    m_cpuFuture.wait();
+  m_cpuCancel = false;
+  m_frameSamples = 1;
+
+  CpuDrrCamera camera;
+  const auto &e = m_camera.eye();
+  const auto &c = m_camera.center();
+  const auto &u = m_camera.up();
+  camera.eye = {e.x, e.y, e.z};
+  camera.center = {c.x, c.y, c.z};
+  camera.up = {u.x, u.y, u.z};
+  const ImageRegion region = imageRegion();
+  camera.fovy = region.fovy(m_fov * M_PI / 180.f);
+  camera.aspect = region.aspect(m_viewportSize.x / float(m_viewportSize.y));
+
+  const auto size = frameSize();
+
+  m_cpuFuture = std::async(std::launch::async, [=, this]() {
+    auto start = std::chrono::steady_clock::now();
+    if (!m_cpuRenderer->render(camera, size.x, size.y, m_cpuFrame, &m_cpuCancel))
+      return false;
+    m_cpuDuration = std::chrono::duration<float>(
+        std::chrono::steady_clock::now() - start).count();
+    return true;
+  });
+}
+
+bool DRRViewport::frameReady()
+{
+  if (m_useCpuRenderer) {
+    return !m_cpuFuture.valid()
+        || m_cpuFuture.wait_for(std::chrono::seconds(0))
+        == std::future_status::ready;
+  }
+  return anari::isReady(m_device, m_frame);
+}
+
+void DRRViewport::waitFrame()
+{
+  if (m_cpuFuture.valid())
+    m_cpuFuture.wait();
+  if (!m_useCpuRenderer)
+    anari::wait(m_device, m_frame);
+}
+
+float DRRViewport::frameDuration()
+{
+  if (m_useCpuRenderer)
+    return m_cpuDuration;
+  float duration = 0.f;
+  anari::getProperty(m_device, m_frame, "duration", duration);
+  return duration;
+}
+
+const uint8_t *DRRViewport::mapColor(anari::math::int2 &size)
+{
+  if (scatterPostProcess()) {
+    size = m_primarySize;
+    return m_postColor.empty() ? nullptr : m_postColor.data();
+  }
+  return mapRawColor(size);
+}
+
+void DRRViewport::unmapColor()
+{
+  if (!scatterPostProcess())
+    unmapRawColor();
+}
+
+const uint8_t *DRRViewport::mapRawColor(anari::math::int2 &size)
+{
+  if (m_useCpuRenderer) {
+    waitFrame();
+    size = {m_cpuFrame.width, m_cpuFrame.height};
+    return m_cpuFrame.lineIntegral.empty()
+        ? nullptr
+        : reinterpret_cast<const uint8_t *>(m_cpuFrame.lineIntegral.data());
+  }
+  auto fb = anari::map<uint8_t>(m_device, m_frame, "channel.color");
+  size = {int(fb.width), int(fb.height)};
+  return fb.data;
+}
+
+void DRRViewport::unmapRawColor()
+{
+  if (!m_useCpuRenderer)
+    anari::unmap(m_device, m_frame, "channel.color");
+}
+
+const anari::math::float3 *DRRViewport::mapOrigin(anari::math::int2 &size)
+{
+  if (m_useCpuRenderer) {
+    waitFrame();
+    size = {m_cpuFrame.width, m_cpuFrame.height};
+    return m_cpuFrame.origin.empty() ? nullptr : m_cpuFrame.origin.data();
+  }
+  auto ob =
+      anari::map<anari::math::float3>(m_device, m_frame, "channel.origin");
+  size = {int(ob.width), int(ob.height)};
+  return ob.data;
+}
+
+void DRRViewport::unmapOrigin()
+{
+  if (!m_useCpuRenderer)
+    anari::unmap(m_device, m_frame, "channel.origin");
+}
+
+bool DRRViewport::mappedFrameValid(const void *color,
+    anari::math::int2 colorSize,
+    const void *origin,
+    anari::math::int2 originSize) const
+{
+  const auto expected = frameSize();
+  if (color && origin && colorSize == originSize && colorSize == expected)
+    return true;
+  printf("mapped bad frame: %p %i x %i | origin %p %i x %i | expected %i x %i\n",
+      color,
+      colorSize.x,
+      colorSize.y,
+      origin,
+      originSize.x,
+      originSize.y,
+      expected.x,
+      expected.y);
+  return false;
+}
+
+bool DRRViewport::scatterPostProcess() const
+{
+  // needs the primary (unscattered) signal: the CPU renderer and the
+  // single-channel outputs provide it, sRGB output is scattered by the device
+  return m_useCpuRenderer || isSingleChannel();
+}
+
+void DRRViewport::updateRendererScatter()
+{
+  if (m_renderers.empty())
+    return;
+  auto renderer = m_renderers[m_currentRenderer];
+  float fraction = scatterPostProcess() ? 0.f : m_scatterFraction;
+  anari::setParameter(m_device, renderer, "scatterFraction", ANARI_FLOAT32, &fraction);
+  anari::setParameter(m_device, renderer, "scatterSigma", ANARI_FLOAT32, &m_scatterSigma);
+  anari::commitParameters(m_device, renderer);
+}
+
+void DRRViewport::capturePrimary()
+{
+  // primary intensity from the line integral (CPU renderer, ANARI_FLOAT32)
+  // or the linear intensity (ANARI_UFIXED16)
+  anari::math::int2 size;
+  auto fb = mapRawColor(size);
+  if (fb) {
+    const size_t numPixels = size_t(size.x) * size.y;
+    m_primary.resize(numPixels);
+    m_primarySize = size;
+    if (m_useCpuRenderer || m_format == ANARI_FLOAT32) {
+      auto L = reinterpret_cast<const float *>(fb);
+      for (size_t i = 0; i < numPixels; ++i)
+        m_primary[i] = std::exp(-L[i]);
+    } else {
+      auto I = reinterpret_cast<const uint16_t *>(fb);
+      for (size_t i = 0; i < numPixels; ++i)
+        m_primary[i] = I[i] * (1.f / 65535.f);
+    }
+  }
+  unmapRawColor();
+}
+
+void DRRViewport::applyScatter()
+{
+  // I = (1 - f) * P + f * (G_sigma * P), encoded in m_format
+  const size_t numPixels = m_primary.size();
+  if (numPixels == 0)
+    return;
+
+  std::vector<float> I = m_primary;
+  if (m_scatterFraction > 0.f) {
+    std::vector<float> scatter = m_primary;
+    recursiveGaussian(scatter.data(),
+        m_primarySize.x,
+        m_primarySize.y,
+        m_scatterSigma,
+        m_scatterWorkers);
+    const float f = m_scatterFraction;
+    for (size_t i = 0; i < numPixels; ++i)
+      I[i] = (1.f - f) * I[i] + f * scatter[i];
+  }
+
+  m_postColor.resize(numPixels * anari::sizeOf(m_format));
+  if (m_format == ANARI_FLOAT32) {
+    auto dst = reinterpret_cast<float *>(m_postColor.data());
+    for (size_t i = 0; i < numPixels; ++i)
+      dst[i] = -std::log(std::max(I[i], 1e-30f));
+  } else if (m_format == ANARI_UFIXED16) {
+    auto dst = reinterpret_cast<uint16_t *>(m_postColor.data());
+    for (size_t i = 0; i < numPixels; ++i)
+      dst[i] = uint16_t(std::clamp(I[i], 0.f, 1.f) * 65535.f + .5f);
+  } else {
+    auto srgb = [](float v) {
+      v = v <= 0.0031308f ? 12.92f * v : 1.055f * std::pow(v, 1.f / 2.4f) - 0.055f;
+      return uint8_t(std::clamp(v, 0.f, 1.f) * 255.f + .5f);
+    };
+    for (size_t i = 0; i < numPixels; ++i) {
+      uint8_t g = srgb(1.f - I[i]);
+      m_postColor[i * 4 + 0] = g;
+      m_postColor[i * 4 + 1] = g;
+      m_postColor[i * 4 + 2] = g;
+      m_postColor[i * 4 + 3] = 255;
+    }
+  }
+}
+
 void DRRViewport::startNewFrame()
 {
-  anari::getProperty(
-      m_device, m_frame, "numSamples", m_frameSamples, ANARI_NO_WAIT);
-  anari::render(m_device, m_frame);
-  m_renderSize = m_viewportSize;
+  if (m_useCpuRenderer)
+    startCpuFrame();
+  else {
+    anari::getProperty(
+        m_device, m_frame, "numSamples", m_frameSamples, ANARI_NO_WAIT);
+    anari::render(m_device, m_frame);
+  }
+  m_renderSize = frameSize();
   m_currentlyRendering = true;
   m_frameCancelled = false;
+  m_staleFrame = false;
 }
 
 void DRRViewport::updateFrame()
 {
   anari::setParameter(
-      m_device, m_frame, "size", anari::math::uint2(m_viewportSize));
-  anari::setParameter(
-      m_device, m_frame, "channel.color", ANARI_UFIXED8_RGBA_SRGB);
+      m_device, m_frame, "size", anari::math::uint2(frameSize()));
+  anari::setParameter(m_device, m_frame, "channel.color", m_format);
   anari::setParameter(
       m_device, m_frame, "channel.depth", ANARI_FLOAT32);
   anari::setParameter(
@@ -345,6 +1058,9 @@ void DRRViewport::updateFrame()
       m_device, m_frame, "renderer", m_renderers[m_currentRenderer]);
 
   anari::commitParameters(m_device, m_frame);
+
+  updateRendererScatter();
+  resetAccumulation();
 }
 
 void DRRViewport::updateCamera(bool force)
@@ -367,64 +1083,98 @@ void DRRViewport::updateCamera(bool force)
   auto radians = [](float degrees) -> float { return degrees * M_PI / 180.f; };
   anari::setParameter(m_device, m_perspCamera, "fovy", radians(m_fov));
 
+  // the frame covers only the region, at the same pixel density
+  const ImageRegion region = imageRegion();
+  anari::math::float2 imageBox[2] = {
+      {.5f - .5f * region.width, .5f - .5f * region.height},
+      {.5f + .5f * region.width, .5f + .5f * region.height}};
+  anari::setParameter(
+      m_device, m_perspCamera, "imageRegion", ANARI_FLOAT32_BOX2, &imageBox[0]);
+
   anari::commitParameters(m_device, m_perspCamera);
 
   m_viewChanged = false;
+  resetAccumulation();
   return;
 }
 
+void DRRViewport::resetAccumulation()
+{
+  // a frame still in flight was started with the old parameters: it is
+  // displayed when done but doesn't count towards convergence
+  m_staleFrame = m_currentlyRendering;
+  m_accumulation.sampleBudget = m_singleShot ? 1 : m_sampleBudget;
+  m_accumulation.threshold = m_convergenceThreshold;
+  m_accumulation.reset();
+}
+
 void DRRViewport::updateImage()
 {
   if (m_frameCancelled)
-    anari::wait(m_device, m_frame);
+    waitFrame();
   else if (m_saveNextFrame
-      || (m_currentlyRendering && anari::isReady(m_device, m_frame))) {
+      || (m_currentlyRendering && frameReady())) {
+    // a screenshot may re-map a frame that was already accumulated
+    const bool newFrame = m_currentlyRendering && !m_staleFrame;
     m_currentlyRendering = false;
 
-    float duration = 0.f;
-    anari::getProperty(m_device, m_frame, "duration", duration);
-
-    m_latestFL = duration * 1000;
+    m_latestFL = frameDuration() * 1000;
     m_minFL = std::min(m_minFL, m_latestFL);
     m_maxFL = std::max(m_maxFL, m_latestFL);
 
-    auto fb = anari::map<uint32_t>(m_device, m_frame, "channel.color");
-
-    if (fb.data) {
-      glBindTexture(GL_TEXTURE_2D, m_framebufferTexture);
-      glTexSubImage2D(GL_TEXTURE_2D,
-          0,
-          0,
-          0,
-          fb.width,
-          fb.height,
-          GL_RGBA,
-          GL_UNSIGNED_BYTE,
-          fb.data);
+    if (scatterPostProcess()) {
+      capturePrimary();
+      applyScatter();
+    }
+
+    anari::math::int2 size;
+    auto fb = mapColor(size);
+
+    if (fb) {
+      if (m_autoWindow && isSingleChannel())
+        computeAutoWindow(fb, size_t(size.x) * size.y);
+      uploadTexture(fb, size.x, size.y);
+      if (newFrame)
+        m_accumulation.addFrame(fb, size_t(size.x) * size.y, m_format);
     } else {
-      printf("mapped bad frame: %p | %i x %i\n", fb.data, fb.width, fb.height);
+      printf("mapped bad frame: %p | %i x %i\n", fb, size.x, size.y);
     }
 
-    if (m_saveNextFrame) {
+    if (m_saveNextFrame && fb) {
       std::string filename =
           "screenshot" + std::to_string(m_screenshotIndex++) + ".png";
-      stbi_write_png(
-          filename.c_str(), fb.width, fb.height, 4, fb.data, 4 * fb.width);
+      if (isSingleChannel()) {
+        std::vector<uint8_t> gray(size_t(size.x) * size.y);
+        glBindTexture(GL_TEXTURE_2D, m_framebufferTexture);
+        glGetTexImage(
+            GL_TEXTURE_2D, 0, GL_RED, GL_UNSIGNED_BYTE, gray.data());
+        stbi_write_png(
+            filename.c_str(), size.x, size.y, 1, gray.data(), size.x);
+      } else {
+        stbi_write_png(
+            filename.c_str(), size.x, size.y, 4, fb, 4 * size.x);
+      }
       printf("frame saved to '%s'\n", filename.c_str());
       m_saveNextFrame = false;
     }
 
-    anari::unmap(m_device, m_frame, "channel.color");
+    unmapColor();
   }
 
-  if (!m_currentlyRendering || m_frameCancelled)
+  // stop issuing frames once accumulation converged
+  if (m_frameCancelled
+      || (!m_currentlyRendering && !m_accumulation.converged()))
     startNewFrame();
 }
 
 void DRRViewport::cancelFrame()
 {
   m_frameCancelled = true;
-  anari::discard(m_device, m_frame);
+  resetAccumulation();
+  if (m_useCpuRenderer)
+    m_cpuCancel = true;
+  else
+    anari::discard(m_device, m_frame);
 }
 
 void DRRViewport::handleMouseDownEvent(visionaray::mouse_event const& event)
@@ -580,29 +1330,52 @@ void DRRViewport::ui_contextMenu()
     ImGui::Text("Renderer:");
     ImGui::Indent(INDENT_AMOUNT);
 
-    if (m_renderers.size() > 1 && ImGui::BeginMenu("subtype")) {
+    if ((m_renderers.size() > 1 || m_cpuRenderer)
+        && ImGui::BeginMenu("subtype")) {
       for (int i = 0; i < m_rendererNames.size(); i++) {
         const auto& rendererName = m_rendererNames[i];
-        if (ImGui::MenuItem(rendererName.c_str())) {
+        if (ImGui::MenuItem(rendererName.c_str(), nullptr,
+                !m_useCpuRenderer && i == m_currentRenderer)) {
           if ((rendererName == "DRR") || (rendererName == "drr") || (rendererName == "default"))
             m_singleShot = true;
           else
             m_singleShot = false;
+          cancelFrame();
+          waitFrame();
+          m_useCpuRenderer = false;
           m_currentRenderer = i;
           updateFrame();
-          cancelFrame();
           startNewFrame();
           updateImage();
         }
       }
+      if (m_cpuRenderer
+          && ImGui::MenuItem("cpu-drr", nullptr, m_useCpuRenderer))
+        setUseCpuRenderer(true);
       ImGui::EndMenu();
     }
 
-    if (!m_rendererParameters.empty() && ImGui::BeginMenu("parameters")) {
+    if (m_useCpuRenderer && ImGui::BeginMenu("parameters")) {
+      int sampling = static_cast<int>(m_cpuRenderer->sampling());
+      const char *samplingNames[] = {"siddon", "trilinear"};
+      if (ImGui::Combo("sampling", &sampling, samplingNames, 2)) {
+        m_cpuRenderer->setSampling(
+            static_cast<CpuDrrRenderer::Sampling>(sampling));
+        m_viewChanged = true;
+      }
+      if (ImGui::SliderFloat("step size [voxels]", &m_cpuStepSize, .1f, 2.f)) {
+        m_cpuRenderer->setStepSize(m_cpuStepSize);
+        m_viewChanged = true;
+      }
+      ImGui::EndMenu();
+    } else if (!m_useCpuRenderer && !m_rendererParameters.empty()
+        && ImGui::BeginMenu("parameters")) {
       auto &parameters = m_rendererParameters[m_currentRenderer];
       auto renderer = m_renderers[m_currentRenderer];
-      for (auto &p : parameters)
-        anari_viewer::ui::buildUI(m_device, renderer, p);
+      for (auto &p : parameters) {
+        if (anari_viewer::ui::buildUI(m_device, renderer, p))
+          resetAccumulation();
+      }
       ImGui::EndMenu();
     }
 
@@ -626,12 +1399,126 @@ void DRRViewport::ui_contextMenu()
     if (ImGui::MenuItem("reset view"))
       resetView();
 
+    // Ctrl+drag draws it
+    if (ImGui::MenuItem("clear image region", nullptr, false, !m_imageRegion.full())) {
+      setImageRegion({});
+      if (m_imageRegionCallback)
+        m_imageRegionCallback(m_imageRegion);
+    }
+
     ImGui::Unindent(INDENT_AMOUNT);
     ImGui::Separator();
 
     ImGui::Text("DRRViewport:");
     ImGui::Indent(INDENT_AMOUNT);
 
+    if (ImGui::BeginMenu("output")) {
+      if (ImGui::MenuItem("RGBA8 (sRGB)", nullptr, m_format == ANARI_UFIXED8_RGBA_SRGB))
+        setColorFormat(ANARI_UFIXED8_RGBA_SRGB);
+      if (ImGui::MenuItem("line integral (float32)", nullptr, m_format == ANARI_FLOAT32))
+        setColorFormat(ANARI_FLOAT32);
+      if (ImGui::MenuItem("intensity (uint16)", nullptr, m_format == ANARI_UFIXED16))
+        setColorFormat(ANARI_UFIXED16);
+      ImGui::EndMenu();
+    }
+
+    if (m_cpuRenderer && m_cpuRenderer->field()
+        && ImGui::BeginMenu("volume of interest")) {
+      if (m_hasLandmark)
+        ImGui::Text("landmark: (%.1f, %.1f, %.1f)",
+            m_landmark.x,
+            m_landmark.y,
+            m_landmark.z);
+      else
+        ImGui::TextDisabled("Shift+click a point in two views to pick one");
+      ImGui::DragFloat3("half extent", &m_voiHalfExtent.x, .5f, 0.f, 1e4f);
+      if (ImGui::MenuItem("box around landmark", nullptr, false, m_hasLandmark)) {
+        auto voi = VolumeOfInterest::around(
+            *m_cpuRenderer->field(), m_landmark, m_voiHalfExtent);
+        if (voi.empty())
+          printf("volume of interest: the box misses the volume\n");
+        else if (m_volumeOfInterestCallback)
+          m_volumeOfInterestCallback(voi);
+        else
+          setVolumeOfInterest(voi);
+      }
+      if (ImGui::MenuItem(
+              "whole volume", nullptr, false, !m_volumeOfInterest.empty())) {
+        if (m_volumeOfInterestCallback)
+          m_volumeOfInterestCallback({});
+        else
+          setVolumeOfInterest({});
+      }
+      if (!m_volumeOfInterest.empty()) {
+        const auto &v = m_volumeOfInterest;
+        ImGui::Text("voxels: [%i, %i] x [%i, %i] x [%i, %i]",
+            v.lo[0],
+            v.hi[0],
+            v.lo[1],
+            v.hi[1],
+            v.lo[2],
+            v.hi[2]);
+      }
+      ImGui::EndMenu();
+    }
+
+    if (isSingleChannel()) {
+      const float speed = m_format == ANARI_UFIXED16 ? 10.f : 0.01f;
+      if (ImGui::DragFloatRange2("window", &m_window.x, &m_window.y, speed))
+        redisplay();
+      if (ImGui::MenuItem("auto window")) {
+        m_autoWindow = true;
+        redisplay();
+      }
+    }
+
+    if (!m_singleShot) {
+      if (ImGui::SliderFloat("convergence threshold",
+              &m_convergenceThreshold,
+              1e-5f,
+              1e-1f,
+              "%.1e",
+              ImGuiSliderFlags_Logarithmic))
+        resetAccumulation();
+      if (ImGui::SliderInt("sample budget", &m_sampleBudget, 1, 4096))
+        resetAccumulation();
+    }
+
+    if (ImGui::BeginMenu("camera path")) {
+      ImGui::Text("keyframes: %zu", m_cameraPath.size());
+      if (ImGui::MenuItem("add current view")) {
+        anari::math::float3 eye, center, up;
+        float fovy, aspect;
+        getView(eye, center, up, fovy, aspect);
+        m_cameraPath.addKey({eye, center, up});
+      }
+      ImGui::SliderFloat("sweep angle", &m_sweepAngle, -360.f, 360.f, "%.0f deg");
+      if (ImGui::MenuItem("sweep around current view")) {
+        anari::math::float3 eye, center, up;
+        float fovy, aspect;
+        getView(eye, center, up, fovy, aspect);
+        setCameraPath(CameraPath::orbit({eye, center, up}, m_sweepAngle));
+      }
+      if (ImGui::MenuItem("clear"))
+        setCameraPath(CameraPath());
+      ImGui::Separator();
+      ImGui::InputInt("frames", &m_sequenceFrames);
+      m_sequenceFrames = std::max(m_sequenceFrames, 2);
+      ImGui::InputInt2("resolution", &m_sequenceSize.x);
+      m_sequenceSize.x = std::max(m_sequenceSize.x, 1);
+      m_sequenceSize.y = std::max(m_sequenceSize.y, 1);
+      if (m_sequencePlaying) {
+        if (ImGui::MenuItem("stop"))
+          stopCameraPath();
+      } else if (m_cameraPath.size() > 1) {
+        if (ImGui::MenuItem("play"))
+          playCameraPath(m_sequenceFrames, false);
+        if (ImGui::MenuItem("record image sequence"))
+          playCameraPath(m_sequenceFrames, true);
+      }
+      ImGui::EndMenu();
+    }
+
     ImGui::Checkbox("show stats", &m_showOverlay);
     if (ImGui::MenuItem("reset stats")) {
       m_minFL = m_latestFL;
@@ -693,7 +1580,32 @@ void DRRViewport::ui_overlay()
   ImGui::Begin(m_overlayWindowName.c_str(), nullptr, window_flags);
 
   ImGui::Text("viewport: %i x %i", m_viewportSize.x, m_viewportSize.y);
-  ImGui::Text(" samples: %i", m_frameSamples);
+  if (!imageRegion().full())
+    ImGui::Text("  region: %i x %i", frameSize().x, frameSize().y);
+  ImGui::Text(" samples: %i / %i (device: %i)",
+      m_accumulation.samples(),
+      m_accumulation.sampleBudget,
+      m_frameSamples);
+  if (m_accumulation.converged())
+    ImGui::Text("  status: converged");
+  else if (m_accumulation.samples() > 1)
+    ImGui::Text("  status: accumulating (change %.2e)", m_accumulation.change());
+  else
+    ImGui::Text("  status: accumulating");
+
+  if (m_sequencePlaying) {
+    ImGui::Text("    path: frame %i / %i", m_sequenceFrame + 1, m_sequenceFrames);
+  }
+  if (m_benchmark) {
+    ImGui::Text("   bench: frame %i / %i",
+        m_benchmarkFrame + 1,
+        m_benchmark->spec().totalFrames());
+  }
+  if (m_sequenceWriter && m_sequenceWritten > 0) {
+    ImGui::Text(" written: %i frames, %.2f frames/s",
+        m_sequenceWritten.load(),
+        m_sequenceFps.load());
+  }
 
   if (m_currentlyRendering)
     ImGui::Text(" latency: %.2fms", m_latestFL);
@@ -741,15 +1653,64 @@ void DRRViewport::ui_picking()
   }
 }
 
+bool DRRViewport::ui_regionSelect()
+{
+  const ImGuiIO &io = ImGui::GetIO();
+  if (!m_selectingRegion) {
+    const bool startSelect = ImGui::IsMouseClicked(ImGuiMouseButton_Left)
+        && io.KeysDown[GLFW_KEY_LEFT_CONTROL] && ImGui::IsItemHovered()
+        && !m_dolly && !m_pan && !m_orbit;
+    if (!startSelect)
+      return false;
+    m_selectingRegion = true;
+    m_regionStart = {io.MousePos.x, io.MousePos.y};
+  }
+
+  const ImVec2 wMin = ImGui::GetItemRectMin();
+  const ImVec2 wMax = ImGui::GetItemRectMax();
+  auto clamped = [&](float x, float y) {
+    return ImVec2(std::clamp(x, wMin.x, wMax.x), std::clamp(y, wMin.y, wMax.y));
+  };
+  const ImVec2 a = clamped(m_regionStart.x, m_regionStart.y);
+  const ImVec2 b = clamped(io.MousePos.x, io.MousePos.y);
+  ImGui::GetWindowDrawList()->AddRect(a, b, IM_COL32(255, 200, 0, 255));
+
+  if (ImGui::IsMouseDown(ImGuiMouseButton_Left))
+    return true;
+
+  // the rectangle is widened to a centered region, a click without dragging
+  // selects the whole view
+  m_selectingRegion = false;
+  ImageRegion region;
+  if (std::abs(b.x - a.x) >= 4.f && std::abs(b.y - a.y) >= 4.f) {
+    const float w = std::max(wMax.x - wMin.x, 1.f);
+    const float h = std::max(wMax.y - wMin.y, 1.f);
+    region = ImageRegion::enclosing((a.x - wMin.x) / w,
+        (a.y - wMin.y) / h,
+        (b.x - wMin.x) / w,
+        (b.y - wMin.y) / h);
+  }
+  setImageRegion(region);
+  if (m_imageRegionCallback)
+    m_imageRegionCallback(m_imageRegion);
+  return true;
+}
+
 void DRRViewport::pick(anari::math::int2 pixel)
 {
   // estimated origin:
-  auto ob = anari::map<anari::math::float3>(m_device, m_frame, "channel.origin");
-  if (ob.data) {
-    auto origin = ob.data[m_viewportSize.x * pixel.y + pixel.x];
+  // the frame covers the image region only
+  const auto frame = frameSize();
+  const anari::math::int2 framePixel(pixel.x - (m_viewportSize.x - frame.x) / 2,
+      pixel.y - (m_viewportSize.y - frame.y) / 2);
+  anari::math::int2 originSize;
+  auto ob = mapOrigin(originSize);
+  if (ob && originSize == frame && framePixel.x >= 0 && framePixel.x < frame.x
+      && framePixel.y >= 0 && framePixel.y < frame.y) {
+    auto origin = ob[frame.x * framePixel.y + framePixel.x];
     printf("origin: (%f, %f, %f)\n", origin.x, origin.y, origin.z);
   }
-  anari::unmap(m_device, m_frame, "channel.origin");
+  unmapOrigin();
 
   // make ray
   m_camera.begin_frame();
@@ -773,6 +1734,8 @@ void DRRViewport::pick(anari::math::int2 pixel)
     auto midpoint = (p1 + p2) / 2.f;
     auto distance = norm(p2 - p1);
     printf("calculated coordinate: (%f, %f, %f)\n", midpoint.x, midpoint.y, midpoint.z);
+    m_landmark = {midpoint.x, midpoint.y, midpoint.z};
+    m_hasLandmark = true;
     printf("distance between rays: %f\n", distance);
     m_pickedRays.clear();
   }
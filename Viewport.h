@@ -17,9 +17,22 @@
 #include <visionaray/math/ray.h>
 // std
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
 #include <limits>
 #include <memory>
 // ours
+#include "AccumulationController.h"
+#include "Benchmark.h"
+#include "CameraPath.h"
+#include "CpuDrrRenderer.h"
+#include "FieldTypes.h"
+#include "ImageRegion.h"
+#include "ScreenshotWriter.h"
+#include "VolumeOfInterest.h"
+#include "WorkerPool.h"
 #include "ui_anari.h"
 #include "Window.h"
 
@@ -44,24 +57,99 @@ struct DRRViewport : public anari_viewer::windows::Window
   void setDefaultFovYDeg(float fovyDeg);
   void setScatterFraction(float scatterFraction);
   void setScatterSigma(float scatterSigma);
-  bool getFrame(std::vector<uint8_t>& color, std::vector<float>& depth3d, size_t& width, size_t& height);
+  // ANARI_UFIXED8_RGBA_SRGB (default), ANARI_FLOAT32 (line integral) or
+  // ANARI_UFIXED16 (linear intensity)
+  void setColorFormat(anari::DataType format);
+  anari::DataType colorFormat() const;
+  bool isSingleChannel() const;
+  // display window [lo, hi] in units of the single-channel output
+  void setIntensityWindow(float lo, float hi);
+  bool getFrame(std::vector<uint8_t>& color, anari::DataType& format, std::vector<float>& depth3d, size_t& width, size_t& height);
+  // single plane, windowed to 8 bit (single-channel output only)
+  bool getFrameR8(std::vector<uint8_t>& gray, std::vector<float>& depth3d, size_t& width, size_t& height);
+  // the frame as displayed, ready to encode: columns un-mirrored, windowed R8
+  // for single-channel output and RGB8 otherwise (components 1 or 3); no
+  // depth
+  bool getExportFrame(std::vector<uint8_t>& pixels, size_t& components, size_t& width, size_t& height);
   void pick(anari::math::int2 pixel);
+  // render (and hand out through getFrame()) only a centered region of the
+  // view, see ImageRegion.h; Ctrl+drag in the viewport draws one
+  void setImageRegion(const ImageRegion &region);
+  // the region rendered, snapped to whole pixels
+  ImageRegion imageRegion() const;
+  void setImageRegionCallback(std::function<void(const ImageRegion &)> callback);
+  // make the in-tree CPU ray caster available as renderer "cpu-drr"
+  void setCpuRendererField(const StructuredField *field);
+  // restrict the CPU renderer to voi and render again; the context menu
+  // offers a box around the landmark triangulated by pick() and hands it to
+  // the callback (applies it directly without one)
+  void setVolumeOfInterest(const VolumeOfInterest &voi);
+  void setVolumeOfInterestCallback(
+      std::function<void(const VolumeOfInterest &)> callback);
+  void setUseCpuRenderer(bool useCpuRenderer);
+  // camera path playback; with capture every frame is rendered at the
+  // sequence resolution until converged and written as PNG
+  void setCameraPath(const CameraPath &path);
+  const CameraPath &cameraPath() const;
+  void playCameraPath(int numFrames, bool capture);
+  void stopCameraPath();
+  // scripted benchmark along spec's path from the current view; every frame
+  // is rendered at the spec's size and waited for, results are written
+  // when done
+  void startBenchmark(const BenchmarkSpec &spec, BenchmarkInfo info = {});
+  bool benchmarkFinished() const;
+  // the image at the current view is complete: accumulation converged and
+  // no frame in flight
+  bool frameSettled() const;
 
   anari::Device device() const;
 
  private:
   void reshape(anari::math::int2 newWindowSize);
+  // rendered frame size, the image region's part of the viewport
+  anari::math::int2 frameSize() const;
+  void allocateTexture();
+  void uploadTexture(const void *data, int width, int height);
+  void redisplay();
+  void computeAutoWindow(const void *data, size_t numPixels);
+  void windowToR8(const uint8_t *fb, size_t numPixels, uint8_t *gray) const;
 
   void startNewFrame();
   void updateFrame();
   void updateCamera(bool force = false);
+  void resetAccumulation();
   void updateImage();
   void cancelFrame();
+  void startCpuFrame();
+  bool scatterPostProcess() const;
+  void updateRendererScatter();
+  void capturePrimary();
+  void applyScatter();
+  bool frameReady();
+  void waitFrame();
+  float frameDuration();
+  const uint8_t *mapColor(anari::math::int2 &size);
+  void unmapColor();
+  const uint8_t *mapRawColor(anari::math::int2 &size);
+  void unmapRawColor();
+  const anari::math::float3 *mapOrigin(anari::math::int2 &size);
+  void unmapOrigin();
+  // color and origin of the same frame, at the current frameSize(); logs
+  // a mismatch (e.g. a snapshot after a reshape, before the next capture)
+  bool mappedFrameValid(const void *color,
+      anari::math::int2 colorSize,
+      const void *origin,
+      anari::math::int2 originSize) const;
+  void advanceCameraPath();
+  void writeSequenceFrame();
+  void runBenchmarkFrame();
 
   void ui_handleInput();
   void ui_contextMenu();
   void ui_overlay();
   void ui_picking();
+  // Ctrl+drag draws the image region, true while dragging
+  bool ui_regionSelect();
 
   void handleMouseDownEvent(visionaray::mouse_event const& event);
   void handleMouseUpEvent(visionaray::mouse_event const& event);
@@ -88,15 +176,67 @@ struct DRRViewport : public anari_viewer::windows::Window
   int m_frameSamples{0};
   bool m_singleShot{true};
 
+  // progressive rendering stops once converged
+  AccumulationController m_accumulation;
+  bool m_staleFrame{false};
+  float m_convergenceThreshold{1e-3f};
+  int m_sampleBudget{1024};
+
   float m_fov{40.f};
   float m_defaultFov{40.f};
   
+  // scatter, applied as a post-process on the primary image when available
+  float m_scatterFraction{0.f};
+  float m_scatterSigma{0.f};
+  std::vector<float> m_primary; // primary intensity of the last frame
+  anari::math::int2 m_primarySize{0, 0};
+  std::vector<uint8_t> m_postColor; // scattered image in m_format layout
+  WorkerPool m_scatterWorkers; // reused while scatter sliders are dragged
+
+  // camera path playback and image sequence capture
+  CameraPath m_cameraPath;
+  float m_sweepAngle{180.f};
+  int m_sequenceFrames{120};
+  int m_sequenceFrame{0};
+  bool m_sequencePlaying{false};
+  bool m_sequenceCapture{false};
+  anari::math::int2 m_sequenceSize{1024, 1024};
+  FileNameCounter m_sequenceNames{"sequence", ""};
+  std::string m_sequenceDir;
+  std::chrono::steady_clock::time_point m_sequenceStart;
+  std::atomic<int> m_sequenceWritten{0};
+  std::atomic<float> m_sequenceFps{0.f};
+  std::unique_ptr<AsyncWriter> m_sequenceWriter; // encodes on all cores
+
+  // scripted benchmark
+  std::unique_ptr<BenchmarkRecorder> m_benchmark;
+  BenchmarkInfo m_benchmarkInfo;
+  CameraPath m_benchmarkPath;
+  int m_benchmarkFrame{0};
+  bool m_benchmarkFinished{false};
+
+  // region of interest, the whole view while recording sequences and
+  // benchmarks
+  ImageRegion m_imageRegion;
+  bool m_selectingRegion{false};
+  anari::math::float2 m_regionStart{0.f, 0.f};
+  std::function<void(const ImageRegion &)> m_imageRegionCallback;
+
   // pixel picker
   std::vector<visionaray::basic_ray<float>> m_pickedRays;
+  bool m_hasLandmark{false};
+  anari::math::float3 m_landmark{0.f, 0.f, 0.f};
+
+  // volume of interest, a box of m_voiHalfExtent around the landmark
+  VolumeOfInterest m_volumeOfInterest;
+  anari::math::float3 m_voiHalfExtent{20.f, 20.f, 20.f};
+  std::function<void(const VolumeOfInterest &)> m_volumeOfInterestCallback;
 
   // ANARI objects //
 
   anari::DataType m_format{ANARI_UFIXED8_RGBA_SRGB};
+  anari::math::float2 m_window{0.f, 1.f};
+  bool m_autoWindow{true};
 
   anari::Device m_device{nullptr};
   anari::Frame m_frame{nullptr};
@@ -109,6 +249,16 @@ struct DRRViewport : public anari_viewer::windows::Window
   std::vector<anari::Renderer> m_renderers;
   int m_currentRenderer{0};
 
+  // in-tree CPU renderer //
+
+  std::unique_ptr<CpuDrrRenderer> m_cpuRenderer;
+  bool m_useCpuRenderer{false};
+  float m_cpuStepSize{.5f};
+  CpuDrrFrame m_cpuFrame;
+  std::future<bool> m_cpuFuture;
+  std::atomic<bool> m_cpuCancel{false};
+  float m_cpuDuration{0.f};
+
   // OpenGL + display
 
   GLuint m_framebufferTexture{0};
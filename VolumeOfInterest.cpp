@@ -0,0 +1,78 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#include "VolumeOfInterest.h"
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+VolumeOfInterest VolumeOfInterest::around(const StructuredField &field,
+    const anari::math::float3 &point,
+    const anari::math::float3 &halfExtent)
+{
+  const float p[3] = {point.x, point.y, point.z};
+  const float r[3] = {halfExtent.x, halfExtent.y, halfExtent.z};
+  const float s[3] = {field.spacingX, field.spacingY, field.spacingZ};
+  VolumeOfInterest voi;
+  for (int a = 0; a < 3; ++a) {
+    voi.lo[a] = int(std::ceil((p[a] - std::abs(r[a])) / s[a]));
+    voi.hi[a] = int(std::floor((p[a] + std::abs(r[a])) / s[a]));
+  }
+  return voi.empty() ? voi : voi.clippedTo(field);
+}
+
+VolumeOfInterest VolumeOfInterest::clippedTo(const StructuredField &field) const
+{
+  const int dims[3] = {field.dimX, field.dimY, field.dimZ};
+  VolumeOfInterest voi;
+  for (int a = 0; a < 3; ++a) {
+    voi.lo[a] = empty() ? 0 : std::max(lo[a], 0);
+    voi.hi[a] = empty() ? dims[a] - 1 : std::min(hi[a], dims[a] - 1);
+  }
+  return voi;
+}
+
+anari::math::float3 VolumeOfInterest::origin(
+    const StructuredField &field) const
+{
+  return {lo[0] * field.spacingX, lo[1] * field.spacingY, lo[2] * field.spacingZ};
+}
+
+StructuredField cropField(
+    const StructuredField &field, const VolumeOfInterest &voi)
+{
+  const VolumeOfInterest box = voi.clippedTo(field);
+  if (box.empty() || field.empty())
+    return {};
+
+  StructuredField result;
+  result.dimX = box.hi[0] - box.lo[0] + 1;
+  result.dimY = box.hi[1] - box.lo[1] + 1;
+  result.dimZ = box.hi[2] - box.lo[2] + 1;
+  result.spacingX = field.spacingX;
+  result.spacingY = field.spacingY;
+  result.spacingZ = field.spacingZ;
+  result.bytesPerCell = field.bytesPerCell;
+  result.dataRange = field.dataRange;
+
+  auto copy = [&](const auto &src, auto &dst) {
+    dst.resize(size_t(result.dimX) * result.dimY * result.dimZ);
+    for (int z = 0; z < result.dimZ; ++z) {
+      for (int y = 0; y < result.dimY; ++y) {
+        const size_t from = box.lo[0]
+            + field.dimX
+                * (box.lo[1] + y + size_t(field.dimY) * (box.lo[2] + z));
+        const size_t to = result.dimX * (y + size_t(result.dimY) * z);
+        std::memcpy(&dst[to], &src[from], result.dimX * sizeof(dst[0]));
+      }
+    }
+  };
+  if (field.bytesPerCell == 1)
+    copy(field.dataUI8, result.dataUI8);
+  else if (field.bytesPerCell == 2)
+    copy(field.dataUI16, result.dataUI16);
+  else
+    copy(field.dataF32, result.dataF32);
+  return result;
+}
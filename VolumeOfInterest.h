@@ -0,0 +1,44 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <array>
+// anari
+#include "anari/anari_cpp/ext/linalg.h" // math::float3
+// ours
+#include "FieldTypes.h"
+
+// Box of voxels [lo, hi] (inclusive indices) DRRs are integrated over, e.g.
+// a single vertebra around a picked landmark. Given in voxels, it stays put
+// when the voxel spacing changes; an empty box stands for the whole field.
+struct VolumeOfInterest
+{
+  std::array<int, 3> lo{0, 0, 0};
+  std::array<int, 3> hi{-1, -1, -1};
+
+  bool empty() const
+  {
+    return hi[0] < lo[0] || hi[1] < lo[1] || hi[2] < lo[2];
+  }
+
+  bool operator==(const VolumeOfInterest &) const = default;
+
+  // the voxels within halfExtent (world units) of point, clipped to the
+  // field; empty if the box misses it
+  static VolumeOfInterest around(const StructuredField &field,
+      const anari::math::float3 &point,
+      const anari::math::float3 &halfExtent);
+
+  // the box clipped to the field, the whole field if empty
+  VolumeOfInterest clippedTo(const StructuredField &field) const;
+
+  // world space position of voxel lo (voxel i sits at i * spacing)
+  anari::math::float3 origin(const StructuredField &field) const;
+};
+
+// Copy of the voxels inside voi (value range kept), voxel lo becomes the
+// first one: an upload of just the volume of interest
+StructuredField cropField(
+    const StructuredField &field, const VolumeOfInterest &voi);
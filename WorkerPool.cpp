@@ -0,0 +1,84 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#include "WorkerPool.h"
+// std
+#include <algorithm>
+
+// WorkerPool definitions /////////////////////////////////////////////////////
+
+WorkerPool::WorkerPool(unsigned numThreads)
+{
+  if (numThreads == 0)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned i = 1; i < numThreads; ++i)
+    m_threads.emplace_back([this]() { run(); });
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::unique_lock<std::mutex> l(m_mutex);
+    m_quit = true;
+  }
+  m_startCond.notify_all();
+  for (auto &t : m_threads)
+    t.join();
+}
+
+unsigned WorkerPool::size() const
+{
+  return unsigned(m_threads.size()) + 1;
+}
+
+void WorkerPool::parallelFor(int n, const std::function<void(int)> &func)
+{
+  if (n <= 0)
+    return;
+  if (m_threads.empty() || n == 1) {
+    for (int i = 0; i < n; ++i)
+      func(i);
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> l(m_mutex);
+    m_func = &func;
+    m_count = n;
+    m_next = 0;
+    m_active = unsigned(m_threads.size());
+    ++m_generation;
+  }
+  m_startCond.notify_all();
+  work();
+
+  // func must outlive every worker's last call
+  std::unique_lock<std::mutex> l(m_mutex);
+  m_doneCond.wait(l, [this]() { return m_active == 0; });
+  m_func = nullptr;
+}
+
+void WorkerPool::run()
+{
+  uint64_t generation = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> l(m_mutex);
+      m_startCond.wait(
+          l, [&]() { return m_quit || m_generation != generation; });
+      if (m_quit)
+        return;
+      generation = m_generation;
+    }
+    work();
+    std::unique_lock<std::mutex> l(m_mutex);
+    if (--m_active == 0)
+      m_doneCond.notify_one();
+  }
+}
+
+void WorkerPool::work()
+{
+  for (int i = m_next++; i < m_count; i = m_next++)
+    (*m_func)(i);
+}
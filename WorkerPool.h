@@ -0,0 +1,48 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads kept alive between data parallel loops that run often, e.g. a
+// post-process redone every UI frame while a slider is dragged, so the loops
+// don't create and join threads on every call. One loop runs at a time.
+class WorkerPool
+{
+ public:
+  // threads including the calling one, 0 picks hardware_concurrency()
+  explicit WorkerPool(unsigned numThreads = 0);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  unsigned size() const;
+
+  // func(i) for every i in [0, n), the calling thread takes part; returns
+  // when all are done
+  void parallelFor(int n, const std::function<void(int)> &func);
+
+ private:
+  void run();
+  void work();
+
+  const std::function<void(int)> *m_func{nullptr};
+  int m_count{0};
+  std::atomic<int> m_next{0};
+  unsigned m_active{0};
+  uint64_t m_generation{0};
+  bool m_quit{false};
+  std::mutex m_mutex;
+  std::condition_variable m_startCond;
+  std::condition_variable m_doneCond;
+  std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,487 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+// Headless DRR rendering with the in-tree CPU ray caster
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+// stb_image
+#include "stb_image/stb_image_write.h"
+// ours
+#include "Benchmark.h"
+#include "CpuDrrRenderer.h"
+#include "EstimatorBenchmark.h"
+#include "FieldTypes.h"
+#include "ImageTransformEstimatorWrapper.h"
+#include "LacTransform.h"
+#include "prediction.h"
+#include "readRAW.h"
+#include "Registration.h"
+#include "SimilarityMetrics.h"
+#include "VolumeOfInterest.h"
+#ifdef HAVE_ITK
+#include "readNifti.h"
+#endif
+
+static std::string g_filename;
+static int g_dimX = 0, g_dimY = 0, g_dimZ = 0;
+static unsigned g_bytesPerCell = 0;
+static std::string g_jsonfile;
+static std::string g_laclutfile;
+static size_t g_laclutid{0};
+static int g_width{1024};
+static int g_height{1024};
+static float g_fovyDeg{40.f};
+static CpuDrrCamera g_camera;
+static bool g_cameraSet{false};
+static CpuDrrRenderer::Sampling g_sampling{CpuDrrRenderer::Sampling::TRILINEAR};
+static float g_stepSize{.5f};
+static unsigned g_numThreads{0};
+static VolumeOfInterest g_volumeOfInterest;
+static std::string g_output{"gray8"};
+static std::string g_outputBase{"drr"};
+static BenchmarkSpec g_benchmark;
+static bool g_runBenchmark{false};
+static std::vector<std::string> g_estimatorLibraryNames;
+static bool g_register{false};
+static RegistrationSettings g_registration;
+static std::string g_registeredFile{"registered.json"};
+static EstimatorBenchmarkSpec g_estimatorBenchmark;
+static bool g_runEstimatorBenchmark{false};
+static int g_metricsBenchmarkWidth{0};
+static int g_metricsBenchmarkHeight{0};
+
+static void printUsage()
+{
+  std::cout << "./anariDRRHeadless [{--help|-h}]\n"
+            << "   [{--json|-j} <predictions file>]\n"
+            << "   [{--eye} <x y z>] [{--center} <x y z>] [{--up} <x y z>]\n"
+            << "   [{--fovy} <degrees>]\n"
+            << "   [{--size|-s} <width height>]\n"
+            << "   [{--sampling} [{siddon|trilinear}]]\n"
+            << "   [{--step} <voxels>]\n"
+            << "   [{--threads} <num>]\n"
+            << "   [{--voi} <x0 y0 z0 x1 y1 z1>]\n"
+            << "   [{--output|-o} [{gray8|float32|uint16}]]\n"
+            << "   [{--out} <file base name>]\n"
+            << "   [{--benchmark} <orbit|zoom>[:key=value,...]]\n"
+            << "   [{--register} [{--estimator|-e} <library>] [{--jobs} <num>]\n"
+            << "    [{--register-iterations} <num>] [{--registered} <file>]\n"
+            << "    [{--batch} <num>] [{--register-levels} <num>]]\n"
+            << "   [{--estimator-benchmark} <key=value,...>]\n"
+            << "   [{--metrics-benchmark} <width height>]\n"
+            << "   [{--lacfile|--lac} <file>]\n"
+            << "   [{--lut} <index>]\n"
+            << "   [{--dims|-d} <dimx dimy dimz>]\n"
+            << "   [{--type|-t} [{uint8|uint16|float32}]\n"
+            << "   <volume file>\n";
+}
+
+static void parseCommandLine(int argc, char *argv[])
+{
+  auto float3Arg = [&](int &i) {
+    anari::math::float3 v;
+    v.x = std::atof(argv[++i]);
+    v.y = std::atof(argv[++i]);
+    v.z = std::atof(argv[++i]);
+    return v;
+  };
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") {
+      printUsage();
+      std::exit(0);
+    } else if (arg == "--dims" || arg == "-d") {
+      g_dimX = std::atoi(argv[++i]);
+      g_dimY = std::atoi(argv[++i]);
+      g_dimZ = std::atoi(argv[++i]);
+    } else if (arg == "--type" || arg == "-t") {
+      std::string v = argv[++i];
+      if (v == "uint8")
+        g_bytesPerCell = 1;
+      else if (v == "uint16")
+        g_bytesPerCell = 2;
+      else if (v == "float32")
+        g_bytesPerCell = 4;
+      else {
+        printUsage();
+        std::exit(1);
+      }
+    } else if (arg == "--json" || arg == "-j") {
+      g_jsonfile = argv[++i];
+    } else if (arg == "--lacfile" || arg == "--lac") {
+      g_laclutfile = argv[++i];
+    } else if (arg == "--lut") {
+      g_laclutid = std::atoi(argv[++i]);
+    } else if (arg == "--eye") {
+      g_camera.eye = float3Arg(i);
+      g_cameraSet = true;
+    } else if (arg == "--center") {
+      g_camera.center = float3Arg(i);
+      g_cameraSet = true;
+    } else if (arg == "--up") {
+      g_camera.up = float3Arg(i);
+    } else if (arg == "--fovy") {
+      g_fovyDeg = std::atof(argv[++i]);
+    } else if (arg == "--size" || arg == "-s") {
+      g_width = std::atoi(argv[++i]);
+      g_height = std::atoi(argv[++i]);
+    } else if (arg == "--sampling") {
+      std::string v = argv[++i];
+      if (v == "siddon")
+        g_sampling = CpuDrrRenderer::Sampling::SIDDON;
+      else if (v == "trilinear")
+        g_sampling = CpuDrrRenderer::Sampling::TRILINEAR;
+      else {
+        printUsage();
+        std::exit(1);
+      }
+    } else if (arg == "--step") {
+      g_stepSize = std::atof(argv[++i]);
+    } else if (arg == "--threads") {
+      g_numThreads = std::atoi(argv[++i]);
+    } else if (arg == "--voi") {
+      for (int &v : g_volumeOfInterest.lo)
+        v = std::atoi(argv[++i]);
+      for (int &v : g_volumeOfInterest.hi)
+        v = std::atoi(argv[++i]);
+      // an empty box would silently stand for the whole field
+      if (g_volumeOfInterest.empty()) {
+        std::cerr << "ERROR: --voi needs x0 <= x1, y0 <= y1, z0 <= z1\n";
+        std::exit(1);
+      }
+    } else if (arg == "--output" || arg == "-o") {
+      g_output = argv[++i];
+      if (g_output != "gray8" && g_output != "float32" && g_output != "uint16") {
+        printUsage();
+        std::exit(1);
+      }
+    } else if (arg == "--out") {
+      g_outputBase = argv[++i];
+    } else if (arg == "--benchmark") {
+      if (!BenchmarkSpec::parse(argv[++i], g_benchmark)) {
+        printUsage();
+        std::exit(1);
+      }
+      g_runBenchmark = true;
+    } else if (arg == "--estimator-benchmark") {
+      if (!EstimatorBenchmarkSpec::parse(argv[++i], g_estimatorBenchmark)) {
+        printUsage();
+        std::exit(1);
+      }
+      g_runEstimatorBenchmark = true;
+    } else if (arg == "--metrics-benchmark") {
+      g_metricsBenchmarkWidth = std::atoi(argv[++i]);
+      g_metricsBenchmarkHeight = std::atoi(argv[++i]);
+    } else if (arg == "--register") {
+      g_register = true;
+    } else if (arg == "-m" || arg == "--matcher" || arg == "-e"
+        || arg == "--estimator") {
+      g_estimatorLibraryNames.emplace_back(argv[++i]);
+    } else if (arg == "--jobs") {
+      g_registration.jobs = std::atoi(argv[++i]);
+    } else if (arg == "--batch") {
+      g_registration.batchSize = std::atoi(argv[++i]);
+    } else if (arg == "--register-levels") {
+      g_registration.levels = std::atoi(argv[++i]);
+    } else if (arg == "--register-iterations") {
+      g_registration.iterations = std::atoi(argv[++i]);
+    } else if (arg == "--registered") {
+      g_registeredFile = argv[++i];
+    } else
+      g_filename = std::move(arg);
+  }
+}
+
+static bool loadField(StructuredField &field)
+{
+  if (g_filename.size() > 4
+      && g_filename.compare(g_filename.size() - 4, 4, ".raw") == 0
+      && !g_dimX && !g_dimY && !g_dimZ && !g_bytesPerCell)
+    guessRAWFormat(g_filename, g_dimX, g_dimY, g_dimZ, g_bytesPerCell);
+
+  if (g_dimX && g_dimY && g_dimZ && g_bytesPerCell) {
+    RAWReader rawReader;
+    if (!rawReader.open(
+            g_filename.c_str(), g_dimX, g_dimY, g_dimZ, g_bytesPerCell))
+      return false;
+    field = rawReader.getField();
+    return true;
+  }
+#ifdef HAVE_ITK
+  NiftiReader niftiReader;
+  if (niftiReader.open(g_filename.c_str())) {
+    LacReader lacReader;
+    if (!g_laclutfile.empty())
+      lacReader.setFilename(g_laclutfile);
+    lacReader.read();
+    lacReader.setActiveLut(g_laclutid);
+    field = niftiReader.getField(0, lacReader);
+    return true;
+  }
+#endif
+  return false;
+}
+
+// Write frame with the same orientation as the viewport and its screenshots
+// (columns mirrored, frame row 0 first)
+static bool writeFrame(const CpuDrrFrame &frame, const std::string &base)
+{
+  const int w = frame.width, h = frame.height;
+  const auto &L = frame.lineIntegral;
+  auto src = [&](int x, int y) { return L[size_t(y) * w + (w - 1 - x)]; };
+
+  if (g_output == "float32") {
+    // portable float map, little endian, stored bottom-to-top
+    std::string filename = base + ".pfm";
+    FILE *fp = fopen(filename.c_str(), "wb");
+    if (!fp)
+      return false;
+    fprintf(fp, "Pf\n%d %d\n-1.0\n", w, h);
+    std::vector<float> row(w);
+    for (int y = h - 1; y >= 0; --y) {
+      for (int x = 0; x < w; ++x)
+        row[x] = src(x, y);
+      fwrite(row.data(), sizeof(float), w, fp);
+    }
+    fclose(fp);
+    std::cout << "DRR written to: " << filename << '\n';
+    return true;
+  }
+
+  if (g_output == "uint16") {
+    // 16 bit binary PGM (big endian) of the linear intensity exp(-L)
+    std::string filename = base + ".pgm";
+    FILE *fp = fopen(filename.c_str(), "wb");
+    if (!fp)
+      return false;
+    fprintf(fp, "P5\n%d %d\n65535\n", w, h);
+    std::vector<uint8_t> row(2 * w);
+    for (int y = 0; y < h; ++y) {
+      for (int x = 0; x < w; ++x) {
+        auto v = uint16_t(std::exp(-src(x, y)) * 65535.f + .5f);
+        row[2 * x] = v >> 8;
+        row[2 * x + 1] = v & 0xff;
+      }
+      fwrite(row.data(), 1, row.size(), fp);
+    }
+    fclose(fp);
+    std::cout << "DRR written to: " << filename << '\n';
+    return true;
+  }
+
+  // 8 bit line integral, windowed to its range
+  auto [lo, hi] = std::minmax_element(L.begin(), L.end());
+  const float range = *hi > *lo ? *hi - *lo : 1.f;
+  std::vector<uint8_t> gray(size_t(w) * h);
+  for (int y = 0; y < h; ++y)
+    for (int x = 0; x < w; ++x)
+      gray[size_t(y) * w + x] = uint8_t((src(x, y) - *lo) / range * 255.f);
+  std::string filename = base + ".png";
+  if (!stbi_write_png(filename.c_str(), w, h, 1, gray.data(), w))
+    return false;
+  std::cout << "DRR written to: " << filename << '\n';
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  parseCommandLine(argc, argv);
+  if (g_metricsBenchmarkWidth > 0 && g_metricsBenchmarkHeight > 0) {
+    // synthetic images, no volume needed
+    benchmarkMetrics(
+        g_metricsBenchmarkWidth, g_metricsBenchmarkHeight, 20, g_numThreads);
+    return 0;
+  }
+  if (g_filename.empty()) {
+    printf("ERROR: no input file provided\n");
+    std::exit(1);
+  }
+
+  StructuredField field;
+  if (!loadField(field)) {
+    std::cerr << "ERROR: could not load volume: " << g_filename << '\n';
+    std::exit(1);
+  }
+
+  if (!g_volumeOfInterest.empty()
+      && g_volumeOfInterest.clippedTo(field) != g_volumeOfInterest) {
+    std::cerr << "ERROR: --voi exceeds the volume's " << field.dimX << " x "
+              << field.dimY << " x " << field.dimZ << " voxels\n";
+    std::exit(1);
+  }
+
+  CpuDrrRenderer renderer;
+  renderer.setField(&field);
+  renderer.setSampling(g_sampling);
+  renderer.setStepSize(g_stepSize);
+  renderer.setNumThreads(g_numThreads);
+  renderer.setVolumeOfInterest(g_volumeOfInterest);
+
+  if (g_runBenchmark) {
+    g_width = g_benchmark.width;
+    g_height = g_benchmark.height;
+  }
+
+  std::vector<CpuDrrCamera> cameras;
+  const float aspect = g_width / float(g_height);
+
+  prediction_container predictions;
+  if (!g_jsonfile.empty() && predictions.load(g_jsonfile)) {
+    for (auto &p : predictions) {
+      const auto &c =
+          p.refined_camera.initialized ? p.refined_camera : p.initial_camera;
+      cameras.push_back({c.eye, c.center, c.up, predictions.fovy, aspect});
+    }
+  } else {
+    if (!g_cameraSet) {
+      // look at the volume center along -z
+      const float cx = (field.dimX - 1) * field.spacingX * .5f;
+      const float cy = (field.dimY - 1) * field.spacingY * .5f;
+      const float cz = (field.dimZ - 1) * field.spacingZ * .5f;
+      const float extent = std::max({(field.dimX - 1) * field.spacingX,
+          (field.dimY - 1) * field.spacingY,
+          (field.dimZ - 1) * field.spacingZ});
+      g_camera.center = {cx, cy, cz};
+      g_camera.eye = {cx, cy, cz + 2.f * extent};
+    }
+    g_camera.fovy = g_fovyDeg * M_PI / 180.f;
+    g_camera.aspect = aspect;
+    cameras.push_back(g_camera);
+  }
+
+  if (g_runEstimatorBenchmark) {
+    // reference at the first camera, queries at perturbations of it
+    ImageTransformEstimatorWrapper estimators;
+    estimators.init(g_estimatorLibraryNames);
+    if (estimators.m_estimators.empty()) {
+      std::cerr << "ERROR: --estimator-benchmark needs an estimator "
+                   "(--estimator)\n";
+      return 1;
+    }
+    const auto &start = cameras[0];
+    return runEstimatorBenchmark(g_estimatorBenchmark,
+               renderer,
+               estimators,
+               {start.eye, start.center, start.up},
+               start.fovy)
+        ? 0
+        : 1;
+  }
+
+  if (g_register) {
+    // refine every prediction, starting at its initial camera
+    if (predictions.predictions.empty()) {
+      std::cerr << "ERROR: --register needs predictions (--json)\n";
+      return 1;
+    }
+    ImageTransformEstimatorWrapper estimators;
+    estimators.init(g_estimatorLibraryNames);
+    if (!estimators.getActiveEstimator()) {
+      std::cerr << "ERROR: --register needs an estimator (--estimator)\n";
+      return 1;
+    }
+    g_registration.width = g_width;
+    g_registration.height = g_height;
+    if (g_registration.jobs == 0)
+      g_registration.jobs = std::max(1u, std::thread::hardware_concurrency() / 2);
+    if (g_numThreads == 0) {
+      // split the cores between the concurrent renders
+      renderer.setNumThreads(std::max(
+          1u, std::thread::hardware_concurrency() / g_registration.jobs));
+    }
+
+    // one estimator instance per job
+    estimators.setPoolSize(g_registration.jobs);
+    auto stats = registerPredictions(
+        predictions, renderer, estimators, 0, g_registration);
+    auto latency = computeBenchmarkStats(stats.latencyMs);
+    printf("registered %zu of %zu predictions with %u job(s) in %.2fs, "
+           "%.2f predictions/s\n",
+        stats.registered,
+        predictions.predictions.size(),
+        g_registration.jobs,
+        stats.wallSeconds,
+        stats.registered / std::max(stats.wallSeconds, 1e-6f));
+    printf("latency: mean %.1fms p50 %.1fms p95 %.1fms max %.1fms\n",
+        latency.mean,
+        latency.p50,
+        latency.p95,
+        latency.max);
+    for (const auto &level : stats.levels) {
+      printf("level %ix%i: %i iteration(s), %.2fs\n",
+          level.width,
+          level.height,
+          level.iterations,
+          level.seconds);
+    }
+    if (!predictions.save(g_registeredFile)) {
+      std::cerr << "ERROR: could not write: " << g_registeredFile << '\n';
+      return 1;
+    }
+    std::cout << "Refined cameras written to: " << g_registeredFile << '\n';
+    return stats.failed == 0 ? 0 : 1;
+  }
+
+  CpuDrrFrame frame;
+
+  if (g_runBenchmark) {
+    // scripted path starting at the first camera, nothing is written but the
+    // timings
+    const auto &start = cameras[0];
+    const auto path =
+        g_benchmark.cameraPath({start.eye, start.center, start.up});
+    BenchmarkRecorder recorder(g_benchmark);
+    for (int i = 0; i < g_benchmark.totalFrames(); ++i) {
+      const auto key = g_benchmark.camera(path, i);
+      CpuDrrCamera camera{key.eye, key.center, key.up, start.fovy, aspect};
+      auto t0 = std::chrono::steady_clock::now();
+      if (!renderer.render(camera, g_width, g_height, frame)) {
+        std::cerr << "ERROR: could not render frame " << i << '\n';
+        return 1;
+      }
+      float ms = std::chrono::duration<float, std::milli>(
+          std::chrono::steady_clock::now() - t0)
+                     .count();
+      // no device timer on the CPU path: both columns are the render() time
+      recorder.addFrame(i, ms, ms);
+    }
+    BenchmarkInfo info{{"tool", "anariDRRHeadless"},
+        {"renderer", "cpu-drr"},
+        {"sampling",
+            g_sampling == CpuDrrRenderer::Sampling::SIDDON ? "siddon"
+                                                           : "trilinear"},
+        {"threads", std::to_string(g_numThreads)},
+        {"volume", g_filename}};
+    return recorder.write(info) ? 0 : 1;
+  }
+
+  for (size_t i = 0; i < cameras.size(); ++i) {
+    auto start = std::chrono::steady_clock::now();
+    if (!renderer.render(cameras[i], g_width, g_height, frame)) {
+      std::cerr << "ERROR: could not render frame " << i << '\n';
+      return 1;
+    }
+    float ms = std::chrono::duration<float, std::milli>(
+        std::chrono::steady_clock::now() - start)
+                   .count();
+    printf("frame %zu: %i x %i, %.2fms\n", i, g_width, g_height, ms);
+
+    std::string base = g_outputBase;
+    if (cameras.size() > 1)
+      base += "-" + std::to_string(i);
+    if (!writeFrame(frame, base))
+      std::cerr << "ERROR: could not write DRR: " << base << '\n';
+  }
+
+  return 0;
+}
@@ -0,0 +1,78 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+// estimator
+#include <image_transform_estimator.h>
+
+// Optional batched extension of the estimator plugin ABI. Besides the
+// per-image symbols, a plugin may export
+//
+//   extern "C" uint32_t estimator_capabilities();
+//   extern "C" image_transform_estimator_batch* create_estimator_batch();
+//   extern "C" void destroy_estimator_batch(image_transform_estimator_batch*);
+//
+// ImageTransformEstimatorWrapper probes for them with dlsym; plugins without
+// them are driven one image pair at a time.
+
+enum estimator_capability : uint32_t
+{
+  ESTIMATOR_CAPABILITY_BATCH = 1u << 0,
+};
+
+// count query/reference pairs in contiguous buffers: image i of a buffer
+// starts at i * width * height * bytes per pixel. All references share one
+// size and pixel type, as do all queries and depth images.
+struct estimator_batch
+{
+  size_t count{0};
+
+  const void *references{nullptr};
+  size_t reference_width{0};
+  size_t reference_height{0};
+  image_transform_estimator::PIXEL_TYPE reference_pixel_type{
+      image_transform_estimator::PIXEL_TYPE::R8};
+  bool reference_swizzle{false};
+
+  const void *queries{nullptr};
+  image_transform_estimator::PIXEL_TYPE query_pixel_type{
+      image_transform_estimator::PIXEL_TYPE::R8};
+  const float *depth3d{nullptr}; // F32X3 per query pixel
+  size_t width{0};
+  size_t height{0};
+  float fovy{0.f};
+  float aspect{1.f};
+
+  // count * 9 floats, eye, center and up per pair: the query cameras on
+  // input, the updated cameras on output
+  float *cameras{nullptr};
+};
+
+class image_transform_estimator_batch
+{
+ public:
+  virtual ~image_transform_estimator_batch() = default;
+
+  // calibrate, match and update the camera of every pair
+  virtual void match(estimator_batch &batch) = 0;
+  virtual void set_good_match_threshold(float threshold) = 0;
+};
+
+inline size_t bytesPerPixel(image_transform_estimator::PIXEL_TYPE type)
+{
+  switch (type) {
+  case image_transform_estimator::PIXEL_TYPE::R8:
+    return 1;
+  case image_transform_estimator::PIXEL_TYPE::RGB8:
+    return 3;
+  case image_transform_estimator::PIXEL_TYPE::RGBA8:
+    return 4;
+  case image_transform_estimator::PIXEL_TYPE::F32X3:
+    return 12;
+  }
+  return 0;
+}
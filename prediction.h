@@ -1,15 +1,21 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <exception>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
 #include <string>
-//#include <vector>
+#include <vector>
 
 #include <nlohmann/json.hpp>
 
 #include "anari/anari_cpp/ext/linalg.h"
 
+#include "PoseIndex.h"
+
 struct cam
 {
     anari::math::float3 eye;
@@ -54,16 +60,80 @@ inline std::ostream& operator<<(std::ostream& os, const prediction& p)
     return os;
 }
 
+// Predictions are stored in one of three formats, chosen by file extension:
+//  - .json:     the original nested format, {"sensor": ..., "predictions": [...]}
+//  - .jsonl:    one JSON object per line; a {"sensor": ...} line followed by
+//               one line per prediction with cameras as [x, y, z] arrays.
+//               Read line by line, without a DOM of the whole file.
+//  - .predbin:  binary columnar poses (native byte order):
+//               "PRDB", uint32 version, uint64 count, float fovx, fovy,
+//               uint8 flags[count] (1: initial, 2: refined camera),
+//               18 float columns (initial, refined camera x eye, center,
+//               up x components x, y, z), uint32 name lengths[count],
+//               file names.
+// Refined cameras saved during a session are appended to a journal next to
+// the predictions file (<file>.journal, JSONL), which is replayed on load; a
+// torn last line, e.g. after a crash, is ignored.
+namespace prediction_io
+{
+    inline bool ends_with(const std::string& str, const std::string& suffix)
+    {
+        return str.size() >= suffix.size()
+            && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // accepts [x, y, z] and {"x": x, "y": y, "z": z}
+    inline anari::math::float3 read_float3(const nlohmann::json& j)
+    {
+        if (j.is_array())
+            return {j.at(0).get<float>(), j.at(1).get<float>(), j.at(2).get<float>()};
+        return {j.at("x").get<float>(), j.at("y").get<float>(), j.at("z").get<float>()};
+    }
+
+    inline void read_cam(const nlohmann::json& j, cam& c)
+    {
+        c.eye = read_float3(j.at("eye"));
+        c.center = read_float3(j.at("center"));
+        c.up = read_float3(j.at("up"));
+        c.initialized = true;
+    }
+
+    inline void write_float3(std::ostream& os, const anari::math::float3& v)
+    {
+        os << '[' << v.x << ',' << v.y << ',' << v.z << ']';
+    }
+
+    inline void write_cam(std::ostream& os, const char* key, const cam& c)
+    {
+        os << ",\"" << key << "\":{\"eye\":";
+        write_float3(os, c.eye);
+        os << ",\"center\":";
+        write_float3(os, c.center);
+        os << ",\"up\":";
+        write_float3(os, c.up);
+        os << '}';
+    }
+
+    inline const char binary_magic[4] = {'P', 'R', 'D', 'B'};
+    inline const uint32_t binary_version = 1;
+}
+
 
 struct prediction_container
 {
     std::vector<prediction> predictions;
     float fovx, fovy;
+    // initial and refined poses for nearest-view lookup, built on first use
+    PoseIndex poses;
+    bool poses_dirty{true};
+    // bumped whenever a refined camera changes, views of the predictions
+    // compare it to know when to refresh
+    uint64_t revision{0};
 
     prediction_container() {}
-    prediction_container(std::string json_filename)
+    prediction_container(std::string filename)
     {
-        load_json(json_filename);
+        load(filename);
     }
 
     prediction& operator [](size_t idx) { return predictions[idx]; }
@@ -73,6 +143,85 @@ struct prediction_container
     auto end() { return predictions.end(); }
     const auto end() const { return predictions.end(); }
 
+    // load by extension (.json, .jsonl, .predbin) and replay the journal
+    bool load(std::string filename)
+    {
+        bool ok;
+        if (prediction_io::ends_with(filename, ".jsonl"))
+            ok = load_jsonl(filename);
+        else if (prediction_io::ends_with(filename, ".predbin"))
+            ok = load_binary(filename);
+        else
+            ok = load_json(filename);
+        if (ok)
+            replay_journal(journal_filename(filename));
+        return ok;
+    }
+
+    // save by extension (.json, .jsonl, .predbin)
+    bool save(std::string filename) const
+    {
+        if (prediction_io::ends_with(filename, ".jsonl"))
+            return export_jsonl(filename);
+        if (prediction_io::ends_with(filename, ".predbin"))
+            return export_binary(filename);
+        return export_json(filename);
+    }
+
+    // set a refined camera, keeping the pose index up to date
+    void set_refined_camera(size_t idx,
+                            const anari::math::float3& eye,
+                            const anari::math::float3& center,
+                            const anari::math::float3& up)
+    {
+        auto& c = predictions[idx].refined_camera;
+        c.eye = eye;
+        c.center = center;
+        c.up = up;
+        c.initialized = true;
+        ++revision;
+        if (!poses_dirty)
+            poses.add(idx, true, eye, center);
+    }
+
+    // rebuild the pose index; directions are weighted by the mean viewing
+    // distance, so turning by about one radian counts like moving that far
+    void index_poses()
+    {
+        poses.clear();
+        double distance = 0.0;
+        size_t count = 0;
+        for (size_t i = 0; i < predictions.size(); ++i)
+        {
+            for (const cam* c : {&predictions[i].initial_camera, &predictions[i].refined_camera})
+            {
+                if (!c->initialized)
+                    continue;
+                poses.add(i, c == &predictions[i].refined_camera, c->eye, c->center);
+                distance += anari::math::length(c->center - c->eye);
+                ++count;
+            }
+        }
+        poses.setDirectionWeight(count > 0 && distance > 0.0 ? float(distance / count) : 1.f);
+        poses.build();
+        poses_dirty = false;
+    }
+
+    // the k stored poses (initial or refined) closest to the given camera
+    std::vector<PoseMatch> nearest_poses(const anari::math::float3& eye,
+                                         const anari::math::float3& center,
+                                         size_t k = 1)
+    {
+        if (poses_dirty)
+            index_poses();
+        return poses.nearest(eye, center, k);
+    }
+
+    static std::string journal_filename(const std::string& filename)
+    {
+        return filename + ".journal";
+    }
+
     bool load_json(std::string json_filename)
     {
         std::ifstream json_file(json_filename);
@@ -82,6 +231,7 @@ struct prediction_container
             return false;
         }
         predictions.clear();
+        poses_dirty = true;
         //std::cout << "Loading predictions:\n";
         try
         {
@@ -137,7 +287,8 @@ struct prediction_container
         return retval;
     }
 
-    bool export_json(std::string export_path)
+    // written directly, without building a DOM
+    bool export_json(std::string export_path) const
     {
         std::ofstream json_file(export_path);
         if (json_file.fail())
@@ -145,42 +296,329 @@ struct prediction_container
             std::cerr << "ERROR: can't write to file: " << export_path << "\n" << std::strerror(errno) << std::endl;
             return false;
         }
+        json_file << std::setprecision(std::numeric_limits<float>::max_digits10);
+
+        auto write_xyz = [&](const char* indent, const char* key, const anari::math::float3& v, bool last) {
+            json_file << indent << '"' << key << "\": {\n"
+                      << indent << "    \"x\": " << v.x << ",\n"
+                      << indent << "    \"y\": " << v.y << ",\n"
+                      << indent << "    \"z\": " << v.z << "\n"
+                      << indent << (last ? "}\n" : "},\n");
+        };
+        auto write_cam = [&](const char* key, const cam& c, bool last) {
+            json_file << "            \"" << key << "\": {\n";
+            write_xyz("                ", "center", c.center, false);
+            write_xyz("                ", "eye", c.eye, false);
+            write_xyz("                ", "up", c.up, true);
+            json_file << (last ? "            }\n" : "            },\n");
+        };
+
+        json_file << "{\n    \"predictions\": [";
+        for (size_t i = 0; i < predictions.size(); ++i)
+        {
+            const auto& p = predictions[i];
+            const bool initial = p.initial_camera.initialized;
+            const bool refined = p.refined_camera.initialized;
+            json_file << (i == 0 ? "\n" : ",\n") << "        {\n";
+            if (initial)
+                write_cam("camera", p.initial_camera, false);
+            json_file << "            \"file\": " << nlohmann::json(p.filename).dump()
+                      << (refined ? ",\n" : "\n");
+            if (refined)
+                write_cam("refined_camera", p.refined_camera, true);
+            json_file << "        }";
+        }
+        json_file << "\n    ],\n    \"sensor\": {\n"
+                  << "        \"fov_x_rad\": " << fovx << ",\n"
+                  << "        \"fov_y_rad\": " << fovy << "\n"
+                  << "    }\n}";
+        return json_file.good();
+    }
+
+    bool load_jsonl(std::string jsonl_filename)
+    {
+        std::ifstream jsonl_file(jsonl_filename);
+        if (jsonl_file.fail())
+        {
+            std::cerr << "ERROR: Could not open jsonl file: " << jsonl_filename << "\n" << std::strerror(errno) << std::endl;
+            return false;
+        }
+        predictions.clear();
+        poses_dirty = true;
+        std::string line;
+        size_t line_number = 0;
+        try
+        {
+            while (std::getline(jsonl_file, line))
+            {
+                ++line_number;
+                if (line.find_first_not_of(" \t\r") == std::string::npos)
+                    continue;
+                nlohmann::json j = nlohmann::json::parse(line);
+                if (j.contains("sensor"))
+                {
+                    fovx = j["sensor"]["fov_x_rad"];
+                    fovy = j["sensor"]["fov_y_rad"];
+                    continue;
+                }
+                predictions.emplace_back(j.at("file").get<std::string>(),
+                    0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f);
+                auto& p = predictions.back();
+                p.initial_camera.initialized = false;
+                if (j.contains("camera"))
+                    prediction_io::read_cam(j["camera"], p.initial_camera);
+                if (j.contains("refined_camera"))
+                    prediction_io::read_cam(j["refined_camera"], p.refined_camera);
+            }
+        } catch (...)
+        {
+            std::cerr << "ERROR: Could not parse jsonl file, line " << line_number << ".\n" << std::endl;
+            return false;
+        }
+        std::cout << "fovx: " << fovx << "\n";
+        std::cout << "fovy: " << fovy << "\n";
+        return true;
+    }
 
-        //nlohmann::json predictions_array = nlohmann::json::array();
-        nlohmann::json j;
-        for (auto& p : predictions)
+    bool export_jsonl(std::string export_path) const
+    {
+        std::ofstream jsonl_file(export_path);
+        if (jsonl_file.fail())
+        {
+            std::cerr << "ERROR: can't write to file: " << export_path << "\n" << std::strerror(errno) << std::endl;
+            return false;
+        }
+        jsonl_file << std::setprecision(std::numeric_limits<float>::max_digits10);
+        jsonl_file << "{\"sensor\":{\"fov_x_rad\":" << fovx << ",\"fov_y_rad\":" << fovy << "}}\n";
+        for (const auto& p : predictions)
         {
-            nlohmann::json entry;
-            entry["file"]        = p.filename;
+            jsonl_file << "{\"file\":" << nlohmann::json(p.filename).dump();
             if (p.initial_camera.initialized)
+                prediction_io::write_cam(jsonl_file, "camera", p.initial_camera);
+            if (p.refined_camera.initialized)
+                prediction_io::write_cam(jsonl_file, "refined_camera", p.refined_camera);
+            jsonl_file << "}\n";
+        }
+        return jsonl_file.good();
+    }
+
+    bool load_binary(std::string binary_filename)
+    {
+        std::ifstream file(binary_filename, std::ios::binary);
+        if (file.fail())
+        {
+            std::cerr << "ERROR: Could not open predictions file: " << binary_filename << "\n" << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        char magic[4];
+        uint32_t version = 0;
+        uint64_t count = 0;
+        file.read(magic, 4);
+        file.read((char*)&version, sizeof(version));
+        file.read((char*)&count, sizeof(count));
+        file.read((char*)&fovx, sizeof(fovx));
+        file.read((char*)&fovy, sizeof(fovy));
+        if (!file || std::memcmp(magic, prediction_io::binary_magic, 4) != 0
+            || version != prediction_io::binary_version)
+        {
+            std::cerr << "ERROR: not a predictions file: " << binary_filename << "\n";
+            return false;
+        }
+
+        // every prediction takes at least its flags, columns and name length:
+        // a count beyond what's left of the file is corrupt (and would
+        // allocate, or overflow count * 18, before the read fails)
+        const std::streamoff header_end = file.tellg();
+        file.seekg(0, std::ios::end);
+        const uint64_t remaining = uint64_t(file.tellg() - header_end);
+        file.seekg(header_end);
+        const uint64_t min_bytes = 1 + 18 * sizeof(float) + sizeof(uint32_t);
+        if (count > remaining / min_bytes)
+        {
+            std::cerr << "ERROR: truncated predictions file: " << binary_filename << "\n";
+            return false;
+        }
+
+        std::vector<uint8_t> flags(count);
+        std::vector<float> columns(count * 18);
+        std::vector<uint32_t> name_lengths(count);
+        file.read((char*)flags.data(), flags.size());
+        file.read((char*)columns.data(), columns.size() * sizeof(float));
+        file.read((char*)name_lengths.data(), name_lengths.size() * sizeof(uint32_t));
+        uint64_t names_size = 0;
+        for (auto l : name_lengths)
+            names_size += l;
+        if (!file || names_size > remaining - count * min_bytes)
+        {
+            std::cerr << "ERROR: truncated predictions file: " << binary_filename << "\n";
+            return false;
+        }
+        std::string names(names_size, '\0');
+        file.read(names.data(), names.size());
+        if (!file)
+        {
+            std::cerr << "ERROR: truncated predictions file: " << binary_filename << "\n";
+            return false;
+        }
+
+        predictions.clear();
+        poses_dirty = true;
+        predictions.reserve(count);
+        size_t name_offset = 0;
+        auto column = [&](size_t c, size_t i) { return columns[c * count + i]; };
+        auto read_cam = [&](size_t first_column, size_t i, cam& c) {
+            auto v = [&](size_t k) {
+                return anari::math::float3{column(first_column + 3 * k, i),
+                    column(first_column + 3 * k + 1, i),
+                    column(first_column + 3 * k + 2, i)};
+            };
+            c.eye = v(0);
+            c.center = v(1);
+            c.up = v(2);
+            c.initialized = true;
+        };
+        for (size_t i = 0; i < count; ++i)
+        {
+            predictions.emplace_back(names.substr(name_offset, name_lengths[i]),
+                0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f);
+            name_offset += name_lengths[i];
+            auto& p = predictions.back();
+            p.initial_camera.initialized = false;
+            if (flags[i] & 1)
+                read_cam(0, i, p.initial_camera);
+            if (flags[i] & 2)
+                read_cam(9, i, p.refined_camera);
+        }
+        return true;
+    }
+
+    bool export_binary(std::string export_path) const
+    {
+        std::ofstream file(export_path, std::ios::binary);
+        if (file.fail())
+        {
+            std::cerr << "ERROR: can't write to file: " << export_path << "\n" << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        const uint64_t count = predictions.size();
+        std::vector<uint8_t> flags(count);
+        std::vector<float> columns(count * 18, 0.f);
+        std::vector<uint32_t> name_lengths(count);
+        auto write_cam = [&](size_t first_column, size_t i, const cam& c) {
+            const anari::math::float3 v[3] = {c.eye, c.center, c.up};
+            for (size_t k = 0; k < 3; ++k)
             {
-                entry["camera"]["eye"]["x"]    = p.initial_camera.eye.x;
-                entry["camera"]["eye"]["y"]    = p.initial_camera.eye.y;
-                entry["camera"]["eye"]["z"]    = p.initial_camera.eye.z;
-                entry["camera"]["center"]["x"] = p.initial_camera.center.x;
-                entry["camera"]["center"]["y"] = p.initial_camera.center.y;
-                entry["camera"]["center"]["z"] = p.initial_camera.center.z;
-                entry["camera"]["up"]["x"]     = p.initial_camera.up.x;
-                entry["camera"]["up"]["y"]     = p.initial_camera.up.y;
-                entry["camera"]["up"]["z"]     = p.initial_camera.up.z;
+                columns[(first_column + 3 * k) * count + i] = v[k].x;
+                columns[(first_column + 3 * k + 1) * count + i] = v[k].y;
+                columns[(first_column + 3 * k + 2) * count + i] = v[k].z;
             }
+        };
+        for (size_t i = 0; i < count; ++i)
+        {
+            const auto& p = predictions[i];
+            flags[i] = (p.initial_camera.initialized ? 1 : 0) | (p.refined_camera.initialized ? 2 : 0);
+            if (p.initial_camera.initialized)
+                write_cam(0, i, p.initial_camera);
             if (p.refined_camera.initialized)
+                write_cam(9, i, p.refined_camera);
+            name_lengths[i] = uint32_t(p.filename.size());
+        }
+
+        file.write(prediction_io::binary_magic, 4);
+        file.write((const char*)&prediction_io::binary_version, sizeof(uint32_t));
+        file.write((const char*)&count, sizeof(count));
+        file.write((const char*)&fovx, sizeof(fovx));
+        file.write((const char*)&fovy, sizeof(fovy));
+        file.write((const char*)flags.data(), flags.size());
+        file.write((const char*)columns.data(), columns.size() * sizeof(float));
+        file.write((const char*)name_lengths.data(), name_lengths.size() * sizeof(uint32_t));
+        for (const auto& p : predictions)
+            file.write(p.filename.data(), p.filename.size());
+        return file.good();
+    }
+
+    // apply refined cameras appended by prediction_journal; entries are
+    // matched by index and file name
+    bool replay_journal(std::string journal_path)
+    {
+        std::ifstream journal(journal_path);
+        if (journal.fail())
+            return false;
+        std::string line;
+        size_t applied = 0;
+        while (std::getline(journal, line))
+        {
+            try
+            {
+                nlohmann::json j = nlohmann::json::parse(line);
+                size_t index = j.at("index");
+                std::string file = j.at("file");
+                if (index >= predictions.size() || predictions[index].filename != file)
+                {
+                    std::cerr << "WARNING: journal entry for " << file << " doesn't match the predictions\n";
+                    continue;
+                }
+                prediction_io::read_cam(j.at("refined_camera"), predictions[index].refined_camera);
+                ++applied;
+                poses_dirty = true;
+            } catch (...)
             {
-                entry["refined_camera"]["eye"]["x"]    = p.refined_camera.eye.x;
-                entry["refined_camera"]["eye"]["y"]    = p.refined_camera.eye.y;
-                entry["refined_camera"]["eye"]["z"]    = p.refined_camera.eye.z;
-                entry["refined_camera"]["center"]["x"] = p.refined_camera.center.x;
-                entry["refined_camera"]["center"]["y"] = p.refined_camera.center.y;
-                entry["refined_camera"]["center"]["z"] = p.refined_camera.center.z;
-                entry["refined_camera"]["up"]["x"]     = p.refined_camera.up.x;
-                entry["refined_camera"]["up"]["y"]     = p.refined_camera.up.y;
-                entry["refined_camera"]["up"]["z"]     = p.refined_camera.up.z;
+                // torn write, e.g. after a crash
+                std::cerr << "WARNING: skipping incomplete journal entry in " << journal_path << "\n";
             }
-            j["predictions"].push_back(entry);
         }
-        j["sensor"]["fov_x_rad"] = fovx;
-        j["sensor"]["fov_y_rad"] = fovy;
-        json_file << j.dump(4);
+        std::cout << "Replayed " << applied << " refined camera(s) from " << journal_path << "\n";
         return true;
     }
 };
+
+// Append-only log of refined cameras; each entry is one flushed JSONL line,
+// so saving a camera doesn't rewrite the predictions file
+struct prediction_journal
+{
+    std::ofstream file;
+    std::string path;
+
+    bool open(std::string journal_path)
+    {
+        path = journal_path;
+        // a crash may have left a torn last line; end it so the next entry
+        // starts a line of its own (replay skips the torn one)
+        bool torn = false;
+        {
+            std::ifstream existing(journal_path, std::ios::binary | std::ios::ate);
+            if (existing && existing.tellg() > 0)
+            {
+                existing.seekg(-1, std::ios::end);
+                torn = existing.get() != '\n';
+            }
+        }
+        file.open(journal_path, std::ios::app);
+        if (file.fail())
+        {
+            std::cerr << "ERROR: can't write to file: " << journal_path << "\n" << std::strerror(errno) << std::endl;
+            return false;
+        }
+        if (torn)
+            file << '\n' << std::flush;
+        file << std::setprecision(std::numeric_limits<float>::max_digits10);
+        return file.good();
+    }
+
+    bool is_open() const
+    {
+        return file.is_open();
+    }
+
+    bool append_refined(size_t index, const prediction& p)
+    {
+        if (!file.is_open())
+            return false;
+        file << "{\"index\":" << index << ",\"file\":" << nlohmann::json(p.filename).dump();
+        prediction_io::write_cam(file, "refined_camera", p.refined_camera);
+        file << "}\n" << std::flush;
+        return file.good();
+    }
+};
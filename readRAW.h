@@ -4,9 +4,51 @@
 #pragma once
 
 #include <stdio.h>
+// std
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 // ours
 #include "FieldTypes.h"
 
+// Guess dimensions and data type from a file name like
+// "name_256x256x128_uint16.raw"; only fills in values that are found
+inline bool guessRAWFormat(const std::string &fileName,
+    int &dimX,
+    int &dimY,
+    int &dimZ,
+    unsigned &bytesPerCell)
+{
+  std::istringstream stream(fileName);
+  for (std::string str; std::getline(stream, str, '_');) {
+    int dimx, dimy, dimz;
+    int res = sscanf(str.c_str(), "%ix%ix%i", &dimx, &dimy, &dimz);
+    if (res == 3) {
+      dimX = dimx;
+      dimY = dimy;
+      dimZ = dimz;
+    }
+
+    int bits = 0;
+    res = sscanf(str.c_str(), "int%i", &bits);
+    if (res == 1)
+      bytesPerCell = bits / 8;
+
+    res = sscanf(str.c_str(), "uint%i", &bits);
+    if (res == 1)
+      bytesPerCell = bits / 8;
+
+    if (dimX && dimY && dimZ && bytesPerCell)
+      break;
+  }
+
+  if (!bytesPerCell)
+    bytesPerCell = 4;
+
+  return dimX && dimY && dimZ && bytesPerCell;
+}
+
 struct RAWReader
 {
   ~RAWReader()
@@ -32,7 +74,8 @@ struct RAWReader
     return true;
   }
 
-  const StructuredField &getField(int index = 0)
+  // the single field of the file, read on first use
+  const StructuredField &getField()
   {
     if (field.empty()) {
       auto readData =
@@ -0,0 +1,109 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+// std
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+// ours
+#include "prediction.h"
+
+static int g_failures = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok) {
+    std::printf("FAILED: %s\n", what);
+    ++g_failures;
+  }
+}
+
+static prediction_container makePredictions()
+{
+  prediction_container c;
+  c.fovx = c.fovy = .5f;
+  c.predictions.emplace_back(
+      "a.png", 0.f, 0.f, 10.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f);
+  c.predictions.emplace_back(
+      "b.png", 10.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f);
+  return c;
+}
+
+// a crash mid-write leaves a torn last line; entries appended after
+// reopening must still replay
+static void testTornJournal(const std::filesystem::path &dir)
+{
+  const std::string filename = (dir / "predictions.jsonl").string();
+  const std::string journalFile =
+      prediction_container::journal_filename(filename);
+  auto c = makePredictions();
+  check(c.save(filename), "save predictions");
+
+  {
+    prediction_journal journal;
+    check(journal.open(journalFile), "open journal");
+    const uint64_t revision = c.revision;
+    c.set_refined_camera(0, {0.f, 1.f, 10.f}, {0.f, 0.f, 0.f}, {0.f, 1.f, 0.f});
+    check(c.revision != revision, "refining bumps the revision");
+    check(journal.append_refined(0, c[0]), "append entry 0");
+  }
+  {
+    std::ofstream torn(journalFile, std::ios::app);
+    torn << "{\"index\":0,\"file\":\"a.png\",\"refined_cam";
+  }
+  {
+    prediction_journal journal;
+    check(journal.open(journalFile), "reopen journal");
+    c.set_refined_camera(1, {10.f, 1.f, 0.f}, {0.f, 0.f, 0.f}, {0.f, 1.f, 0.f});
+    check(journal.append_refined(1, c[1]), "append entry 1");
+  }
+
+  prediction_container reloaded(filename);
+  check(reloaded.predictions.size() == 2, "reload predictions");
+  if (reloaded.predictions.size() == 2) {
+    check(reloaded[0].refined_camera.initialized, "refined[0] after reload");
+    check(reloaded[1].refined_camera.initialized, "refined[1] after reload");
+    check(reloaded[1].refined_camera.eye.y == 1.f, "refined[1] eye");
+  }
+}
+
+// a corrupt count fails the load instead of allocating
+static void testCorruptBinary(const std::filesystem::path &dir)
+{
+  const std::string filename = (dir / "corrupt.predbin").string();
+  check(makePredictions().save(filename), "save binary predictions");
+  {
+    std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+    const uint64_t count = uint64_t(1) << 62;
+    file.seekp(8);
+    file.write((const char *)&count, sizeof(count));
+  }
+  prediction_container c;
+  bool threw = false, loaded = true;
+  try {
+    loaded = c.load(filename);
+  } catch (...) {
+    threw = true;
+  }
+  check(!threw && !loaded, "corrupt count fails to load");
+
+  // truncated names
+  const std::string truncated = (dir / "truncated.predbin").string();
+  check(makePredictions().save(truncated), "save binary predictions");
+  std::filesystem::resize_file(
+      truncated, std::filesystem::file_size(truncated) - 3);
+  check(!c.load(truncated), "truncated file fails to load");
+}
+
+int main()
+{
+  const auto dir = std::filesystem::temp_directory_path() / "drr_test_predictions";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  testTornJournal(dir);
+  testCorruptBinary(dir);
+  std::filesystem::remove_all(dir);
+  if (g_failures == 0)
+    std::printf("all passed\n");
+  return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+// Copyright 2024 Matthias Hellmann
+// SPDX-License-Identifier: Apache-2.0
+
+// std
+#include <cmath>
+#include <cstdio>
+#include <random>
+// ours
+#include "SimilarityMetrics.h"
+
+static int g_failures = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok) {
+    std::printf("FAILED: %s\n", what);
+    ++g_failures;
+  }
+}
+
+// two-pass NCC in double
+static double referenceNcc(const MetricImage &a, const MetricImage &b)
+{
+  const size_t n = a.pixels.size();
+  double ma = 0.0, mb = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    ma += a.pixels[i];
+    mb += b.pixels[i];
+  }
+  ma /= n;
+  mb /= n;
+  double cov = 0.0, va = 0.0, vb = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    const double da = a.pixels[i] - ma, db = b.pixels[i] - mb;
+    cov += da * db;
+    va += da * da;
+    vb += db * db;
+  }
+  return cov / std::sqrt(va * vb);
+}
+
+// native 16 bit detector values: a large offset, little contrast
+static void testHighOffset(float contrast)
+{
+  const int w = 257, h = 131;
+  std::mt19937 rng(7);
+  std::normal_distribution<float> noise(0.f, 1.f);
+  MetricImage a{w, h, std::vector<float>(size_t(w) * h)};
+  MetricImage b = a;
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      const float signal = std::sin(x * .05f) * std::cos(y * .07f);
+      a.pixels[size_t(y) * w + x] =
+          std::round(30000.f + contrast * (signal + .3f * noise(rng)));
+      b.pixels[size_t(y) * w + x] =
+          std::round(30000.f + contrast * (signal + .3f * noise(rng)));
+    }
+  }
+
+  MetricSettings settings;
+  settings.numThreads = 3;
+  const double expected = referenceNcc(a, b);
+  const float ncc = computeMetric(Metric::NCC, a, b, nullptr, settings);
+  char what[128];
+  std::snprintf(what,
+      sizeof(what),
+      "NCC at offset 30000, contrast %g: %f, expected %f",
+      contrast,
+      ncc,
+      expected);
+  check(std::abs(ncc - expected) < 1e-3, what);
+
+  // the offset doesn't change any of the metrics
+  MetricImage a0 = a, b0 = b;
+  for (auto &v : a0.pixels)
+    v -= 30000.f;
+  for (auto &v : b0.pixels)
+    v -= 30000.f;
+  for (int m = 0; m < NUM_METRICS; ++m) {
+    const Metric metric = Metric(m);
+    if (metric == Metric::MUTUAL_INFORMATION)
+      continue; // binned over the same range either way
+    const float shifted = computeMetric(metric, a, b, nullptr, settings);
+    const float plain = computeMetric(metric, a0, b0, nullptr, settings);
+    std::snprintf(what,
+        sizeof(what),
+        "%s at offset 30000, contrast %g: %f, without offset %f",
+        toString(metric),
+        contrast,
+        shifted,
+        plain);
+    check(std::abs(shifted - plain) < 1e-3, what);
+  }
+}
+
+int main()
+{
+  testHighOffset(4.f);
+  testHighOffset(20.f);
+  if (g_failures == 0)
+    std::printf("all passed\n");
+  return g_failures == 0 ? 0 : 1;
+}
@@ -192,7 +192,7 @@ bool buildUI(ParameterInfo &p)
   return update;
 }
 
-void buildUI(anari::Device d, anari::Object o, ParameterInfo &p)
+bool buildUI(anari::Device d, anari::Object o, ParameterInfo &p)
 {
   ANARIDataType type = p.value.type();
   const char *name = p.name.c_str();
@@ -204,7 +204,9 @@ void buildUI(anari::Device d, anari::Object o, ParameterInfo &p)
     else
       anari::setParameter(d, o, name, type, value);
     anari::commitParameters(d, o);
+    return true;
   }
+  return false;
 }
 
 } // namespace anari_viewer::ui
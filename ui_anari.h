@@ -26,6 +26,7 @@ ParameterInfoList parseParameters(
     anari::Device d, ANARIDataType objectType, const char *subtype);
 
 bool buildUI(ParameterInfo &p);
-void buildUI(anari::Device d, anari::Object o, ParameterInfo &p);
+// returns true if the parameter was changed (and committed)
+bool buildUI(anari::Device d, anari::Object o, ParameterInfo &p);
 
 } // namespace anari_viewer::ui
@@ -4,7 +4,6 @@
 // glm
 #include "glm/gtc/matrix_transform.hpp"
 // visionaray
-#include <common/image.h>
 #include <visionaray/pinhole_camera.h>
 #include <visionaray/swizzle.h>
 #include <common/manip/arcball_manipulator.h>
@@ -12,23 +11,39 @@
 #include <common/manip/zoom_manipulator.h>
 // std
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <random>
 #include <sstream>
+#include <thread>
 // ours
 #include "Application.h"
+#include "AutoRefine.h"
+#include "Benchmark.h"
+#include "CpuDrrRenderer.h"
 #include "FieldTypes.h"
-#include "Image.h"
+#include "ImageCache.h"
+#include "ImageRegion.h"
 #include "ImageTransformEstimatorWrapper.h"
 #include "ImageViewport.h"
 #include "LacTransform.h"
+#include "MatchJob.h"
+#include "MatchRace.h"
+#include "PoseOptimizer.h"
 #include "prediction.h"
 #include "PredictionsEditor.h"
 #include "readRAW.h"
+#include "Registration.h"
 #ifdef HAVE_ITK
 #include "readNifti.h"
 #endif
+#include "ScreenshotWriter.h"
+#include "VolumeOfInterest.h"
 #include "SettingsEditor.h"
 #include "Viewport.h"
 
@@ -48,6 +63,12 @@ static std::string g_jsonfile;
 static std::string g_laclutfile;
 static size_t g_laclutid{0};
 static std::vector<std::string> g_estimatorLibraryNames{};
+static anari::DataType g_colorFormat{ANARI_UFIXED8_RGBA_SRGB};
+static BenchmarkSpec g_benchmark;
+static bool g_runBenchmark{false};
+static size_t g_imageMemoryBudget{size_t(1) << 30};
+static bool g_preloadImages{false};
+static std::string g_exportFormat{"json"};
 
 static const char *g_defaultLayout =
     R"layout(
@@ -103,13 +124,16 @@ struct AppState
   anari::SpatialField field{nullptr};
   anari::Volume volume{nullptr};
   StructuredField sdata;
+  // the field uploaded to the device is cropped to it
+  VolumeOfInterest voi;
 #ifdef HAVE_ITK
   LacReader lacReader;
   NiftiReader niftiReader;
 #endif
   RAWReader rawReader;
   prediction_container predictions;
-  std::vector<Image> images;
+  prediction_journal journal;
+  std::unique_ptr<ImageCache> images;
   ImageTransformEstimatorWrapper estimators;
 };
 
@@ -145,19 +169,6 @@ static std::string getExt(const std::string &fileName)
   return fileName.substr(pos);
 }
 
-static std::vector<std::string> string_split(std::string s, char delim)
-{
-  std::vector<std::string> result;
-
-  std::istringstream stream(s);
-
-  for (std::string token; std::getline(stream, token, delim);) {
-    result.push_back(token);
-  }
-
-  return result;
-}
-
 static void initializeANARI()
 {
   auto library =
@@ -206,123 +217,270 @@ class Application : public anari_viewer::Application
   Application() = default;
   ~Application() override = default;
 
-  void screenshot(std::vector<uint8_t> &fb,
-                  size_t width,
-                  size_t height,
-                  anari::math::float3 eye,
-                  anari::math::float3 center,
-                  anari::math::float3 up,
-                  float fovy)
+  // Fetch the current frame in the layout handed to the estimators: a single
+  // windowed R8 plane for single-channel output, RGBA8 otherwise
+  static image_transform_estimator::PIXEL_TYPE getFrameForEstimator(
+      anari_viewer::windows::DRRViewport *viewport,
+      std::vector<uint8_t> &fb,
+      std::vector<float> &depth3d,
+      size_t &width,
+      size_t &height)
   {
-    // Swizzle to RGB8 for compatibility with pnm image
-    std::vector<visionaray::vector<4, visionaray::unorm<8>>> rgba(width * height);
-    memcpy(rgba.data(), fb.data(), width * height * 4);
-    std::vector<visionaray::vector<3, visionaray::unorm<8>>> rgb(width * height);
-    for (size_t i=0; i<rgb.size(); ++i)
-    {
-        rgb[i] = visionaray::vector<3, visionaray::unorm<8>>(rgba[i].x, rgba[i].y, rgba[i].z);
+    if (viewport->isSingleChannel()) {
+      viewport->getFrameR8(fb, depth3d, width, height);
+      return image_transform_estimator::PIXEL_TYPE::R8;
     }
+    anari::DataType format;
+    viewport->getFrame(fb, format, depth3d, width, height);
+    return image_transform_estimator::PIXEL_TYPE::RGBA8;
+  }
 
-    // Flip horizontally
-    std::vector<visionaray::vector<3, visionaray::unorm<8>>> flipped(width * height);
-    for (int y = 0; y < height; ++y)
-    {
-      for (int x = 0; x < width; ++x)
-      {
-        auto xx = width - x - 1;
-        flipped[y * width + x] = rgb[y * width + xx];
-      }
+  // Reference image in a layout the estimators take; high bit depth images
+  // are narrowed to R8, others shared with the image. No data if the pixel
+  // type is unsupported
+  static MatchReference matchReference(std::shared_ptr<const Image> image)
+  {
+    MatchReference reference;
+    const uint8_t *data = image->data.data();
+    auto gray = std::make_shared<std::vector<uint8_t>>();
+    switch (image->type) {
+    case Image::PixelType::R8:
+      reference.pixelType = image_transform_estimator::PIXEL_TYPE::R8;
+      break;
+    case Image::PixelType::RGB8:
+      reference.pixelType = image_transform_estimator::PIXEL_TYPE::RGB8;
+      break;
+    case Image::PixelType::RGBA8:
+      reference.pixelType = image_transform_estimator::PIXEL_TYPE::RGBA8;
+      break;
+    case Image::PixelType::R16:
+    case Image::PixelType::R32F:
+      // the estimator ABI has no high bit depth types
+      narrowToR8(*image, *gray);
+      data = gray->data();
+      reference.pixelType = image_transform_estimator::PIXEL_TYPE::R8;
+      break;
+    default:
+      return reference;
     }
+    // the estimator only reads the (shared, cached) image; kept for races,
+    // which hand it to every estimator
+    reference.data = gray->empty()
+        ? std::shared_ptr<const uint8_t>(image, data)
+        : std::shared_ptr<const uint8_t>(gray, data);
+    reference.width = image->width;
+    reference.height = image->height;
+    reference.swizzle = true;
+    return reference;
+  }
 
-    visionaray::image img(
-        width,
-        height,
-        visionaray::PF_RGB8,
-        reinterpret_cast<uint8_t const*>(flipped.data())
-        );
-
-    int inc = 0;
-    std::string inc_str = "";
-    std::string screenshot_file_base{"screenshot"};
-    std::string filename = screenshot_file_base + inc_str + ".png";
-    while (std::filesystem::exists(filename))
-    {
-      ++inc;
-      inc_str = std::to_string(inc);
-      while (inc_str.length() < 4)
-        inc_str = std::string("0") + inc_str;
-      inc_str = std::string("-") + inc_str;
-      filename = screenshot_file_base + inc_str + ".png";
+  // The part of the reference image seen through an image region of the
+  // viewport (see ImageRegion.h); a framebuffer reference already covers
+  // the region it was captured with
+  std::shared_ptr<const Image> regionReference(const ImageRegion &region) const
+  {
+    if (!m_referenceImage || region == m_referenceRegion)
+      return m_referenceImage;
+    const ImageRegion relative{
+        std::min(region.width / m_referenceRegion.width, 1.f),
+        std::min(region.height / m_referenceRegion.height, 1.f)};
+    return std::make_shared<const Image>(
+        cropToRegion(*m_referenceImage, relative));
+  }
+
+  MatchReference regionMatchReference(const ImageRegion &region) const
+  {
+    return region == m_referenceRegion
+        ? m_reference
+        : matchReference(regionReference(region));
+  }
+
+  // Snapshot of the viewport for a match: the frame covers the viewport's
+  // image region, so the camera gets the region's field of view, and the
+  // reference is handed over again whenever the estimator holds another
+  // region's part of it. Returns the region
+  ImageRegion matchSnapshot(
+      anari_viewer::windows::DRRViewport *viewport, MatchInput &input)
+  {
+    input.pixelType = getFrameForEstimator(
+        viewport, input.frame, input.depth3d, input.width, input.height);
+    viewport->getView(
+        input.eye, input.center, input.up, input.fovy, input.aspect);
+    const ImageRegion region = viewport->imageRegion();
+    input.fovy = region.fovy(input.fovy);
+    input.aspect = region.aspect(input.aspect);
+    if (m_referenceImage && region != m_estimatorRegion)
+      input.reference = regionMatchReference(region);
+    return region;
+  }
+
+  // store a refined camera, appended to the journal instead of rewriting the
+  // predictions
+  void saveRefinedCamera(size_t index,
+      const anari::math::float3 &eye,
+      const anari::math::float3 &center,
+      const anari::math::float3 &up)
+  {
+    m_state.predictions.set_refined_camera(index, eye, center, up);
+    if (!m_state.journal.is_open())
+      m_state.journal.open(prediction_container::journal_filename(g_jsonfile));
+    m_state.journal.append_refined(index, m_state.predictions[index]);
+  }
+
+  // one step of the auto-refine loop per UI frame: wait for the frame at the
+  // current pose to converge, submit it for matching, move to the matched
+  // pose and repeat until AutoRefine stops
+  void updateAutoRefine(bool matched, const MatchResult &match)
+  {
+    auto *viewport = m_viewport;
+    if (m_autoRefine.stopRequested()) {
+      m_matchJob.cancel();
+      m_autoRefine.finish(AutoRefine::StopReason::CANCELLED);
+      return;
     }
 
-    visionaray::image::save_option opt;
-    if (img.save(filename, {opt}))
-      std::cout << "Screenshot saved to file: " << filename << '\n';
-    else
-      std::cerr << "Error saving screenshot to file: " << filename << '\n';
-
-    // export camera
-    std::string json_filename{screenshot_file_base + inc_str + ".json"};
-    std::ofstream json_file(json_filename);
-    if (json_file.fail()) {
-      std::cerr << "ERROR: Could not open json file: " << json_filename << "\n"
-                << std::strerror(errno) << std::endl;
+    if (m_autoRefine.phase() == AutoRefine::Phase::RENDERING) {
+      if (!viewport->frameSettled())
+        return;
+      const float renderMs = std::chrono::duration<float, std::milli>(
+          std::chrono::steady_clock::now() - m_autoRefineRenderStart)
+                                 .count();
+
+      MatchInput input;
+      const ImageRegion region = matchSnapshot(viewport, input);
+      const bool setsReference = bool(input.reference.data);
+
+      // the prediction's image covers the full view
+      float residual = std::numeric_limits<float>::quiet_NaN();
+      if (auto reference = m_state.images->get(m_autoRefine.prediction())) {
+        size_t bpp =
+            input.pixelType == image_transform_estimator::PIXEL_TYPE::R8 ? 1 : 4;
+        const Image cropped =
+            region.full() ? Image() : cropToRegion(*reference, region);
+        residual = imageResidual(input.frame.data(),
+            bpp,
+            input.width,
+            input.height,
+            region.full() ? *reference : cropped);
+      }
+
+      if (!m_autoRefine.rendered(renderMs, residual))
+        finishAutoRefine();
+      else if (!m_matchJob.submit(
+                   m_state.estimators.getActiveEstimator(), std::move(input)))
+        m_autoRefine.finish(AutoRefine::StopReason::FAILED);
+      else if (setsReference)
+        m_estimatorRegion = region;
       return;
     }
-    try {
-      nlohmann::json data;
-      const auto fovx = fovy;
-      data["sensor"]["fov_x_rad"] = fovx;
-      data["sensor"]["fov_y_rad"] = fovy;
-      data["predictions"]["file"] = filename;
-      data["predictions"]["eye"]["x"] = eye.x;
-      data["predictions"]["eye"]["y"] = eye.y;
-      data["predictions"]["eye"]["z"] = eye.z;
-      data["predictions"]["center"]["x"] = center.x;
-      data["predictions"]["center"]["y"] = center.y;
-      data["predictions"]["center"]["z"] = center.z;
-      data["predictions"]["up"]["x"] = up.x;
-      data["predictions"]["up"]["y"] = up.y;
-      data["predictions"]["up"]["z"] = up.z;
-      json_file << data.dump(4);
-    } catch (...) {
-      std::cerr << "ERROR: Could not parse json file.\n" << std::endl;
+
+    // matching
+    if (!matched) {
+      // cancelled from the editor
+      if (!m_matchJob.busy())
+        m_autoRefine.finish(AutoRefine::StopReason::CANCELLED);
+      return;
     }
+    if (m_autoRefine.matched({match.eye, match.center, match.up},
+            match.seconds * 1000.f)) {
+      viewport->setView(match.eye, match.center, match.up);
+      m_autoRefineRenderStart = std::chrono::steady_clock::now();
+    } else
+      finishAutoRefine();
+  }
+
+  void finishAutoRefine()
+  {
+    const auto &pose = m_autoRefine.result();
+    m_viewport->setView(pose.eye, pose.center, pose.up);
+    saveRefinedCamera(m_autoRefine.prediction(), pose.eye, pose.center, pose.up);
+    printf("auto-refine: refined camera of image %zu saved\n",
+        m_autoRefine.prediction() + 1);
+  }
+
+  // a match job or race is using the estimators, or the pose optimizer is
+  // rendering the field
+  bool estimatorsBusy() const
+  {
+    return m_matchJob.busy() || m_matchRace.busy() || m_poseOptimizer.busy();
+  }
+
+  // run now or, while a match job, race or the pose optimizer is busy, once
+  // it is done
+  void withEstimator(std::function<void()> call)
+  {
+    if (estimatorsBusy())
+      m_deferredEstimatorCalls.push_back(std::move(call));
+    else
+      call();
+  }
+
+  // Race score of a proposed camera: 1 - NCC between a CPU re-render (at
+  // most 256 pixels wide) and the reference image (of the input's region);
+  // none without a reference image or volume
+  MatchRace::ScoreFunction raceScore(
+      const MatchInput &input, std::shared_ptr<const Image> reference)
+  {
+    if (!reference || m_state.sdata.empty() || input.width == 0)
+      return {};
+    const int width = int(std::min<size_t>(input.width, 256));
+    const int height =
+        std::max(1, int(input.height * width / float(input.width)));
+    const float fovy = input.fovy, aspect = input.aspect;
+    const CpuDrrRenderer *renderer = &m_scoreRenderer;
+    return [=](const MatchResult &match) {
+      CpuDrrFrame frame;
+      CpuDrrCamera camera{match.eye, match.center, match.up, fovy, aspect};
+      if (!renderer->render(camera, width, height, frame))
+        return std::numeric_limits<float>::quiet_NaN();
+      std::vector<uint8_t> gray;
+      std::vector<float> depth3d;
+      frameForEstimator(frame, gray, depth3d);
+      return imageResidual(gray.data(), 1, width, height, *reference);
+    };
   }
 
   void commitField()
   {
     auto device = m_state.device;
-    auto &data = m_state.sdata;
+    // with a volume of interest only its voxels are uploaded, at their place
+    // in the volume
+    const StructuredField crop = m_state.voi.empty()
+        ? StructuredField{}
+        : cropField(m_state.sdata, m_state.voi);
+    const bool cropped = crop.dimX > 0;
+    const auto &data = cropped ? crop : m_state.sdata;
+    const VolumeOfInterest voi = m_state.voi.clippedTo(m_state.sdata);
 
     auto field =
         anari::newObject<anari::SpatialField>(device, "structuredRegular");
 
-    anari::Array3D scalar;
+    const void *voxels = data.dataF32.data();
+    ANARIDataType type = ANARI_FLOAT32;
     if (data.bytesPerCell == 1) {
-      scalar = anariNewArray3D(device,
-          data.dataUI8.data(),
-          0,
-          0,
-          ANARI_UFIXED8,
-          data.dimX,
-          data.dimY,
-          data.dimZ);
+      voxels = data.dataUI8.data();
+      type = ANARI_UFIXED8;
     } else if (data.bytesPerCell == 2) {
+      voxels = data.dataUI16.data();
+      type = ANARI_UFIXED16;
+    }
+
+    // the volume is shared with the device, the (temporary) crop is copied
+    // into an array it owns
+    anari::Array3D scalar;
+    if (cropped) {
+      scalar = anariNewArray3D(
+          device, nullptr, 0, 0, type, data.dimX, data.dimY, data.dimZ);
+      std::memcpy(anariMapArray(device, scalar),
+          voxels,
+          size_t(data.dimX) * data.dimY * data.dimZ * data.bytesPerCell);
+      anariUnmapArray(device, scalar);
+    } else {
       scalar = anariNewArray3D(device,
-          data.dataUI16.data(),
-          0,
-          0,
-          ANARI_UFIXED16,
-          data.dimX,
-          data.dimY,
-          data.dimZ);
-    } else if (data.bytesPerCell == 4) {
-      scalar = anariNewArray3D(device,
-          data.dataF32.data(),
+          voxels,
           0,
           0,
-          ANARI_FLOAT32,
+          type,
           data.dimX,
           data.dimY,
           data.dimZ);
@@ -332,6 +490,7 @@ class Application : public anari_viewer::Application
     anari::setParameter(device, field, "filter", ANARI_STRING, "linear");
     float spacing[3]{data.spacingX, data.spacingY, data.spacingZ};
     anari::setParameter(device, field, "spacing", ANARI_FLOAT32_VEC3, spacing);
+    anari::setParameter(device, field, "origin", voi.origin(m_state.sdata));
 
     anari::commitParameters(device, field);
     m_state.field = field;
@@ -392,33 +551,7 @@ class Application : public anari_viewer::Application
     // (if not already set)
     if (getExt(g_filename) == ".raw" && !g_dimX && !g_dimY && !g_dimZ
         && !g_bytesPerCell) {
-      std::vector<std::string> strings;
-      strings = string_split(g_filename, '_');
-
-      for (auto str : strings) {
-        int dimx, dimy, dimz;
-        int res = sscanf(str.c_str(), "%ix%ix%i", &dimx, &dimy, &dimz);
-        if (res == 3) {
-          g_dimX = dimx;
-          g_dimY = dimy;
-          g_dimZ = dimz;
-        }
-
-        int bits = 0;
-        res = sscanf(str.c_str(), "int%i", &bits);
-        if (res == 1)
-          g_bytesPerCell = bits / 8;
-
-        res = sscanf(str.c_str(), "uint%i", &bits);
-        if (res == 1)
-          g_bytesPerCell = bits / 8;
-
-        if (g_dimX && g_dimY && g_dimZ && g_bytesPerCell)
-          break;
-      }
-
-      if (!g_bytesPerCell)
-        g_bytesPerCell = 4;
+      guessRAWFormat(g_filename, g_dimX, g_dimY, g_dimZ, g_bytesPerCell);
 
       if (g_dimX && g_dimY && g_dimZ && g_bytesPerCell) {
         std::cout
@@ -452,7 +585,7 @@ class Application : public anari_viewer::Application
     if (g_dimX && g_dimY && g_dimZ && g_bytesPerCell
         && m_state.rawReader.open(
             g_filename.c_str(), g_dimX, g_dimY, g_dimZ, g_bytesPerCell)) {
-      m_state.sdata = m_state.rawReader.getField(0);
+      m_state.sdata = m_state.rawReader.getField();
       commitField();
     }
 #ifdef HAVE_ITK
@@ -468,52 +601,16 @@ class Application : public anari_viewer::Application
     // Predictions from JSON //
     if (!g_jsonfile.empty())
       m_state.predictions = prediction_container(g_jsonfile);
-    // load images
-    if (!m_state.predictions.predictions.empty())
-    {
-      for (auto it = m_state.predictions.begin(); it != m_state.predictions.end(); ++it)
-      {
-        if (!std::filesystem::exists(it->filename))
-        {
-          std::cerr << "File does not exist: " << it->filename << "\n";
-          continue;
-        }
-        visionaray::image visionarayImage;
-        if (!visionarayImage.load(it->filename))
-        {
-          std::cerr << "Could not load " << it->filename << "\n";
-          continue;
-        }
-        std::string pf{"PF_UNKNOWN"};
-        size_t bpp{4};
-        switch (visionarayImage.format())
-        {
-          case visionaray::pixel_format::PF_R8:
-            bpp = 1;
-            pf = "PF_R8";
-            break;
-          case visionaray::pixel_format::PF_RGB8:
-            bpp = 3;
-            pf = "PF_RGB8";
-            break;
-          case visionaray::pixel_format::PF_RGBA8:
-            bpp = 4;
-            pf = "PF_RGBA8";
-            break;
-          default:
-            std::cerr << "ERROR: " << it->filename << " has unsupported pixel format.\n";
-            continue;
-        }
-        std::cout << "Loaded " << it->filename << ": ("
-            << visionarayImage.width() << "x" << visionarayImage.height()
-            << ", " << pf << ")\n";
-        m_state.images.emplace_back(visionarayImage.width(),
-                                    visionarayImage.height(),
-                                    bpp,
-                                    visionarayImage.data());
-      }
-    }
-
+    // reference images, decoded on demand
+    std::vector<std::string> imageFilenames;
+    for (const auto &p : m_state.predictions)
+      imageFilenames.push_back(p.filename);
+    // preloading keeps every image, regardless of the budget
+    m_state.images = std::make_unique<ImageCache>(std::move(imageFilenames),
+        g_preloadImages ? std::numeric_limits<size_t>::max()
+                        : g_imageMemoryBudget);
+    if (g_preloadImages)
+      m_state.images->preloadAll();
 
     // ImGui //
 
@@ -532,9 +629,17 @@ class Application : public anari_viewer::Application
     viewport->addManipulator( std::make_shared<visionaray::pan_manipulator>(m_state.camera, visionaray::mouse::Left, visionaray::keyboard::Alt) );
     viewport->addManipulator( std::make_shared<visionaray::zoom_manipulator>(m_state.camera, visionaray::mouse::Right) );
     viewport->setDefaultFovYRad(m_state.predictions.fovy);
+    viewport->setColorFormat(g_colorFormat);
+    viewport->setCpuRendererField(&m_state.sdata);
     viewport->resetView();
 
-    auto *imageViewport = new anari_viewer::windows::ImageViewport(m_state.images);
+    // races re-render the proposals in parallel, one per estimator
+    m_scoreRenderer.setField(&m_state.sdata);
+    m_scoreRenderer.setNumThreads(std::max<unsigned>(1,
+        std::thread::hardware_concurrency()
+            / std::max<size_t>(1, m_state.estimators.m_estimators.size())));
+
+    auto *imageViewport = new anari_viewer::windows::ImageViewport(*m_state.images);
 
     auto *seditor = new anari_viewer::windows::SettingsEditor();
     seditor->setLacLutNames(m_state.lacReader.getNames());
@@ -544,25 +649,45 @@ class Application : public anari_viewer::Application
         [=](const float &scatterFraction) { viewport->setScatterFraction(scatterFraction); });
     seditor->setUpdateScatterSigmaCallback(
         [=](const float &scatterSigma) { viewport->setScatterSigma(scatterSigma); });
+    // the viewport starts without scatter, hand it the editor's defaults
+    seditor->triggerUpdateScatterFractionCallback();
+    seditor->triggerUpdateScatterSigmaCallback();
+    // the field is also read by race scoring and the pose optimizer, changes
+    // wait for them to end
     seditor->setUpdateVoxelSpacingCallback(
         [=, this](const std::array<float, 3> &voxelSpacing) {
+          withEstimator([=, this]() {
+            viewport->setCpuRendererField(nullptr);
+            m_state.sdata.spacingX = voxelSpacing[0];
+            m_state.sdata.spacingY = voxelSpacing[1];
+            m_state.sdata.spacingZ = voxelSpacing[2];
+            // the volume of interest moves with its voxels
+            const VolumeOfInterest voi = m_state.voi.clippedTo(m_state.sdata);
             anari::setParameter(device, m_state.field, "spacing", ANARI_FLOAT32_VEC3, voxelSpacing.data());
+            anari::setParameter(device, m_state.field, "origin", voi.origin(m_state.sdata));
             anari::commitParameters(device, m_state.field);
+            viewport->setCpuRendererField(&m_state.sdata);
+          });
         });
     seditor->setUpdateLacLutCallback(
         [=, this](const size_t &lacLutId) {
+          withEstimator([=, this]() {
             if (m_state.volume)
             {
               m_state.lacReader.setActiveLut(lacLutId);
+              viewport->setCpuRendererField(nullptr);
               m_state.sdata = m_state.niftiReader.getField(0, m_state.lacReader);
+              viewport->setCpuRendererField(&m_state.sdata);
               commitField();
               anari::setParameter(device, m_state.volume, "value", m_state.field);
               anari::setParameter(device, m_state.volume, "field", m_state.field);
               anari::commitParameters(device, m_state.volume);
             }
+          });
         });
 
     auto *peditor = new anari_viewer::windows::PredictionsEditor(m_state.predictions, m_state.estimators.m_estimatorNames);
+    m_predictionsEditor = peditor;
     peditor->setUpdateCameraCallback(
         [=](const anari::math::float3 &eye, 
             const anari::math::float3 &center,
@@ -572,119 +697,224 @@ class Application : public anari_viewer::Application
         });
     peditor->setResetCameraCallback([=](){ viewport->resetView(); });
     peditor->setShowImageCallback([=](size_t index){ imageViewport->showImage(index); });
-    peditor->setSetActiveEstimatorIndexCallback([this](size_t index){ m_state.estimators.setActiveEstimatorIndex(index); });
+    // the device renders a field cropped to the volume of interest, the CPU
+    // renderers (viewport, race scores, pose optimizer) clip their rays
+    viewport->setVolumeOfInterestCallback([=, this](const VolumeOfInterest &voi){
+        withEstimator([=, this](){
+          m_state.voi = voi;
+          if (m_state.volume) {
+            auto previous = m_state.field;
+            commitField();
+            anari::setParameter(device, m_state.volume, "value", m_state.field);
+            anari::setParameter(device, m_state.volume, "field", m_state.field);
+            anari::commitParameters(device, m_state.volume);
+            anari::release(device, previous);
+          }
+          m_scoreRenderer.setVolumeOfInterest(voi);
+          viewport->setVolumeOfInterest(voi);
+          });
+        });
+    // the image region is drawn in either window and shown in both
+    viewport->setImageRegionCallback([=](const ImageRegion &region){
+        imageViewport->setImageRegion(region);
+        });
+    imageViewport->setImageRegionCallback([=](const ImageRegion &region){
+        viewport->setImageRegion(region);
+        });
+    peditor->setSetActiveEstimatorIndexCallback([this](size_t index){
+        withEstimator([=, this](){ m_state.estimators.setActiveEstimatorIndex(index); });
+        });
     peditor->setLoadReferenceImageCallback([=, this](size_t index){
-        auto& im = m_state.images[index];
-        image_transform_estimator::PIXEL_TYPE pixelType;
-        switch (im.bpp)
-        {
-          case 1:
-            pixelType = image_transform_estimator::PIXEL_TYPE::R8;
-            break;
-          case 3:
-            pixelType = image_transform_estimator::PIXEL_TYPE::RGB8;
-            break;
-          case 4:
-            pixelType = image_transform_estimator::PIXEL_TYPE::RGBA8;
-            break;
-          default:
+        withEstimator([=, this](){
+          auto image = m_state.images->get(index);
+          if (!image)
+            return;
+          auto reference = matchReference(image);
+          if (!reference.data) {
             std::cerr << "Error: pixel type unsupported\n";
             return;
-        }
-        m_state.estimators.getActiveEstimator()->set_image(im.data.data(),
-                                                       im.width,
-                                                       im.height,
-                                                       pixelType,
-                                                       image_transform_estimator::IMAGE_TYPE::REFERENCE,
-                                                       true /*swizzle*/);
+          }
+          m_reference = reference;
+          m_referenceImage = image;
+          m_referenceRegion = {};
+          m_estimatorRegion = {};
+          m_state.estimators.getActiveEstimator()->set_image(const_cast<uint8_t*>(reference.data.get()),
+                                                         reference.width,
+                                                         reference.height,
+                                                         reference.pixelType,
+                                                         image_transform_estimator::IMAGE_TYPE::REFERENCE,
+                                                         true /*swizzle*/);
+          });
         });
     peditor->setLoadFramebufferAsReferenceImageCallback([=, this](){
-        std::vector<uint8_t> fb;
+        auto fb = std::make_shared<std::vector<uint8_t>>();
         std::vector<float> depth3d;
         size_t width, height;
-        viewport->getFrame(fb, depth3d, width, height);
-        m_state.estimators.getActiveEstimator()->set_image(fb.data(),
-                                                       width,
-                                                       height,
-                                                       image_transform_estimator::PIXEL_TYPE::RGBA8,
-                                                       image_transform_estimator::IMAGE_TYPE::REFERENCE,
-                                                       false /*swizzle*/);
+        auto pixelType = getFrameForEstimator(viewport, *fb, depth3d, width, height);
+        const ImageRegion region = viewport->imageRegion();
+        withEstimator([=, this](){
+          m_reference = {std::shared_ptr<const uint8_t>(fb, fb->data()),
+              pixelType,
+              width,
+              height,
+              false /*swizzle*/};
+          // scored in reference image layout (columns not mirrored)
+          const bool gray = pixelType == image_transform_estimator::PIXEL_TYPE::R8;
+          std::vector<uint8_t> pixels(width * height * (gray ? 1 : 3));
+          flipFrameForExport(fb->data(), pixels.data(), width, height, gray ? 1 : 4);
+          m_referenceImage = std::make_shared<const Image>(width,
+              height,
+              gray ? Image::PixelType::R8 : Image::PixelType::RGB8,
+              pixels.data());
+          m_referenceRegion = region;
+          m_estimatorRegion = region;
+          m_state.estimators.getActiveEstimator()->set_image(fb->data(),
+                                                         width,
+                                                         height,
+                                                         pixelType,
+                                                         image_transform_estimator::IMAGE_TYPE::REFERENCE,
+                                                         false /*swizzle*/);
+          });
         });
     peditor->setMatchCallback([=, this](){
-        std::vector<uint8_t> fb;
-        std::vector<float> depth3d;
-        size_t width, height;
-        viewport->getFrame(fb, depth3d, width, height);
-        m_state.estimators.getActiveEstimator()->set_image(depth3d.data(),
-                                                       width,
-                                                       height,
-                                                       image_transform_estimator::PIXEL_TYPE::F32X3,
-                                                       image_transform_estimator::IMAGE_TYPE::DEPTH3D,
-                                                       false /*swizzle*/);
-        m_state.estimators.getActiveEstimator()->set_image(fb.data(),
-                                                       width,
-                                                       height,
-                                                       image_transform_estimator::PIXEL_TYPE::RGBA8,
-                                                       image_transform_estimator::IMAGE_TYPE::QUERY,
-                                                       false /*swizzle*/);
-        // match
+        // snapshot of frame and camera, matched on the worker thread
+        MatchInput input;
+        const ImageRegion region = matchSnapshot(viewport, input);
+        const bool setsReference = bool(input.reference.data);
+        if (m_matchRace.busy()
+            || !m_matchJob.submit(m_state.estimators.getActiveEstimator(), std::move(input)))
+          std::cout << "Match is still running\n";
+        else if (setsReference)
+          m_estimatorRegion = region;
+        });
+    peditor->setRaceMatchCallback([=, this](const MatchRace::Settings &settings){
+        // the same snapshot and reference for every estimator
+        if (estimatorsBusy() || m_autoRefine.phase() != AutoRefine::Phase::IDLE) {
+          std::cout << "Match is still running\n";
+          return;
+        }
+        if (!m_reference.data) {
+          std::cout << "Racing the estimators needs a reference image\n";
+          return;
+        }
+        MatchInput input;
+        const ImageRegion region = matchSnapshot(viewport, input);
+        if (!input.reference.data)
+          input.reference = regionMatchReference(region);
+        m_estimatorRegion = region;
+        auto score = raceScore(input, regionReference(region));
+        m_matchRace.submit(m_state.estimators.m_estimators,
+            m_state.estimators.m_estimatorNames,
+            input,
+            std::move(score),
+            settings);
+        });
+    peditor->setOptimizePoseCallback([=, this](const PoseOptimizer::Settings &settings){
+        if (estimatorsBusy() || m_autoRefine.phase() != AutoRefine::Phase::IDLE)
+          return;
+        if (!m_referenceImage) {
+          std::cout << "Optimizing the pose needs a reference image\n";
+          return;
+        }
+        anari::math::float3 eye, center, up;
+        float fovy, aspect;
+        viewport->getView(eye, center, up, fovy, aspect);
+        const ImageRegion region = viewport->imageRegion();
+        m_poseOptimizer.start(m_scoreRenderer,
+            regionReference(region),
+            {eye, center, up},
+            region.fovy(fovy),
+            region.aspect(aspect),
+            settings);
+        });
+    peditor->setMatchJob(&m_matchJob);
+    peditor->setMatchRace(&m_matchRace);
+    peditor->setPoseOptimizer(&m_poseOptimizer);
+    peditor->setAutoRefine(&m_autoRefine);
+    peditor->setAutoRefineCallback([=, this](size_t index, const AutoRefine::Settings &settings){
+        if (estimatorsBusy() || m_autoRefine.phase() != AutoRefine::Phase::IDLE)
+          return;
         anari::math::float3 eye, center, up;
         float fovy, aspect;
         viewport->getView(eye, center, up, fovy, aspect);
-        m_state.estimators.getActiveEstimator()->calibrate(width, height, fovy, aspect);
-        m_state.estimators.getActiveEstimator()->match();
-        // update view
-        std::array<float, 3> eyeArr{eye.x, eye.y, eye.z};
-        std::array<float, 3> centerArr{center.x, center.y, center.z};
-        std::array<float, 3> upArr{up.x, up.y, up.z};
-        m_state.estimators.getActiveEstimator()->update_camera(eyeArr, centerArr, upArr);
-        eye = anari::math::float3{eyeArr[0], eyeArr[1], eyeArr[2]};
-        center = anari::math::float3{centerArr[0], centerArr[1], centerArr[2]};
-        up = anari::math::float3{upArr[0], upArr[1], upArr[2]};
-        viewport->setView(eye, center, up);
+        m_autoRefine.start(index, {eye, center, up}, settings);
+        m_autoRefineRenderStart = std::chrono::steady_clock::now();
         });
     peditor->setExportScreenshotCallback([=, this](){
         // get camera
         anari::math::float3 eye, center, up;
         float fovy, aspect;
         viewport->getView(eye, center, up, fovy, aspect);
-        // get frame
-        std::vector<uint8_t> fb;
-        std::vector<float> depth3d;
-        size_t width, height;
-        viewport->getFrame(fb, depth3d, width, height);
-        screenshot(fb, width, height, eye, center, up, fovy);
+        // get frame, converted straight from the mapped color buffer
+        std::vector<uint8_t> pixels;
+        size_t components, width, height;
+        if (!viewport->getExportFrame(pixels, components, width, height))
+          return;
+        m_screenshots.save(
+            std::move(pixels), components, width, height, eye, center, up, fovy);
         });
     peditor->setSaveCameraCallback([=, this](size_t index){
         anari::math::float3 eye, center, up;
         float fovy, aspect;
         viewport->getView(eye, center, up, fovy, aspect);
-        m_state.predictions[index].refined_camera.eye = eye;
-        m_state.predictions[index].refined_camera.center = center;
-        m_state.predictions[index].refined_camera.up = up;
-        m_state.predictions[index].refined_camera.initialized = true;
+        saveRefinedCamera(index, eye, center, up);
         });
     peditor->setExportPredictionsCallback([=, this](){
-        int inc = 0;
-        std::string inc_str = "";
-        std::string screenshot_file_base{"predictions"};
-        std::string filename = screenshot_file_base + inc_str + ".json";
-        while (std::filesystem::exists(filename))
-        {
-          ++inc;
-          inc_str = std::to_string(inc);
-          while (inc_str.length() < 4)
-            inc_str = std::string("0") + inc_str;
-          inc_str = std::string("-") + inc_str;
-          filename = screenshot_file_base + inc_str + ".json";
-        }
-        if (m_state.predictions.export_json(filename))
+        std::string filename = m_predictionsNames.next() + "." + g_exportFormat;
+        if (m_state.predictions.save(filename))
           std::cout << "Predictions exported to: " << filename << "\n";
         });
     peditor->setSetMatchThresholdCallback([this](float threshold){
-        m_state.estimators.getActiveEstimator()->set_good_match_threshold(threshold);
+        withEstimator([=, this](){
+          // every plugin takes part in races; pool and batch instances
+          // pick it up when next used
+          for (size_t i = 0; i < m_state.estimators.m_estimators.size(); ++i)
+            m_state.estimators.setGoodMatchThreshold(i, threshold);
+          });
+        });
+    peditor->setCameraPathFromPredictionsCallback([=, this](){
+        // keyframes at the refined cameras, in prediction order
+        CameraPath path;
+        for (const auto &p : m_state.predictions) {
+          if (p.refined_camera.initialized) {
+            path.addKey({p.refined_camera.eye,
+                p.refined_camera.center,
+                p.refined_camera.up});
+          }
+        }
+        if (path.size() < 2)
+          std::cout << "Camera path needs at least two refined cameras\n";
+        viewport->setCameraPath(path);
+        });
+    peditor->setJumpToNearestCallback([=, this](){
+        anari::math::float3 eye, center, up;
+        float fovy, aspect;
+        viewport->getView(eye, center, up, fovy, aspect);
+        auto start = std::chrono::steady_clock::now();
+        auto nearest = m_state.predictions.nearest_poses(eye, center, 1);
+        auto end = std::chrono::steady_clock::now();
+        if (nearest.empty())
+          return;
+        const auto &match = nearest[0];
+        const auto &p = m_state.predictions[match.prediction];
+        const auto &c = match.refined ? p.refined_camera : p.initial_camera;
+        peditor->selectImage(match.prediction);
+        viewport->setView(c.eye, c.center, c.up);
+        std::cout << "Nearest pose: " << match.prediction + 1
+                  << (match.refined ? " (refined)" : " (initial)")
+                  << ", distance " << match.distance << ", lookup "
+                  << std::chrono::duration<float, std::micro>(end - start).count()
+                  << " us\n";
         });
 
+    if (g_runBenchmark) {
+      BenchmarkInfo info{{"tool", "anariDRRViewer"},
+          {"library", g_libraryName},
+          {"volume", g_filename}};
+      viewport->startBenchmark(g_benchmark, info);
+    }
+    m_viewport = viewport;
+
     anari_viewer::WindowArray windows;
     windows.emplace_back(viewport);
     windows.emplace_back(seditor);
@@ -710,8 +940,38 @@ class Application : public anari_viewer::Application
     }
   }
 
+  void uiFrameEnd() override
+  {
+    MatchResult match;
+    const bool matched = m_matchJob.takeResult(match);
+    if (m_autoRefine.phase() != AutoRefine::Phase::IDLE)
+      updateAutoRefine(matched, match);
+    else if (matched && m_viewport) {
+      printf("match: %.2fs\n", match.seconds);
+      m_viewport->setView(match.eye, match.center, match.up);
+    }
+    MatchResult raced;
+    size_t winner;
+    if (m_matchRace.takeResult(raced, winner) && m_viewport)
+      m_viewport->setView(raced.eye, raced.center, raced.up);
+    CameraKey optimized;
+    float cost;
+    if (m_poseOptimizer.takeResult(optimized, cost) && m_viewport)
+      m_viewport->setView(optimized.eye, optimized.center, optimized.up);
+    while (!estimatorsBusy() && !m_deferredEstimatorCalls.empty()) {
+      m_deferredEstimatorCalls.front()();
+      m_deferredEstimatorCalls.pop_front();
+    }
+
+    // benchmark runs from the command line quit when done
+    if (g_runBenchmark && m_viewport && m_viewport->benchmarkFinished())
+      glfwSetWindowShouldClose(glfwGetCurrentContext(), 1);
+  }
+
   void teardown() override
   {
+    // a running match still uses the active estimator
+    m_matchJob.shutdown();
     anari::release(m_state.device, m_state.field);
     anari::release(m_state.device, m_state.world);
     anari::release(m_state.device, m_state.device);
@@ -720,6 +980,29 @@ class Application : public anari_viewer::Application
 
  private:
   AppState m_state;
+  anari_viewer::windows::DRRViewport *m_viewport{nullptr};
+  anari_viewer::windows::PredictionsEditor *m_predictionsEditor{nullptr};
+  ScreenshotWriter m_screenshots{"screenshot"};
+  FileNameCounter m_predictionsNames{"predictions", "." + g_exportFormat};
+  // matching runs on a worker thread; estimator calls made meanwhile are
+  // deferred until it is done (joined in teardown())
+  MatchJob m_matchJob;
+  // all estimators on the same snapshot, scored by re-rendering the proposals
+  // (the renderer outlives the race's threads)
+  CpuDrrRenderer m_scoreRenderer;
+  MatchRace m_matchRace;
+  // intensity-based registration without an estimator, rendering with a
+  // copy of m_scoreRenderer
+  PoseOptimizer m_poseOptimizer;
+  MatchReference m_reference;
+  std::shared_ptr<const Image> m_referenceImage;
+  // image region the reference covers (a framebuffer's), and the one whose
+  // part of it the active estimator holds
+  ImageRegion m_referenceRegion;
+  ImageRegion m_estimatorRegion;
+  std::deque<std::function<void()>> m_deferredEstimatorCalls;
+  AutoRefine m_autoRefine;
+  std::chrono::steady_clock::time_point m_autoRefineRenderStart;
 };
 
 } // namespace viewer
@@ -738,6 +1021,10 @@ static void printUsage()
             << "   [{--matcher|-m|--estimator|-e} <directory>]\n"
             << "   [{--dims|-d} <dimx dimy dimz>]\n"
             << "   [{--type|-t} [{uint8|uint16|float32}]\n"
+            << "   [{--output|-o} [{rgba8|float32|uint16}]\n"
+            << "   [{--benchmark} <orbit|zoom>[:key=value,...]]\n"
+            << "   [{--image-memory} <MiB>] [{--preload-images}]\n"
+            << "   [{--export-format} <json|jsonl|predbin>]\n"
             << "   <volume file>\n";
 }
 
@@ -774,6 +1061,35 @@ static void parseCommandLine(int argc, char *argv[])
         printUsage();
         std::exit(0);
       }
+    } else if (arg == "--output" || arg == "-o") {
+      std::string v = argv[++i];
+      if (v == "rgba8")
+        g_colorFormat = ANARI_UFIXED8_RGBA_SRGB;
+      else if (v == "float32")
+        g_colorFormat = ANARI_FLOAT32;
+      else if (v == "uint16")
+        g_colorFormat = ANARI_UFIXED16;
+      else {
+        printUsage();
+        std::exit(0);
+      }
+    } else if (arg == "--benchmark") {
+      if (!BenchmarkSpec::parse(argv[++i], g_benchmark)) {
+        printUsage();
+        std::exit(1);
+      }
+      g_runBenchmark = true;
+    } else if (arg == "--image-memory") {
+      g_imageMemoryBudget = size_t(std::atol(argv[++i])) << 20;
+    } else if (arg == "--preload-images") {
+      g_preloadImages = true;
+    } else if (arg == "--export-format") {
+      g_exportFormat = argv[++i];
+      if (g_exportFormat != "json" && g_exportFormat != "jsonl"
+          && g_exportFormat != "predbin") {
+        printUsage();
+        std::exit(1);
+      }
     } else if (arg == "--json" || arg == "-j") {
       g_jsonfile = argv[++i];
     } else if (arg == "--lacfile" || arg == "--lac") {